@@ -0,0 +1,46 @@
+#include <Arduino.h>
+
+#include "arena.h"
+
+// The number of LEDs only becomes known once config is read, so rather than
+// each module holding a static buffer sized for the biggest drum, they carve
+// what they need from a single block, allocated once at boot. Nothing is
+// ever given back, so the heap can't fragment however long the drum runs.
+
+#define ARENA_ALIGN 4
+#define ARENA_SLACK 64 // covers alignment padding between buffers
+
+static uint8_t *arena = nullptr;
+static size_t arenaSize = 0;
+static size_t arenaUsed = 0;
+
+bool arenaBegin(size_t bytes)
+{
+  bytes += ARENA_SLACK;
+  arena = (uint8_t *)malloc(bytes);
+  if (arena == nullptr)
+    return false;
+
+  memset(arena, 0, bytes);
+  arenaSize = bytes;
+  arenaUsed = 0;
+  return true;
+}
+
+void *arenaAlloc(size_t bytes)
+{
+  size_t start = (arenaUsed + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (arena == nullptr || start + bytes > arenaSize)
+  {
+    Serial.printf("Arena full: wanted %u bytes, %u free\n", (unsigned)bytes, (unsigned)arenaFree());
+    return nullptr;
+  }
+
+  arenaUsed = start + bytes;
+  return arena + start;
+}
+
+size_t arenaFree()
+{
+  return arenaSize - arenaUsed;
+}
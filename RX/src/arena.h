@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// One block of memory for every per-pixel buffer, see arena.cpp
+
+// What each buffer needs per LED, for sizing the arena
+#define ARENA_FRAME 3    // leds[]
+#define ARENA_RING 3     // ring.cpp
+#define ARENA_HIRES 9    // hires.cpp, 16-bit frame plus dither residual
+#define ARENA_GEOMETRY 2 // geometry.cpp, angle and band tables
+#define ARENA_FIRE 1     // fire.cpp, heat per cell
+#define ARENA_WIRE 12    // output.cpp, only for the asynchronous driver
+#define ARENA_PER_LED (ARENA_FRAME + ARENA_RING + ARENA_HIRES + ARENA_GEOMETRY + ARENA_FIRE)
+
+// Allocate the arena; false if there isn't the memory
+bool arenaBegin(size_t bytes);
+
+// Carve a zeroed, word-aligned buffer from the arena; nullptr if it's full
+void *arenaAlloc(size_t bytes);
+
+// Bytes still unused, for diagnostics
+size_t arenaFree();
+
+#endif
@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "onset.h"
+
+// Piezo/mic on the ADC; a short burst of samples is taken at the start of
+// each frame so a hit shows in the very frame that detects it. Each
+// analogRead() keeps the ESP8266 busy for about AUDIO_READ_US, so the burst
+// costs about 1.5ms of the 28.6ms frame, far more than the detector itself
+// (tools/onset_wav.cpp times that). The profiler charges it to a section of
+// its own, audio, so profile_dump.py shows what it costs on the drum.
+#define AUDIO_PIN A0
+#define AUDIO_SAMPLES 16
+#define AUDIO_READ_US 95
+#define AUDIO_MAX_US 2000 // the most of a frame the burst may take
+#define ACCENT_BASE 160   // brightness between hits when accenting, out of 255
+#define ACCENT_DECAY 20   // how quickly an accent fades, per frame
+
+static_assert(AUDIO_SAMPLES * AUDIO_READ_US <= AUDIO_MAX_US, "the ADC burst would take too much of a frame");
+
+static OnsetDetector detector;
+static bool audioEnabled = false;
+static bool accentEnabled = false;
+static uint8_t accent = 0;
+
+void audioBegin(int sensitivity, bool accentEffects)
+{
+  detector.reset();
+  if (sensitivity > 0)
+    detector.sensitivity = constrain(sensitivity, 1, 255);
+  audioEnabled = true;
+  accentEnabled = accentEffects;
+}
+
+bool audioUpdate()
+{
+  if (!audioEnabled)
+    return false;
+
+  uint16_t samples[AUDIO_SAMPLES];
+  for (uint8_t i = 0; i < AUDIO_SAMPLES; i++)
+  {
+    samples[i] = analogRead(AUDIO_PIN);
+  }
+
+  if (detector.process(samples, AUDIO_SAMPLES))
+  {
+    accent = max(accent, detector.strength);
+    return true;
+  }
+
+  accent = qsub8(accent, ACCENT_DECAY);
+  return false;
+}
+
+uint8_t audioBrightness(uint8_t maxBright)
+{
+  if (!accentEnabled)
+    return maxBright;
+
+  // dim the effect a little between hits so there is headroom to accent them
+  uint8_t base = scale8(maxBright, ACCENT_BASE);
+  return base + scale8(maxBright - base, accent);
+}
+
+void drumHits(struct CRGB *targetArray, int numLeds)
+{
+  fill_solid(targetArray, numLeds, CRGB(accent, accent, accent));
+}
@@ -0,0 +1,300 @@
+#include <Arduino.h>
+#include <MD5Builder.h>
+#include <eboot_command.h>
+#include <DrumRadio.h>
+
+#include "bulk.h"
+#include "scene.h"
+
+// A bulk transfer arrives as numbered chunks over several identical passes.
+// A bitmap records which chunks have been written; a parity chunk rebuilds
+// the one missing chunk of a group from the other seven; and once every
+// chunk is in, the MD5 of the whole image is checked before it is used.
+//
+// Firmware chunks go straight to flash, in the free space above the running
+// sketch where Updater would put them, so chunks can land in any order.
+// Once verified, the bootloader is told to copy the image over the sketch.
+// Nothing authenticates the image: the MD5 only shows it arrived intact, so
+// anyone who can send on the band's address can flash every drum in range.
+//
+// Scene sets are small enough for RAM (see scene.cpp), and the TX trickles
+// them out between its other packets, so drums carry on rendering.
+
+#define BULK_TIMEOUT 15000 // mS without a bulk packet before giving up
+
+extern "C" uint32_t _FS_start;
+static uint32_t flashStart = 0;
+
+static bool firmwareBegin(uint32_t size)
+{
+  uint32_t sketchEnd = (ESP.getSketchSize() + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+  uint32_t roundedSize = (size + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+  uint32_t flashEnd = (uintptr_t)&_FS_start - 0x40200000;
+
+  if (roundedSize > flashEnd || flashEnd - roundedSize < sketchEnd)
+  {
+    Serial.println("Firmware update too large for free flash");
+    return false;
+  }
+  flashStart = flashEnd - roundedSize;
+
+  for (uint32_t sector = flashStart / FLASH_SECTOR_SIZE; sector < flashEnd / FLASH_SECTOR_SIZE; sector++)
+  {
+    if (!ESP.flashEraseSector(sector))
+      return false;
+    yield(); // erasing takes a while; keep the watchdog happy
+  }
+  return true;
+}
+
+static void firmwareWrite(uint32_t offset, const uint8_t *data, size_t len)
+{
+  uint32_t aligned[BULK_CHUNK_SIZE / 4] = {0};
+  memcpy(aligned, data, len);
+  ESP.flashWrite(flashStart + offset, aligned, (len + 3) & ~3);
+}
+
+static void firmwareRead(uint32_t offset, uint8_t *data, size_t len)
+{
+  uint32_t aligned[BULK_CHUNK_SIZE / 4];
+  ESP.flashRead(flashStart + offset, aligned, (len + 3) & ~3);
+  memcpy(data, aligned, len);
+}
+
+static void firmwareFinish(uint32_t size)
+{
+  uint8_t magic;
+  firmwareRead(0, &magic, 1);
+  if (magic != 0xE9)
+  {
+    Serial.println("Firmware update is not an ESP8266 image");
+    return;
+  }
+
+  eboot_command command;
+  command.action = ACTION_COPY_RAW;
+  command.args[0] = flashStart;
+  command.args[1] = 0;
+  command.args[2] = size;
+  eboot_command_write(&command);
+
+  Serial.println("Firmware update verified; restarting");
+  ESP.restart();
+}
+
+static const BulkSink firmwareSink = {firmwareBegin, firmwareWrite, firmwareRead, firmwareFinish, nullptr, true};
+
+static bool firmwareWanted(const BulkStartBody &start)
+{
+  // every pass of the transfer, and every boot after applying it, would
+  // otherwise start the same update again
+  static String running = ESP.getSketchMD5();
+
+  char hex[33];
+  for (uint8_t i = 0; i < 16; i++)
+    sprintf(hex + i * 2, "%02x", start.md5[i]);
+  return running != hex;
+}
+
+static const BulkSink *sink = nullptr;
+static uint16_t transferId = 0;
+static bool transferDone = false; // transferId has already been received
+static uint32_t transferSize = 0;
+static uint16_t chunkCount = 0;
+static uint16_t chunksReceived = 0;
+static uint8_t md5[16];
+static uint8_t *received = nullptr; // bitmap, one bit per chunk
+static unsigned long lastPacket = 0;
+
+static bool hasChunk(uint16_t chunk)
+{
+  return received[chunk >> 3] & (1 << (chunk & 7));
+}
+
+static size_t chunkLength(uint16_t chunk)
+{
+  uint32_t offset = (uint32_t)chunk * BULK_CHUNK_SIZE;
+  return min((uint32_t)BULK_CHUNK_SIZE, transferSize - offset);
+}
+
+static void storeChunk(uint16_t chunk, const uint8_t *data)
+{
+  sink->write((uint32_t)chunk * BULK_CHUNK_SIZE, data, chunkLength(chunk));
+  received[chunk >> 3] |= 1 << (chunk & 7);
+  chunksReceived++;
+}
+
+static void bulkAbandon()
+{
+  if (sink != nullptr && sink->end != nullptr)
+    sink->end();
+  free(received);
+  received = nullptr;
+  sink = nullptr;
+}
+
+static bool verify()
+{
+  MD5Builder hash;
+  hash.begin();
+
+  uint8_t chunk[BULK_CHUNK_SIZE];
+  for (uint16_t i = 0; i < chunkCount; i++)
+  {
+    size_t len = chunkLength(i);
+    sink->read((uint32_t)i * BULK_CHUNK_SIZE, chunk, len);
+    hash.add(chunk, len);
+  }
+  hash.calculate();
+
+  uint8_t actual[16];
+  hash.getBytes(actual);
+  return memcmp(actual, md5, sizeof(md5)) == 0;
+}
+
+static void startTransfer(const BulkStartBody &start)
+{
+  if (start.transfer == transferId && (received != nullptr || transferDone))
+    return; // another pass of a transfer we're receiving, or already have
+
+  const BulkSink *newSink = nullptr;
+  switch (start.kind)
+  {
+  case BULK_FIRMWARE:
+    if (!firmwareWanted(start))
+      return;
+    newSink = &firmwareSink;
+    break;
+  case BULK_SCENES:
+    if (!sceneWanted(start))
+      return;
+    newSink = &sceneSink;
+    break;
+  default:
+    return;
+  }
+
+  uint32_t chunks = (start.size + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE;
+  if (chunks == 0 || chunks > 0xFFFF)
+    return;
+
+  // only now, so one we don't want doesn't end one we're receiving
+  bulkAbandon();
+
+  Serial.printf("Bulk transfer #%u: %u bytes\n", start.transfer, start.size);
+
+  received = (uint8_t *)calloc((chunks + 7) / 8, 1);
+  if (received == nullptr)
+    return;
+
+  transferId = start.transfer;
+  transferDone = false;
+  transferSize = start.size;
+  chunkCount = chunks;
+  chunksReceived = 0;
+  memcpy(md5, start.md5, sizeof(md5));
+
+  if (!newSink->begin(transferSize))
+  {
+    bulkAbandon();
+    return;
+  }
+  sink = newSink;
+}
+
+static void rebuildFromParity(const BulkDataBody &parity)
+{
+  uint32_t first = (uint32_t)parity.index * BULK_GROUP_SIZE;
+  if (first >= chunkCount)
+    return;
+  uint16_t last = min((uint32_t)chunkCount, first + BULK_GROUP_SIZE);
+
+  // only possible if exactly one chunk of the group is missing
+  int missing = -1;
+  for (uint16_t i = first; i < last; i++)
+  {
+    if (!hasChunk(i))
+    {
+      if (missing >= 0)
+        return;
+      missing = i;
+    }
+  }
+  if (missing < 0)
+    return;
+
+  uint8_t rebuilt[BULK_CHUNK_SIZE];
+  memcpy(rebuilt, parity.data, BULK_CHUNK_SIZE);
+  for (uint16_t i = first; i < last; i++)
+  {
+    if (i == missing)
+      continue;
+    uint8_t chunk[BULK_CHUNK_SIZE] = {0};
+    sink->read((uint32_t)i * BULK_CHUNK_SIZE, chunk, chunkLength(i));
+    for (uint8_t b = 0; b < BULK_CHUNK_SIZE; b++)
+      rebuilt[b] ^= chunk[b];
+  }
+  storeChunk(missing, rebuilt);
+}
+
+void bulkPacket(const DrumPacket &packet)
+{
+  lastPacket = millis();
+
+  if (packet.type == PACKET_BULK_START)
+  {
+    startTransfer(packet.bulkStart);
+    return;
+  }
+
+  if (sink == nullptr)
+    return;
+
+  switch (packet.type)
+  {
+  case PACKET_BULK_DATA:
+    if (packet.bulkData.transfer == transferId && packet.bulkData.index < chunkCount && !hasChunk(packet.bulkData.index))
+      storeChunk(packet.bulkData.index, packet.bulkData.data);
+    break;
+
+  case PACKET_BULK_PARITY:
+    if (packet.bulkData.transfer == transferId)
+      rebuildFromParity(packet.bulkData);
+    break;
+
+  case PACKET_BULK_END:
+    if (packet.bulkEnd.transfer != transferId)
+      break;
+    Serial.printf("Bulk transfer #%u: %u of %u chunks\n", transferId, chunksReceived, chunkCount);
+    break;
+  }
+
+  if (chunksReceived == chunkCount)
+  {
+    bool ok = verify();
+    Serial.printf("Bulk transfer #%u complete, %s\n", transferId, ok ? "verified" : "MD5 mismatch");
+    if (ok)
+    {
+      transferDone = true;
+      sink->finish(transferSize);
+    }
+    bulkAbandon();
+  }
+}
+
+bool bulkActive()
+{
+  if (sink != nullptr && millis() - lastPacket > BULK_TIMEOUT)
+  {
+    Serial.printf("Bulk transfer #%u timed out\n", transferId);
+    bulkAbandon();
+  }
+  return sink != nullptr && sink->foreground;
+}
+
+uint8_t bulkProgress()
+{
+  if (chunkCount == 0)
+    return 0;
+  return ((uint32_t)chunksReceived * 255) / chunkCount;
+}
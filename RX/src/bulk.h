@@ -0,0 +1,28 @@
+#ifndef BULK_H
+#define BULK_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Receiving bulk transfers (firmware images, scenes) broadcast by the TX, see bulk.cpp
+
+// Where a transfer's bytes are stored while it is received
+struct BulkSink
+{
+  bool (*begin)(uint32_t size);
+  void (*write)(uint32_t offset, const uint8_t *data, size_t len);
+  void (*read)(uint32_t offset, uint8_t *data, size_t len);
+  void (*finish)(uint32_t size); // once every chunk is in and verified
+  void (*end)();                 // after finish or on giving up; may be nullptr
+  bool foreground;               // the TX sends it flat out, so stop rendering to keep up
+};
+
+void bulkPacket(const DrumPacket &packet);
+
+// Is a foreground transfer under way? The main loop should keep the radio polled
+bool bulkActive();
+
+// 0-255 through the current transfer
+uint8_t bulkProgress();
+
+#endif
@@ -0,0 +1,202 @@
+#include <Arduino.h>
+#include <Ticker.h>
+#include <DrumRadio.h>
+
+#include "capture.h"
+
+// Each frame that changed is queued as a record: the runs of pixels that
+// differ from the last frame queued (a byte of pixels skipped, a byte of
+// pixels changed, then their RGB), or the whole frame when that is smaller,
+// and whole anyway every CAPTURE_KEY_MS so that a tool joining late can
+// start. A Ticker tops up the UART FIFO from the queue between frames, so
+// rendering never waits on Serial. When the link can't keep up the queue
+// fills, and frames that don't fit are skipped: the tool sees fewer frames,
+// never late ones. Log lines printed meanwhile can land inside a record;
+// the CRC lets the tool drop it.
+
+#define CAPTURE_QUEUE 1024   // bytes, at least two whole frames
+#define CAPTURE_PUMP_MS 5    // the FIFO's 128 bytes last 11ms at 115200 baud
+#define CAPTURE_KEY_MS 1000
+
+static Ticker pump;
+static uint8_t *queue = nullptr;
+static size_t queueSize = 0;
+static size_t head = 0; // next byte in
+static size_t tail = 0; // next byte out
+static CRGB *last = nullptr; // the frame last queued
+static uint8_t *record = nullptr;
+static uint16_t pixels = 0;
+static uint16_t frame = 0;
+static uint16_t lastFrame = 0;
+static unsigned long lastKey = 0;
+static bool haveLast = false;
+static uint32_t skipped = 0;
+
+static void pumpQueue()
+{
+  while (tail != head)
+  {
+    size_t room = Serial.availableForWrite();
+    size_t run = (head > tail ? head : queueSize) - tail;
+    if (room == 0)
+      return;
+    if (run > room)
+      run = room;
+    Serial.write(queue + tail, run);
+    tail = (tail + run) % queueSize;
+  }
+}
+
+static size_t queueFree()
+{
+  return (tail + queueSize - head - 1) % queueSize;
+}
+
+static void enqueue(const uint8_t *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    queue[head] = data[i];
+    head = (head + 1) % queueSize;
+  }
+}
+
+void captureStart(int numLeds)
+{
+  captureStop();
+
+  size_t recordSize = sizeof(CaptureHeader) + numLeds * 3 + 2 + 2;
+  queueSize = max((size_t)CAPTURE_QUEUE, 2 * recordSize);
+  queue = (uint8_t *)malloc(queueSize);
+  last = (CRGB *)malloc(numLeds * sizeof(CRGB));
+  record = (uint8_t *)malloc(recordSize);
+  if (queue == nullptr || last == nullptr || record == nullptr)
+  {
+    captureStop();
+    Serial.println("Capture: not enough memory");
+    return;
+  }
+
+  pixels = numLeds;
+  head = tail = 0;
+  frame = 0;
+  haveLast = false;
+  skipped = 0;
+  Serial.printf("Capture on: %u LEDs\n", pixels);
+  pump.attach_ms(CAPTURE_PUMP_MS, pumpQueue);
+}
+
+void captureStop()
+{
+  if (queue == nullptr)
+    return;
+
+  pump.detach();
+  while (tail != head)
+  {
+    pumpQueue();
+    yield();
+  }
+  Serial.flush();
+  free(queue);
+  free(last);
+  free(record);
+  queue = nullptr;
+  last = nullptr;
+  record = nullptr;
+  Serial.printf("\nCapture off: %u frames, %u skipped\n", frame, skipped);
+}
+
+// Runs of changed pixels into body; 0 if nothing changed, or more than
+// limit bytes if a whole frame would be smaller
+static size_t delta(const struct CRGB *leds, uint8_t *body, size_t limit)
+{
+  size_t len = 0;
+  int i = 0;
+  while (i < (int)pixels)
+  {
+    uint8_t skip = 0;
+    while (i < (int)pixels && skip < 255 && leds[i] == last[i])
+    {
+      skip++;
+      i++;
+    }
+    if (i == (int)pixels)
+      break;
+
+    uint8_t count = 0;
+    size_t at = len;
+    len += 2;
+    while (i < (int)pixels && count < 255 && leds[i] != last[i])
+    {
+      if (len + 3 > limit)
+        return limit + 1;
+      body[len++] = leds[i].r;
+      body[len++] = leds[i].g;
+      body[len++] = leds[i].b;
+      count++;
+      i++;
+    }
+    body[at] = skip;
+    body[at + 1] = count;
+  }
+  return len;
+}
+
+void captureFrame(int mode, const struct CRGB *leds)
+{
+  if (queue == nullptr)
+    return;
+
+  unsigned long now = millis();
+  frame++;
+
+  CaptureHeader header;
+  memcpy(header.magic, CAPTURE_MAGIC, 2);
+  header.frame = frame;
+  header.ms = now;
+  header.mode = mode;
+  header.leds = pixels;
+
+  uint8_t *body = record + sizeof(header);
+  size_t whole = pixels * 3;
+  size_t len = whole + 1;
+  if (haveLast && now - lastKey < CAPTURE_KEY_MS)
+  {
+    len = delta(leds, body, whole);
+    if (len == 0)
+      return; // unchanged, nothing to send
+  }
+  if (len > whole)
+  {
+    header.kind = 'K';
+    header.base = 0;
+    len = whole;
+    memcpy(body, leds, whole);
+  }
+  else
+  {
+    header.kind = 'D';
+    header.base = lastFrame;
+  }
+  header.length = len;
+
+  size_t size = sizeof(header) + len + 2;
+  if (size > queueFree())
+  {
+    skipped++;
+    return;
+  }
+
+  memcpy(record, &header, sizeof(header));
+  uint16_t crc = drumCrc16(record, sizeof(header) + len);
+  record[sizeof(header) + len] = crc;
+  record[sizeof(header) + len + 1] = crc >> 8;
+  enqueue(record, size);
+
+  memcpy(last, leds, whole);
+  lastFrame = frame;
+  haveLast = true;
+  if (header.kind == 'K')
+    lastKey = now;
+}
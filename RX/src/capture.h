@@ -0,0 +1,30 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <FastLED.h>
+
+// Streaming the frames shown over Serial, for tools/capture.py; see capture.cpp
+
+#define CAPTURE_MAGIC "DC"
+
+struct __attribute__((packed)) CaptureHeader
+{
+  char magic[2];
+  uint8_t kind;   // 'K' for a whole frame, 'D' for the changes since base
+  uint16_t frame; // frames rendered since the capture began
+  uint16_t base;
+  uint32_t ms;    // millis() when rendered
+  int16_t mode;
+  uint16_t leds;
+  uint16_t length; // of the body that follows, then a CRC-16 of it all
+};
+
+// Start or stop sending frames
+void captureStart(int numLeds);
+void captureStop();
+
+// A frame of mode has been rendered into leds; call every frame
+void captureFrame(int mode, const struct CRGB *leds);
+
+#endif
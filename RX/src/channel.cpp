@@ -0,0 +1,82 @@
+#include <Arduino.h>
+#include <RF24.h>
+
+#include "channel.h"
+
+// The TX counts down to a switch, so drums that hear any of the countdown
+// change together. A drum that missed it hears nothing from then on: after
+// CHANNEL_LOST_MS it tries CHANNEL_DEFAULT, where the TX beacons the
+// channel in use, and then the channel it last heard the TX on, and so on
+// until the TX turns up.
+
+extern RF24 radio;
+
+#define CHANNEL_LOST_MS 3000
+
+static uint8_t tuned = CHANNEL_DEFAULT;   // listening on
+static uint8_t lastGood = CHANNEL_DEFAULT; // the TX was last heard on
+static int16_t target = -1;
+static unsigned long switchAt = 0;
+static unsigned long lastHeard = 0;
+
+static void tune(uint8_t channel)
+{
+  if (channel == tuned)
+    return;
+  radio.stopListening();
+  radio.setChannel(channel);
+  radio.startListening();
+  tuned = channel;
+  Serial.printf("Radio on channel %u\n", channel);
+}
+
+void channelBegin()
+{
+  radio.setChannel(tuned);
+}
+
+uint8_t channelTuned()
+{
+  return tuned;
+}
+
+void channelHeard()
+{
+  lastHeard = millis();
+  lastGood = tuned;
+}
+
+void channelPacket(const ChannelBody &body)
+{
+  if (body.channel >= CHANNEL_COUNT)
+    return;
+
+  if (body.delay == 0)
+  {
+    // a beacon, or the TX has already moved
+    target = -1;
+    tune(body.channel);
+    lastGood = body.channel;
+    return;
+  }
+  target = body.channel;
+  switchAt = millis() + body.delay;
+}
+
+void channelPoll()
+{
+  unsigned long now = millis();
+
+  if (target >= 0 && (long)(now - switchAt) >= 0)
+  {
+    tune(target);
+    lastGood = target;
+    target = -1;
+    lastHeard = now;
+  }
+  else if (now - lastHeard >= CHANNEL_LOST_MS)
+  {
+    tune(tuned == CHANNEL_DEFAULT ? lastGood : CHANNEL_DEFAULT);
+    lastHeard = now;
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Following the TX from channel to channel, see channel.cpp
+
+// Start listening on CHANNEL_DEFAULT, where the TX starts too; after the
+// radio has been restarted, on the channel it was on
+void channelBegin();
+
+// The channel the radio should be on
+uint8_t channelTuned();
+
+// A packet from the TX, on the channel we're listening on
+void channelHeard();
+
+// The TX is moving the band to another channel
+void channelPacket(const ChannelBody &body);
+
+// Make a switch that's due, or go looking for a TX that has gone quiet;
+// call every frame after reading the radio
+void channelPoll();
+
+#endif
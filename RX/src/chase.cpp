@@ -1,19 +1,20 @@
 #include <FastLED.h>
 
-void chase(struct CRGB *targetArray, int numLeds, const struct CRGB &color0, const struct CRGB &color1 = CRGB::Black)
-{
+#include "clock.h"
+#include "hires.h"
+#include "ledcount.h"
 
-  static uint8_t i = 0;
-  const uint8_t SEGMENTS = 4;
+#define SEGMENTS 4
 
-  static uint8_t segmentSize = (uint8_t)numLeds / SEGMENTS;
-
-  fadeToBlackBy(targetArray, numLeds, 100);
+static int dot = 0; // where in each segment the dots were drawn last frame
 
+template <typename Count>
+static void chaseDots(struct CRGB16 *targetArray, Count numLeds, int segmentSize, int i, const struct CRGB &color0, const struct CRGB &color1)
+{
   for (uint8_t s = 0; s < SEGMENTS; s++)
   {
-    uint8_t target = i + (segmentSize * s);
-    while (target > numLeds)
+    int target = i + (segmentSize * s);
+    while (target >= numLeds)
     {
       Serial.println("Busted target!! " + target);
       target = numLeds - 1;
@@ -41,10 +42,42 @@ void chase(struct CRGB *targetArray, int numLeds, const struct CRGB &color0, con
       targetArray[target] = color0;
     }
   }
+}
+
+template <typename Count>
+static void chaseFrame(Count numLeds, const struct CRGB &color0, const struct CRGB &color1)
+{
+  const int segmentSize = numLeds / SEGMENTS;
+
+  // render at 16 bits so the tails fade out smoothly
+  struct CRGB16 *frame = hiresFrame();
+  hiresFade(frame, numLeds, 100);
+
+  // the dots travel one segment per beat; at quick tempos they move more
+  // than a pixel a frame, so light every pixel passed over since last time.
+  // A phase correction can move them back a little, which isn't worth
+  // going round the whole segment for
+  int position = ((uint32_t)clockBeatPhase() * segmentSize) >> 8;
+  int ahead = position - dot;
+  if (ahead < 0)
+    ahead += segmentSize;
+  if (ahead > segmentSize / 2)
+    dot = position;
+
+  if (dot == position)
+    chaseDots(frame, numLeds, segmentSize, dot, color0, color1);
+
+  while (dot != position)
+  {
+    dot++;
+    // restart once we reach the end of each segment
+    if (dot == segmentSize)
+      dot = 0;
+    chaseDots(frame, numLeds, segmentSize, dot, color0, color1);
+  }
+}
 
-  i++;
-  // restart once we reach the end of each segment
-  if (i == segmentSize)
-    i = 0;
-  
+void chase(struct CRGB *targetArray, int numLeds, const struct CRGB &color0, const struct CRGB &color1 = CRGB::Black)
+{
+  ledCount(numLeds, [&](auto count) { chaseFrame(count, color0, color1); });
 }
@@ -0,0 +1,91 @@
+#include <Arduino.h>
+#include <DrumRadio.h>
+
+#include "clock.h"
+
+// Beat clock: a free-running beat-position accumulator that effects derive
+// their motion from, kept in step with the tempo the TX broadcasts.
+// Everything is integer-only; a frame costs one multiply and a few adds.
+
+#define DEFAULT_BPM (120 << 8) // 8.8 fixed point, until the TX tells us otherwise
+#define TEMPO_GLIDE 3          // tempo changes close 1/8th of the gap per frame
+#define PHASE_GLIDE 4          // phase corrections are spread over ~16 frames
+#define BAR_BEATS (1UL << (BEAT_FRACTION_BITS + 2)) // a bar, in 8.24 beats
+
+static uint32_t beatPosition = 0;   // 8.24 beats
+static uint32_t beatRate = 0;       // 8.24 beats per millisecond
+static uint32_t targetRate = 0;     // rate we are gliding towards
+static int32_t phaseError = 0;      // correction still to apply, 8.24 beats
+static unsigned long lastUpdate = 0;
+
+static uint32_t rateForBpm(uint16_t bpm)
+{
+  // bpm is 8.8; beats/ms in 8.24 = bpm * 2^24 / (60000 * 2^8)
+  return (uint32_t)(((uint64_t)bpm << 16) / 60000);
+}
+
+void clockTempo(uint16_t bpm, uint32_t beat)
+{
+  if (bpm == 0)
+    return;
+
+  targetRate = rateForBpm(bpm);
+  if (beatRate == 0)
+    beatRate = targetRate;
+
+  // Difference between where the TX is and where we are, wrapping safely.
+  // After a tap or at boot it can be anything up to 128 beats. Whole bars
+  // don't show in any effect's motion, so they are taken at once, keeping
+  // beat numbers the same as the TX's; only what is left within the bar,
+  // at most two beats either way, is glided
+  uint32_t error = beat - beatPosition;
+  int32_t inBar = error & (BAR_BEATS - 1);
+  if (inBar >= (int32_t)(BAR_BEATS / 2))
+    inBar -= (int32_t)BAR_BEATS;
+  beatPosition += error - inBar;
+  phaseError = inBar;
+}
+
+void clockUpdate()
+{
+  unsigned long now = millis();
+  if (beatRate == 0)
+  {
+    beatRate = targetRate = rateForBpm(DEFAULT_BPM);
+    lastUpdate = now;
+  }
+
+  // glide the tempo rather than jumping
+  int32_t rateError = (int32_t)(targetRate - beatRate);
+  beatRate += rateError >> TEMPO_GLIDE;
+  if (rateError != 0 && (rateError >> TEMPO_GLIDE) == 0)
+    beatRate = targetRate;
+
+  // and ease out any phase error
+  int32_t step = phaseError >> PHASE_GLIDE;
+  if (step == 0)
+    step = phaseError;
+  phaseError -= step;
+
+  beatPosition += beatRate * (now - lastUpdate) + step;
+  lastUpdate = now;
+}
+
+uint32_t clockBeats()
+{
+  return beatPosition;
+}
+
+uint8_t clockBeatPhase()
+{
+  return (uint8_t)(beatPosition >> (BEAT_FRACTION_BITS - 8));
+}
+
+static_assert(BEATS_PER_BAR == 4, "clockBarPhase() assumes 4 beats to the bar");
+
+uint16_t clockBarPhase()
+{
+  // the bar is the low 2 bits of the beat number plus the fraction
+  uint32_t inBar = beatPosition & ((1UL << (BEAT_FRACTION_BITS + 2)) - 1);
+  return (uint16_t)(inBar >> (BEAT_FRACTION_BITS + 2 - 16));
+}
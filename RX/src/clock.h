@@ -0,0 +1,15 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+// Beat clock shared by all effects, see clock.cpp
+
+void clockTempo(uint16_t bpm, uint32_t beat); // from a TX tempo packet
+void clockUpdate();                           // once per frame
+
+uint32_t clockBeats();     // beat position, 8.24 fixed point
+uint8_t clockBeatPhase();  // 0-255 through the current beat
+uint16_t clockBarPhase();  // 0-65535 through the current bar
+
+#endif
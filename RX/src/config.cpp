@@ -0,0 +1,201 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "FS.h"
+#include <SPIFFSIniFile.h>
+
+#include "config.h"
+
+// Parsing config.ini means mounting SPIFFS and scanning the file once per
+// setting, which keeps the drum dark for a good part of a second. So the
+// parsed settings are cached as a CRC-checked blob in EEPROM, along with a
+// CRC of the ini file they came from. Boot uses the blob; once the lights
+// are up, configIniChanged() checks the file still matches, and only then
+// is the ini parsed again.
+
+#define CONFIG_MAGIC 0x44524D43 // "DRMC"
+#define CONFIG_VERSION 6        // bump whenever DrumConfig changes
+#define CONFIG_FILE "/config.ini"
+
+struct ConfigBlob
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  uint32_t iniCrc; // CRC of the config.ini these settings were parsed from
+  DrumConfig config;
+  uint32_t crc; // of everything above
+};
+
+static uint32_t cachedIniCrc = 0;
+static uint32_t parsedIniCrc = 0;
+
+static uint32_t crc32(const void *data, size_t length, uint32_t crc = 0xFFFFFFFF)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (length--)
+  {
+    crc ^= *bytes++;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return crc;
+}
+
+static bool iniFileCrc(uint32_t &crc)
+{
+  if (!SPIFFS.begin())
+    return false;
+
+  File file = SPIFFS.open(CONFIG_FILE, "r");
+  if (!file)
+    return false;
+
+  uint8_t chunk[64];
+  size_t got;
+  crc = 0xFFFFFFFF;
+  while ((got = file.read(chunk, sizeof(chunk))) > 0)
+    crc = crc32(chunk, got, crc);
+  file.close();
+  return true;
+}
+
+bool configLoadCached(DrumConfig &config)
+{
+  ConfigBlob blob;
+  EEPROM.begin(sizeof(blob));
+  EEPROM.get(0, blob);
+  EEPROM.end();
+
+  if (blob.magic != CONFIG_MAGIC || blob.version != CONFIG_VERSION || blob.size != sizeof(blob) ||
+      blob.crc != crc32(&blob, offsetof(ConfigBlob, crc)))
+    return false;
+
+  config = blob.config;
+  cachedIniCrc = blob.iniCrc;
+  return true;
+}
+
+bool configLoadIni(DrumConfig &config)
+{
+  // to read config file
+  const byte bufferLen = 80;
+  char buffer[bufferLen];
+
+  // Mount the SPIFFS
+  if (!SPIFFS.begin())
+  {
+    Serial.println("SPIFFS.begin() failed");
+    return false;
+  }
+
+  SPIFFSIniFile ini(CONFIG_FILE);
+  if (!ini.open())
+  {
+    Serial.print("ini file ");
+    Serial.print(CONFIG_FILE);
+    Serial.println(" does not exist");
+    return false;
+  }
+
+  // Check the file is valid. This can be used to warn if any lines
+  // are longer than the buffer.
+  if (!ini.validate(buffer, bufferLen))
+  {
+    Serial.print("ini file ");
+    Serial.print(ini.getFilename());
+    Serial.println(" not valid");
+    ini.close();
+    return false;
+  }
+
+  int value = 0;
+  // [leds] is the first strip, [leds2] and [leds3] any more
+  for (uint8_t s = 0; s < MAX_STRIPS; s++)
+  {
+    char section[8] = "leds";
+    if (s > 0)
+      snprintf(section, sizeof(section), "leds%d", s + 1);
+
+    if (ini.getValue(section, "count", buffer, bufferLen, value))
+    {
+      config.strips[s].count = value;
+      Serial.printf("Got %s count from config: %d\n", section, value);
+    }
+    if (ini.getValue(section, "pin", buffer, bufferLen, value))
+      config.strips[s].pin = value;
+  }
+  if (ini.getValue("drum", "type", buffer, bufferLen, value))
+  {
+    config.drumType = value;
+    Serial.print("Got drum type from config: ");
+    Serial.println(value);
+  }
+  if (ini.getValue("drum", "salt", buffer, bufferLen, value))
+    config.drumSalt = value;
+  if (ini.getValue("leds", "async", buffer, bufferLen, value))
+  {
+    config.asyncOutput = value;
+    Serial.print("Got async output from config: ");
+    Serial.println(value);
+  }
+  if (ini.getValue("audio", "enabled", buffer, bufferLen, value))
+  {
+    config.audioEnabled = value;
+    if (ini.getValue("audio", "sensitivity", buffer, bufferLen, value))
+      config.audioSensitivity = value;
+    if (ini.getValue("audio", "accent", buffer, bufferLen, value))
+      config.audioAccent = value;
+  }
+  if (ini.getValue("geometry", "start", buffer, bufferLen, value))
+  {
+    config.startAngle = value;
+    Serial.print("Got start angle from config: ");
+    Serial.println(value);
+  }
+  if (ini.getValue("geometry", "reverse", buffer, bufferLen, value))
+    config.reversed = value;
+  if (ini.getValue("geometry", "band", buffer, bufferLen, value))
+    config.bandPosition = value;
+  if (ini.getValue("relay", "hops", buffer, bufferLen, value))
+  {
+    config.relayHops = value;
+    Serial.print("Got relay hops from config: ");
+    Serial.println(value);
+  }
+  if (ini.getValue("power", "save", buffer, bufferLen, value))
+    config.powerSave = value;
+  if (ini.getValue("power", "irq", buffer, bufferLen, value))
+    config.radioIrq = value;
+  ini.close();
+
+  if (!iniFileCrc(parsedIniCrc))
+    parsedIniCrc = 0;
+  cachedIniCrc = parsedIniCrc;
+  return true;
+}
+
+void configSave(const DrumConfig &config)
+{
+  ConfigBlob blob;
+  memset(&blob, 0, sizeof(blob));
+  blob.magic = CONFIG_MAGIC;
+  blob.version = CONFIG_VERSION;
+  blob.size = sizeof(blob);
+  blob.iniCrc = parsedIniCrc;
+  blob.config = config;
+  blob.crc = crc32(&blob, offsetof(ConfigBlob, crc));
+
+  EEPROM.begin(sizeof(blob));
+  EEPROM.put(0, blob);
+  EEPROM.commit();
+  EEPROM.end();
+}
+
+bool configIniChanged()
+{
+  uint32_t crc;
+  if (!iniFileCrc(crc))
+    return false; // nothing better to go on than the cache
+
+  return crc != cachedIniCrc;
+}
@@ -0,0 +1,46 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+
+#define MAX_STRIPS 3
+
+// A strip of LEDs on its own data pin; strips are driven together and
+// effects see them end to end, as one long strip
+struct LedStrip
+{
+  uint8_t pin;
+  uint16_t count; // 0 if not fitted
+};
+
+// Receiver settings from /config.ini, see config.cpp
+struct DrumConfig
+{
+  LedStrip strips[MAX_STRIPS];
+  uint8_t drumType;
+  uint8_t asyncOutput;
+  uint8_t audioEnabled;
+  uint8_t audioSensitivity;
+  uint8_t audioAccent;
+  uint16_t startAngle; // degrees round the shell of the first pixel
+  uint8_t reversed;    // strip runs anticlockwise, seen from above
+  uint8_t bandPosition;
+  uint8_t drumSalt; // 0 to render random effects the same as every other drum
+  uint8_t relayHops; // relay commands that have made fewer hops than this; 0 to not relay
+  uint8_t powerSave;
+  uint8_t radioIrq; // GPIO wired to the nRF24's IRQ, 0 if none
+};
+
+// Quickly load the settings cached by configSave(); false if there are none
+bool configLoadCached(DrumConfig &config);
+
+// Parse /config.ini; false if it is missing or invalid
+bool configLoadIni(DrumConfig &config);
+
+// Cache settings for the next boot
+void configSave(const DrumConfig &config);
+
+// After boot: has /config.ini changed since the cached settings were read?
+bool configIniChanged();
+
+#endif
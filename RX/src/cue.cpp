@@ -0,0 +1,31 @@
+#include "cue.h"
+
+void Cue::heard(uint16_t newId, uint32_t delay, uint32_t now)
+{
+  if (done && newId == doneId)
+    return;
+
+  uint32_t moment = now + delay;
+  if (!armed || newId != id)
+  {
+    armed = true;
+    id = newId;
+    at = moment;
+  }
+  else if ((int32_t)(moment - at) < 0)
+  {
+    at = moment;
+  }
+}
+
+bool Cue::due(uint32_t now, uint32_t within) const
+{
+  return armed && (int32_t)(at - now) < (int32_t)within;
+}
+
+void Cue::fired()
+{
+  armed = false;
+  done = true;
+  doneId = id;
+}
@@ -0,0 +1,34 @@
+#ifndef CUE_H
+#define CUE_H
+
+#include <stdint.h>
+
+// A moment the TX has cued, such as a strobe, worked out from the copies
+// of its command. Each copy says how long until the moment, but is only
+// read some time after it arrives, so gives a moment no earlier than the
+// real one; the earliest so far is the best estimate. Kept free of Arduino
+// and radio dependencies, so tools/strobe_sim.cpp can run it on the host.
+// Times are in uS, wrapping.
+
+class Cue
+{
+public:
+  bool armed = false;
+  uint16_t id = 0;
+  uint32_t at = 0; // the moment, on our clock
+
+  // A copy of cue id, read at now, saying delay to go when it was sent
+  void heard(uint16_t id, uint32_t delay, uint32_t now);
+
+  // Is the moment before now + within?
+  bool due(uint32_t now, uint32_t within) const;
+
+  // The moment has been acted on; copies of it still arriving are ignored
+  void fired();
+
+private:
+  bool done = false;
+  uint16_t doneId = 0;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef FIREHEAT_H
+#define FIREHEAT_H
+
+#include <stdint.h>
+
+#include "prng.h"
+
+// A frame of fire.cpp's simulation, before the heat is mapped to colours.
+// Kept free of FastLED, so tools/prng_golden.cpp can check it renders the
+// same frames as it always has.
+
+// COOLING: How quickly does each cell cool down?
+// Less cooling = longer-lived flames.  More cooling = shorter-lived flames.
+// suggested range 20-100
+#define COOLING 100
+
+// SPARKING: What chance (out of 255) is there that a new spark will be lit?
+// Higher chance = more intense fire.  Lower chance = more flickery fire.
+// suggested range 50-200.
+#define SPARKING 100
+
+template <typename Count>
+inline void fireHeat(uint8_t *heat, Count numLeds)
+{
+  // Step 1.  Cool down every cell a little
+  for (int i = 0; i < numLeds; i++)
+  {
+    uint8_t cooling = prng8(0, (COOLING / numLeds));
+    heat[i] = heat[i] > cooling ? heat[i] - cooling : 0;
+  }
+
+  // Step 2.  Heat from each cell drifts 'outwards'
+  for (int k = 1; k < numLeds - 1; k++) // skip the end pixels to stay in bounds
+  {
+    heat[k - 1] = (heat[k] + heat[k - 1]) / 2;
+    heat[k + 1] = (heat[k] + heat[k + 1]) / 2;
+    heat[k] = (heat[k] * 233) >> 8; // / 1.1, without floating point
+  }
+
+  // Step 3.  Randomly ignite new 'sparks' of heat somewhere
+  if (prng8() < SPARKING)
+  {
+    uint8_t sparkHeat = prng8(160, 255);
+    int y = prng16(numLeds); // where to spark
+    heat[y] = heat[y] + sparkHeat > 255 ? 255 : heat[y] + sparkHeat;
+  }
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <Arduino.h>
+
+#include "flash.h"
+#include "cue.h"
+#include "output.h"
+#include "power.h"
+
+// Once a strobe is cued the drum stops rendering and spins on micros()
+// until the moment, still reading the radio. A copy read at the start of
+// a frame may have waited most of the frame, but copies arriving during the
+// spin are timed to within a poll, and bring the moment forward to the
+// truth (see cue.h); the TX sends enough of them over its lead for some to
+// get through. The strip only lights once the whole frame has been clocked
+// out, which takes longer the more LEDs a drum has, so the frame is shown
+// that much early, and all sizes of drum light together. The flash then
+// holds for exactly the width sent. This waits
+// in the frame loop rather than in a timer interrupt because a frame can't
+// be shown from one, and timer1 is the UART driver's.
+
+#define FLASH_HORIZON_US 120000   // longer than the TX's lead, so the spin starts at the first copy
+#define FLASH_SPIN_US 2000        // closer than this, spin rather than delay()
+#define FLASH_RELAY_US 3000       // not worth relaying a strobe due sooner
+#define FLASH_MAX_WIDTH_US 200000 // nothing renders or reads the radio while a flash holds
+
+static Cue cue;
+static uint8_t pattern = STROBE_FLASH;
+static uint32_t widths[2] = {30000, 25000}; // until a strobe says otherwise
+static uint32_t origin = 0;
+
+void flashPacket(const StrobeBody &body)
+{
+  if (body.pattern > STROBE_999)
+    return;
+  cue.heard(body.cue, body.delay, micros());
+  if (cue.armed && cue.id == body.cue)
+  {
+    pattern = body.pattern;
+    widths[pattern] = min(body.width, (uint32_t)FLASH_MAX_WIDTH_US);
+  }
+}
+
+void flashUntil(uint32_t until)
+{
+  while ((int32_t)(until - micros()) > FLASH_SPIN_US)
+    delay(1);
+  while ((int32_t)(until - micros()) > 0)
+  {
+  }
+}
+
+int flashPoll(struct CRGB *leds, int numLeds, void (*poll)())
+{
+  if (!cue.due(micros(), FLASH_HORIZON_US))
+    return -1;
+
+  uint32_t latency = ledLatencyUs();
+  while ((int32_t)(cue.at - latency - micros()) > 0)
+    poll();
+  cue.fired();
+
+  if (pattern == STROBE_999)
+    return 199; // nineninenine() allows for the latency itself
+
+  fill_solid(leds, numLeds, CRGB::White);
+  ledShow();
+  flashUntil(cue.at - latency + widths[STROBE_FLASH]);
+  ledClear(true);
+  powerRedraw(); // the strip no longer shows the last frame
+  return -1;
+}
+
+bool flashRelay(StrobeBody &body)
+{
+  int32_t left = cue.at - micros();
+  if (!cue.armed || cue.id != body.cue || left < FLASH_RELAY_US)
+    return false;
+  body.delay = left;
+  return true;
+}
+
+void flashReset()
+{
+  origin = micros();
+}
+
+uint32_t flashOrigin()
+{
+  return origin;
+}
+
+uint32_t flashWidth(uint8_t pattern)
+{
+  return widths[pattern];
+}
@@ -0,0 +1,32 @@
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdint.h>
+#include <FastLED.h>
+#include <DrumRadio.h>
+
+// Strobes cued by the TX, fired together across the band; see flash.cpp
+
+// A copy of a strobe command, just read
+void flashPacket(const StrobeBody &body);
+
+// If a strobe has been cued, wait for it, calling poll to read the radio
+// meanwhile, and fire it. Returns the mode to switch to for a pattern that
+// is a mode of its own, or -1
+int flashPoll(struct CRGB *leds, int numLeds, void (*poll)());
+
+// A relayed copy says how long is left now, by our own estimate; false if
+// it is too late to be worth sending
+bool flashRelay(StrobeBody &body);
+
+// The 999 flashes start over from now; called as any mode starts
+void flashReset();
+
+// When the 999 flashes started, and how long each is held, in uS
+uint32_t flashOrigin();
+uint32_t flashWidth(uint8_t pattern);
+
+// Wait until the given micros(), to within a few uS
+void flashUntil(uint32_t until);
+
+#endif
@@ -0,0 +1,87 @@
+#include "flood.h"
+
+// Only commands are worth the airtime: bulk transfers and streams already
+// carry their own recovery, and heartbeats are for the other transmitter.
+// A drum out of range would miss a channel switch without a relay
+static bool relayable(uint8_t type)
+{
+  return type == PACKET_MODE || type == PACKET_TEMPO || type == PACKET_PROGRAM || type == PACKET_PALETTE ||
+         type == PACKET_SCENE || type == PACKET_CHANNEL || type == PACKET_STROBE;
+}
+
+// Identifies a packet whatever its hops. Copies are recognised by their
+// contents, as older TXs don't number their packets; the TX's
+// retransmissions of a command count as copies too, so it is relayed once
+// however many of them a drum hears. A mode sent again is a new command,
+// as the TX numbers each one (see drumPacketNumber()); other commands
+// differ anyway (tempo, channel and strobes) or do the same again
+// (programs and palettes, each to its own slot).
+static uint16_t signature(const DrumPacket &packet)
+{
+  DrumPacket copy = packet;
+  copy.type = drumPacketType(packet);
+  return drumCrc16((const uint8_t *)&copy, sizeof(copy));
+}
+
+bool Flood::heard(const DrumPacket &packet, unsigned long now, uint32_t random)
+{
+  if (!relayable(drumPacketType(packet)))
+    return true;
+
+  uint16_t sig = signature(packet);
+  uint8_t hops = drumPacketHops(packet);
+  for (Seen &entry : seen)
+  {
+    if (!entry.valid || entry.signature != sig || now - entry.at > RELAY_MEMORY_MS)
+      continue;
+
+    // a copy; if enough neighbours have relayed it, they have it covered
+    if (hops > 0 && entry.relays < 255)
+      entry.relays++;
+    if (entry.relays >= RELAY_SUPPRESS)
+    {
+      for (Pending &relay : pending)
+      {
+        if (relay.waiting && relay.signature == sig)
+        {
+          relay.waiting = false;
+          suppressed++;
+        }
+      }
+    }
+    return false;
+  }
+
+  seen[nextSeen] = {true, sig, (uint8_t)(hops > 0), now};
+  nextSeen = (nextSeen + 1) % RELAY_MEMORY;
+
+  if (hops >= maxHops || hops >= PACKET_MAX_HOPS)
+    return true;
+
+  for (Pending &relay : pending)
+  {
+    if (relay.waiting)
+      continue;
+    relay.waiting = true;
+    relay.signature = sig;
+    relay.at = now + random % (RELAY_BACKOFF_MS + 1);
+    relay.packet = packet;
+    relay.packet.type = drumPacketType(packet) | (hops + 1) << PACKET_HOPS_SHIFT;
+    break;
+  }
+  return true; // if the queue is full, this one just isn't relayed
+}
+
+bool Flood::due(DrumPacket &packet, unsigned long now)
+{
+  for (Pending &relay : pending)
+  {
+    if (relay.waiting && (long)(now - relay.at) >= 0)
+    {
+      relay.waiting = false;
+      packet = relay.packet;
+      return true;
+    }
+  }
+  return false;
+}
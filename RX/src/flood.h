@@ -0,0 +1,55 @@
+#ifndef FLOOD_H
+#define FLOOD_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Which packets a receiver relays, and when: flooding with a hop limit.
+// Each new command heard is queued for relaying after a random back-off,
+// and dropped from the queue if enough neighbours relay it first. Kept free
+// of Arduino and radio dependencies, so tools/relay_sim.cpp can run it on
+// the host.
+#define RELAY_MEMORY 16      // packets remembered, to spot copies
+#define RELAY_MEMORY_MS 1000 // and for how long
+#define RELAY_PENDING 4      // relays waiting to go
+#define RELAY_BACKOFF_MS 40  // longest random wait before relaying
+#define RELAY_SUPPRESS 2     // relays by neighbours heard while waiting that make ours pointless
+
+class Flood
+{
+public:
+  uint8_t maxHops = 0; // relay packets that have made fewer hops; 0 relays nothing
+
+  // A packet heard at now, with a random number from this drum's own
+  // source, so that drums back off differently. False if it is a copy of
+  // one heard recently.
+  bool heard(const DrumPacket &packet, unsigned long now, uint32_t random);
+
+  // The next relay due by now, copied to packet; false if none
+  bool due(DrumPacket &packet, unsigned long now);
+
+  uint32_t suppressed = 0; // relays dropped as neighbours covered them
+
+private:
+  struct Seen
+  {
+    bool valid;
+    uint16_t signature;
+    uint8_t relays; // copies heard from other receivers
+    unsigned long at;
+  };
+
+  struct Pending
+  {
+    bool waiting;
+    uint16_t signature;
+    unsigned long at;
+    DrumPacket packet;
+  };
+
+  Seen seen[RELAY_MEMORY] = {};
+  Pending pending[RELAY_PENDING] = {};
+  uint8_t nextSeen = 0;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include <FastLED.h>
+
+#include "geometry.h"
+#include "arena.h"
+
+// Pixel 0 is wherever the strip happens to start on the shell, and the strip
+// may run either way round, so effects that mean "the sides" or "a wave
+// across the band" look up each pixel's angle and band position here rather
+// than working from its index. The tables are built once at boot; after
+// that a lookup is just an array read.
+
+#define BAND_DRUM_WIDTH 12 // how much of the band's 0-255 one drum spans
+
+static uint8_t *angles = nullptr;
+static uint8_t *bands = nullptr;
+
+void geometryBegin(const LedStrip *strips, uint8_t stripCount, uint16_t startAngle, bool reversed, uint8_t bandPosition)
+{
+  int numLeds = 0;
+  for (uint8_t s = 0; s < stripCount; s++)
+    numLeds += strips[s].count;
+
+  angles = (uint8_t *)arenaAlloc(numLeds);
+  bands = (uint8_t *)arenaAlloc(numLeds);
+  if (angles == nullptr || bands == nullptr)
+    return;
+
+  uint8_t start = (uint32_t)(startAngle % 360) * 256 / 360;
+  int i = 0;
+  for (uint8_t s = 0; s < stripCount; s++)
+  {
+    for (int p = 0; p < strips[s].count; p++, i++)
+    {
+      uint8_t along = (uint32_t)p * 256 / strips[s].count;
+      uint8_t angle = reversed ? start - along : start + along;
+      angles[i] = angle;
+
+      // the audience sees the drum's right side on their left; sin8() of
+      // the angle is 255 at the drummer's right and 1 at their left
+      int across = -((int)sin8(angle) - 128) * BAND_DRUM_WIDTH / 256;
+      int band = bandPosition + across;
+      bands[i] = band < 0 ? 0 : band > 255 ? 255 : band;
+    }
+  }
+}
+
+uint8_t geometryAngle(int pixel)
+{
+  return angles[pixel];
+}
+
+uint8_t geometryBand(int pixel)
+{
+  return bands[pixel];
+}
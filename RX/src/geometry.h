@@ -0,0 +1,29 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Where each pixel sits on the drum, see geometry.cpp
+
+// Angles are 0-255 for a full turn round the shell, seen from above:
+// 0 faces the audience, 64 is the drummer's right, 128 faces the drummer
+// and 192 is the drummer's left
+#define ANGLE_FRONT 0
+#define ANGLE_RIGHT 64
+#define ANGLE_BACK 128
+#define ANGLE_LEFT 192
+
+// Build the lookup tables; each strip is a ring round the drum, whose first
+// pixel is at startAngle degrees. bandPosition is where this drum stands in
+// the band, 0 on the audience's left to 255 on their right
+void geometryBegin(const LedStrip *strips, uint8_t stripCount, uint16_t startAngle, bool reversed, uint8_t bandPosition);
+
+// Angle of a pixel round the shell
+uint8_t geometryAngle(int pixel);
+
+// Position of a pixel across the whole band, 0-255 from the audience's left
+uint8_t geometryBand(int pixel);
+
+#endif
@@ -0,0 +1,58 @@
+#include <FastLED.h>
+
+#include "hires.h"
+#include "arena.h"
+
+// Effects with slow fades and long tails can opt in to rendering at 16 bits
+// per channel. Just before show() the frame is quantised to 8 bits with
+// temporal error diffusion: each pixel carries the fraction it lost into the
+// next frame, so over a few frames the average output matches the 16-bit
+// value and fades run smoothly down to black instead of stepping.
+static struct CRGB16 *hires = nullptr;
+static uint8_t (*residual)[3] = nullptr; // error carried to the next frame
+static int hiresSize = 0;
+static bool frameUsed = false;
+
+void hiresBegin(int numLeds)
+{
+  hires = (struct CRGB16 *)arenaAlloc(numLeds * sizeof(CRGB16));
+  residual = (uint8_t(*)[3])arenaAlloc(numLeds * 3);
+  hiresSize = hires && residual ? numLeds : 0;
+}
+
+struct CRGB16 *hiresFrame()
+{
+  frameUsed = true;
+  return hires;
+}
+
+void hiresClear()
+{
+  for (int i = 0; i < hiresSize; i++)
+    hires[i] = CRGB16();
+  memset(residual, 0, hiresSize * 3);
+}
+
+static inline uint8_t quantise(uint16_t value, uint8_t &error)
+{
+  uint32_t sum = (uint32_t)value + error;
+  error = sum & 0xFF;
+  return sum > 0xFFFF ? 0xFF : sum >> 8;
+}
+
+void hiresResolve(struct CRGB *targetArray, int numLeds)
+{
+  if (!frameUsed)
+    return;
+  frameUsed = false;
+
+  if (numLeds > hiresSize)
+    numLeds = hiresSize;
+
+  for (int i = 0; i < numLeds; i++)
+  {
+    targetArray[i].r = quantise(hires[i].r, residual[i][0]);
+    targetArray[i].g = quantise(hires[i].g, residual[i][1]);
+    targetArray[i].b = quantise(hires[i].b, residual[i][2]);
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef HIRES_H
+#define HIRES_H
+
+#include <FastLED.h>
+
+// High-precision render path, see hires.cpp
+
+// One pixel at 16 bits per channel; 8-bit colours widen to the full range
+struct CRGB16
+{
+  uint16_t r, g, b;
+
+  CRGB16() : r(0), g(0), b(0) {}
+  CRGB16(const struct CRGB &c) : r(c.r * 257), g(c.g * 257), b(c.b * 257) {}
+
+  // visible at all once quantised to 8 bits?
+  bool isLit() const { return (r | g | b) > 0xFF; }
+};
+
+// Take the 16-bit frame from the arena, once at boot
+void hiresBegin(int numLeds);
+
+// The 16-bit frame, for an effect to render into; using it this frame
+// means it is dithered into leds[] before show()
+struct CRGB16 *hiresFrame();
+
+// As fadeToBlackBy(), but without losing the fractional part each frame.
+// Inline, so that with a LedCount (see ledcount.h) the loop count is fixed
+template <typename Count>
+inline void hiresFade(struct CRGB16 *frame, Count numLeds, uint8_t fadeBy)
+{
+  uint16_t scale = 256 - fadeBy;
+  for (int i = 0; i < numLeds; i++)
+  {
+    frame[i].r = ((uint32_t)frame[i].r * scale) >> 8;
+    frame[i].g = ((uint32_t)frame[i].g * scale) >> 8;
+    frame[i].b = ((uint32_t)frame[i].b * scale) >> 8;
+  }
+}
+
+// Clear the frame and dither state, e.g. on a change of mode
+void hiresClear();
+
+// Dither the 16-bit frame into leds[], if an effect used it this frame
+void hiresResolve(struct CRGB *targetArray, int numLeds);
+
+#endif
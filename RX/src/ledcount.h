@@ -0,0 +1,35 @@
+#ifndef LEDCOUNT_H
+#define LEDCOUNT_H
+
+#include <type_traits>
+
+// Firmware can be built for one size of drum (the drumNN environments in
+// platformio.ini), with DRUM_LEDS the LEDs on all its strips together.
+// Effects with per-pixel arithmetic run their frame through ledCount(),
+// which passes them that count as a compile-time constant when this drum
+// has it: divisions and modulos by it fold away and its loops have a known
+// trip count. A drum whose config.ini gives another count runs the same
+// code with the count from config, as every drum does in the generic build.
+
+#ifndef DRUM_LEDS
+#define DRUM_LEDS 0 // any size, from config.ini
+#endif
+
+template <int N>
+using LedCount = std::integral_constant<int, N>;
+
+// Call frame(numLeds), as a LedCount if it is the count built for
+template <typename Frame>
+inline void ledCount(int numLeds, Frame frame)
+{
+#if DRUM_LEDS > 0
+  if (numLeds == DRUM_LEDS)
+  {
+    frame(LedCount<DRUM_LEDS>());
+    return;
+  }
+#endif
+  frame(numLeds);
+}
+
+#endif
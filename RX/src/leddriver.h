@@ -0,0 +1,31 @@
+#ifndef LEDDRIVER_H
+#define LEDDRIVER_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// A way of getting a frame onto the strip, see output.cpp. Kept free of
+// FastLED and Arduino, so a driver can be built on the host, as
+// tools/uart_wire.cpp does to check the UART waveform.
+class LedDriver
+{
+public:
+  virtual ~LedDriver() {}
+
+  // The strips take consecutive runs of leds[]; false if the driver can't
+  // drive this set of strips
+  virtual bool begin(struct CRGB *leds, const LedStrip *strips, uint8_t stripCount) = 0;
+
+  // Start sending a frame; an asynchronous driver returns straight away
+  // and clocks it out while the next frame renders
+  virtual void show(const struct CRGB *leds, int numLeds, uint8_t brightness) = 0;
+
+  // Still clocking out the previous frame?
+  virtual bool busy() = 0;
+
+  // Wait, keeping the strip lit
+  virtual void wait(unsigned long ms) = 0;
+};
+
+#endif
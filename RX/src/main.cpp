@@ -13,12 +13,33 @@
 #include <SPI.h>
 #include <nRF24L01.h>
 #include <RF24.h>
-#define FASTLED_ALLOW_INTERRUPTS 0
 #include <FastLED.h>
-#include "FS.h"
-#include <SPIFFSIniFile.h>
+#include <DrumRadio.h>
+#include <DrumVM.h>
+#include <DrumStream.h>
 
 #include "prototypes.h"
+#include "clock.h"
+#include "ring.h"
+#include "hires.h"
+#include "output.h"
+#include "config.h"
+#include "arena.h"
+#include "geometry.h"
+#include "bulk.h"
+#include "vm.h"
+#include "prng.h"
+#include "profile.h"
+#include "stream.h"
+#include "palette.h"
+#include "relay.h"
+#include "power.h"
+#include "scene.h"
+#include "channel.h"
+#include "capture.h"
+#include "flash.h"
+#include "watchdog.h"
+#include "ledcount.h"
 
 #if FASTLED_VERSION < 3001000
 #error "Requires FastLED 3.1 or later; check github for latest code."
@@ -31,29 +52,34 @@ struct RF24 radio(NRF24L01_PIN_CE, NRF24L01_PIN_CS);
 const byte address[5] = {'R', 'x', 'A', 'A', '1'};
 
 // Setup the LEDs
-#define MAX_LEDS 104 // Maximum number of LEDS to initialise for
-#define DATA_PIN 2
-#define VOLTS 5
-#define MAX_MA 2000
+#define MAX_LEDS 600     // Most LEDs, across all strips, to find memory for
+#if DRUM_LEDS > 0
+#define DEFAULT_LEDS DRUM_LEDS // If config doesn't say, the size this build is for
+#else
+#define DEFAULT_LEDS 104 // If config doesn't say
+#endif
 #define FRAMES_PER_SECOND 35
-byte max_bright = 255;      // Overall brightness definition, could be changed on the fly
-struct CRGB leds[MAX_LEDS]; // The array of leds, one for each led in the strip
-int numLeds = MAX_LEDS;     // To be read from config later
+byte max_bright = 255;        // Overall brightness definition, could be changed on the fly
+struct CRGB *leds = nullptr;  // The array of leds, one for each led in the strips
+int numLeds = 0;              // Read from config, all strips together
+
+// the first strip on D4, any others on D1 and D3
+DrumConfig config = {{{2, DEFAULT_LEDS}, {5, 0}, {0, 0}}, 0, 0, 0, 0, 0, 0, 0, 128, 0, 0, 0, 0};
+unsigned long firstFrameMicros = 0; // micros() from reset until the first frame went out
+#define DIAGNOSTICS_DELAY 2000      // mS after boot to print diagnostics and check config
 
 int ledMode = -1;                  // The currently active pattern
 unsigned long IDLETIMEOUT = 30000; // Time to wait before doing our own thing
 
-void (*resetFunc)(void) = 0; // declare reset function @ address 0
-
 void showStatus(struct CRGB *targetArray, const struct CRGB &color)
 {
   EVERY_N_MILLIS(1000)
   {
     targetArray[1] = color;
-    FastLED.show();
-    FastLED.delay(500);
-    FastLED.clear(true);
-    FastLED.delay(500);
+    ledShow();
+    ledDelay(500);
+    ledClear(true);
+    ledDelay(500);
   }
 }
 
@@ -62,124 +88,310 @@ void showError(struct CRGB *targetArray, const struct CRGB &color)
   EVERY_N_MILLIS(300)
   {
     targetArray[1] = color;
-    FastLED.show();
-    FastLED.delay(150);
-    FastLED.clear(true);
-    FastLED.delay(150);
+    ledShow();
+    ledDelay(150);
+    ledClear(true);
+    ledDelay(150);
   }
 }
 
+// Set the radio up to hear the TX; at boot, and again whenever the
+// watchdog finds it has stopped working. False if it doesn't answer
+bool radioStart()
+{
+  if (!radio.begin())
+    return false;
+  radio.openReadingPipe(1, address);
+  radio.setAutoAck(false);
+  if (config.radioIrq)
+    radio.maskIRQ(true, true, false); // so IRQ only falls as a packet arrives, to wake from sleep
+  channelBegin();
+  radio.startListening(); // put radio in RX mode
+  relayBegin(config.relayHops, address);
+  return true;
+}
+
 void setup()
 {
   Serial.begin(115200);
-  while (!Serial)
-  {
-    // some boards need to wait to ensure access to serial over USB
-  }
-  delay(1000);
-
   Serial.println("Setting up...");
 
-#pragma region CONFIGFILE
-
-  // to read config file
-  const byte bufferLen = 80;
-  char buffer[bufferLen];
-
-  const char *filename = "/config.ini";
-
-  // Mount the SPIFFS
-  if (!SPIFFS.begin())
+  // settings cached from config.ini on a previous boot, else the ini itself
+  if (configLoadCached(config))
   {
-    Serial.println("SPIFFS.begin() failed");
-    ledMode = -2;
+    Serial.println("Using cached config");
   }
-
-  SPIFFSIniFile ini(filename);
-  if (!ini.open())
+  else if (configLoadIni(config))
   {
-    Serial.print("ini file ");
-    Serial.print(filename);
-    Serial.println(" does not exist");
-    ledMode = -2;
+    configSave(config);
   }
-
-  // Check the file is valid. This can be used to warn if any lines
-  // are longer than the buffer.
-  if (!ini.validate(buffer, bufferLen))
+  else
   {
-    Serial.print("ini file ");
-    Serial.print(ini.getFilename());
-    Serial.print(" not valid: ");
     ledMode = -2;
   }
 
-#pragma endregion CONFIGFILE
+  // the strips actually fitted
+  LedStrip strips[MAX_STRIPS];
+  uint8_t stripCount = 0;
+  for (uint8_t s = 0; s < MAX_STRIPS; s++)
+  {
+    if (config.strips[s].count > 0)
+    {
+      strips[stripCount++] = config.strips[s];
+      numLeds += config.strips[s].count;
+    }
+  }
 
-  if (ini.getValue("leds", "count", buffer, bufferLen, numLeds))
+  // every per-pixel buffer comes out of one block, sized for those strips
+  size_t perLed = ARENA_PER_LED + (config.asyncOutput ? ARENA_WIRE : 0);
+  if (numLeds == 0 || numLeds > MAX_LEDS || !arenaBegin(numLeds * perLed))
   {
-    Serial.print("Got numLeds from config: ");
-    Serial.println(numLeds);
+    Serial.printf("Can't find memory for %d LEDs, falling back to %d\n", numLeds, DEFAULT_LEDS);
+    strips[0] = config.strips[0];
+    strips[0].count = numLeds = DEFAULT_LEDS;
+    stripCount = 1;
+    ledMode = -2;
+    if (!arenaBegin(numLeds * perLed))
+    {
+      // not even that; blink an error from a buffer of its own, and stop
+      static struct CRGB few[2];
+      strips[0].count = 2;
+      ledBegin(few, strips, 1, false);
+      Serial.println("No memory for the LEDs; stopping");
+      for (;;)
+      {
+        showError(few, CRGB::Orange);
+        yield();
+      }
+    }
   }
-  int drumType = 0;
-  if (ini.getValue("drum", "type", buffer, bufferLen, drumType))
+  leds = (struct CRGB *)arenaAlloc(numLeds * sizeof(CRGB));
+  geometryBegin(strips, stripCount, config.startAngle, config.reversed, config.bandPosition);
+  ringBegin(numLeds);
+  hiresBegin(numLeds);
+  fireBegin(numLeds);
+
+  prngBegin(config.drumSalt);
+  streamBegin(config.drumType);
+  sceneBegin(config.drumType);
+  powerBegin(config.powerSave, config.radioIrq);
+
+  if (config.audioEnabled)
   {
-    Serial.print("Got drum type from config: ");
-    Serial.println(drumType);
+    audioBegin(config.audioSensitivity, config.audioAccent);
+    Serial.println("Audio onset detection enabled");
   }
-  ini.close();
 
   Serial.print("Setting up LEDs... ");
-  LEDS.addLeds<WS2812, DATA_PIN, GRB>(leds, numLeds).setCorrection(TypicalPixelString);
-  ;
+  ledBegin(leds, strips, stripCount, config.asyncOutput);
   FastLED.setBrightness(max_bright);
-  FastLED.setMaxPowerInVoltsAndMilliamps(VOLTS, MAX_MA);
-  FastLED.clear();
+  ledClear();
   Serial.println("Done");
 
-  Serial.printf("ESP8266 Chip id = %08X\n", ESP.getChipId());
-
-  Serial.print("Setting up radio... ");
-  if (radio.begin())
+  Serial.println("Setting up radio");
+  bool radioUp = radioStart();
+  watchdogBegin(radioStart, radioUp);
+  if (radioUp)
   {
-    radio.openReadingPipe(1, address);
-    radio.setAutoAck(false);
-    radio.startListening();     // put radio in TX mode
-    radio.printPrettyDetails(); // (larger) function that prints human readable data
-    Serial.print("done");
-
-    ledMode = -1;
+    ledMode = watchdogResumed();
   }
   else
   {
+    // the watchdog keeps trying it
     Serial.println(F("radio hardware is not responding!!"));
     ledMode = -3;
     showError(leds, CRGB::Red);
   }
 }
 
+// Anything not needed to get the lights on waits until they are
+void bootDiagnostics()
+{
+  Serial.printf("Boot to first frame: %lu ms\n", firstFrameMicros / 1000);
+  Serial.printf("ESP8266 Chip id = %08X\n", ESP.getChipId());
+  Serial.printf("%d LEDs, %u bytes of arena spare\n", numLeds, (unsigned)arenaFree());
+  if (DRUM_LEDS > 0 && numLeds != DRUM_LEDS)
+    Serial.printf("Built for %d LEDs, so running the generic effects\n", DRUM_LEDS);
+  radio.printPrettyDetails(); // (larger) function that prints human readable data
+  sceneLoad();
+
+  if (configIniChanged())
+  {
+    Serial.println("config.ini has changed since it was cached");
+    DrumConfig fresh = config;
+    if (configLoadIni(fresh))
+    {
+      configSave(fresh);
+      Serial.println("Restarting with new config");
+      ESP.restart();
+    }
+  }
+}
+
+void setMode(int mode)
+{
+  ledMode = mode;
+
+  Serial.print("Radio RX data: ");
+  Serial.println(ledMode);
+
+  // clear all pixels ready for the new mode
+  ledClear();
+  ringReset();
+  hiresClear();
+  vmReset();
+  flashReset();
+}
+
+// Packets are taken from the transmitter leading in the newest term heard
+// (see HeartbeatBody); a deposed leader's are dropped. A term not heard
+// from for LEADER_TIMEOUT is forgotten, so a lone transmitter that was
+// restarted and began counting again is still obeyed.
+#define LEADER_TIMEOUT 2000 // in mS
+
+static uint8_t leaderTerm = 0;
+static unsigned long leaderHeard = 0;
+
+bool fromLeader(uint8_t term)
+{
+  unsigned long now = millis();
+  if (!drumTermCurrent(term, leaderTerm) && now - leaderHeard < LEADER_TIMEOUT)
+    return false;
+
+  if (term != leaderTerm)
+    Serial.printf("Following transmitter term %u\n", term);
+  leaderTerm = term;
+  leaderHeard = now;
+  return true;
+}
+
 void readRadio()
 {
   byte pipe;
 
-  if (radio.available(&pipe))
+  while (radio.available(&pipe))
   { // is there a payload?
-    int payload;
-    radio.read(&payload, sizeof(payload)); // get incoming payload
-    ledMode = payload;
+    DrumPacket packet;
+    radio.read(&packet, sizeof(packet)); // get incoming payload
+    profileCount(PROF_PACKETS);
+
+    if (drumPacketLegacy(packet))
+    {
+      // an older TX sends just the mode number
+      int payload;
+      memcpy(&payload, &packet, sizeof(payload));
+      setMode(payload);
+      continue;
+    }
+
+    if (!fromLeader(packet.term))
+      continue;
+    channelHeard();
+    watchdogHeard();
+
+    if (!relayHeard(packet) && drumPacketHops(packet) > 0)
+      continue; // had it already, from the TX or another drum
+
+    switch (drumPacketType(packet))
+    {
+    case PACKET_MODE:
+      prngBandSeed(packet.mode.seed);
+      setMode(packet.mode.mode);
+      break;
+
+    case PACKET_SCENE:
+      prngBandSeed(packet.scene.seed);
+      setMode(sceneRecall(packet.scene));
+      break;
+
+    case PACKET_TEMPO:
+      clockTempo(packet.tempo.bpm, packet.tempo.beat);
+      break;
+
+    case PACKET_PROGRAM:
+      vmPacket(packet.program);
+      break;
+
+    case PACKET_STREAM:
+      streamPacket(packet.stream);
+      break;
+
+    case PACKET_PALETTE:
+      palettePacket(packet.palette);
+      break;
+
+    case PACKET_STROBE:
+      flashPacket(packet.strobe);
+      break;
+
+    case PACKET_CHANNEL:
+      channelPacket(packet.channel);
+      break;
+
+    case PACKET_BULK_START:
+    case PACKET_BULK_DATA:
+    case PACKET_BULK_PARITY:
+    case PACKET_BULK_END:
+      bulkPacket(packet);
+      break;
+    }
+  }
+}
+
+// Read the radio while waiting for a strobe
+void pollRadio()
+{
+  readRadio();
+  relayPoll();
+}
 
-    Serial.print("Radio RX data: ");
-    Serial.println(ledMode);
+// Requests over Serial: 'P' for the frame profile, 'W' for current estimates,
+// 'C' and 'c' to start and stop capturing frames (tools/capture.py)
+void serialPoll()
+{
+  if (!Serial.available())
+    return;
 
-    // clear all pixels ready for the new mode
-    FastLED.clear();
+  switch (Serial.read())
+  {
+  case 'P':
+    profileDump(numLeds);
+    break;
+  case 'W':
+    powerReport();
+    break;
+  case 'C':
+    captureStart(numLeds);
+    break;
+  case 'c':
+    captureStop();
+    break;
   }
 }
 
+void showProgress(struct CRGB *targetArray, uint8_t progress)
+{
+  int lit = ((long)numLeds * progress) / 255;
+  fill_solid(targetArray, numLeds, CRGB::Black);
+  fill_solid(targetArray, lit, CRGB::DarkBlue);
+  ledShow();
+  powerRedraw();
+}
+
 void loop()
 {
-  // Add entropy to random number generator; we use a lot of it
-  random16_add_entropy(random());
+  if (bulkActive())
+  {
+    // chunks arrive far faster than frames; just keep the radio drained
+    profilePause();
+    readRadio();
+    channelPoll();
+    EVERY_N_MILLIS(500)
+    {
+      showProgress(leds, bulkProgress());
+    }
+    return;
+  }
 
   if (ledMode < 0 && millis() > IDLETIMEOUT) // no mode set yet
   {
@@ -188,7 +400,24 @@ void loop()
 
   int currentMode = ledMode;
 
+  profileFrame(currentMode);
+  serialPoll();
+
   readRadio();
+  relayPoll();
+  channelPoll();
+  if (watchdogPoll(ledMode) && ledMode == -3)
+    ledMode = watchdogResumed(); // up at last
+  int strobeMode = flashPoll(leds, numLeds, pollRadio);
+  if (strobeMode >= 0)
+    setMode(strobeMode);
+  profileMark(PROF_RADIO);
+
+  audioUpdate();
+  profileMark(PROF_AUDIO);
+
+  clockUpdate();
+  prngFrame(ledMode);
 
   switch (ledMode)
   {
@@ -264,16 +493,27 @@ void loop()
     break;
 
   case 50:
-    fire(leds, numLeds, WoodFireColors_p);
+    fire(leds, numLeds, paletteLut(WoodFireColors_p));
     break;
   case 51:
-    fire(leds, numLeds, CopperFireColors_p);
+    fire(leds, numLeds, paletteLut(CopperFireColors_p));
     break;
   case 52:
-    fire(leds, numLeds, AlcoholFireColors_p);
+    fire(leds, numLeds, paletteLut(AlcoholFireColors_p));
     break;
   case 53:
-    fire(leds, numLeds, LithiumFireColors_p);
+    fire(leds, numLeds, paletteLut(LithiumFireColors_p));
+    break;
+
+  case PALETTE_MODE_FIRST ... PALETTE_MODE_FIRST + PALETTE_SLOTS - 1:
+    if (const struct CRGB *lut = paletteLut((uint8_t)(ledMode - PALETTE_MODE_FIRST)))
+    {
+      fire(leds, numLeds, lut);
+    }
+    else
+    {
+      showError(leds, CRGB::DarkGray); // not received yet
+    }
     break;
 
   // bi-colors
@@ -329,6 +569,10 @@ void loop()
     rioFlag(leds, numLeds);
     break;
 
+  case 94:
+    drumHits(leds, numLeds);
+    break;
+
   case 97:
     hazards(leds, numLeds);
     break;
@@ -336,9 +580,9 @@ void loop()
   case 98:
     // quick white strobe - flashes multiple times because TX resends mode 3 times :-|
     fill_solid(leds, numLeds, CRGB::White);
-    FastLED.show();
-    FastLED.delay(30);
-    FastLED.clear();
+    ledShow();
+    ledDelay(30);
+    ledClear();
     ledMode = currentMode; // reinstate the previous mode
     break;
 
@@ -350,6 +594,19 @@ void loop()
     nineninenine(leds, numLeds);
     break;
 
+  case STREAM_MODE:
+    // frames rendered by the TX
+    streamRender(leds, numLeds);
+    break;
+
+  case VM_MODE_FIRST ... VM_MODE_FIRST + VM_SLOTS - 1:
+    // effect programs sent by the TX
+    if (!vmRender(leds, numLeds, ledMode - VM_MODE_FIRST))
+    {
+      showError(leds, CRGB::DarkGray); // not received yet
+    }
+    break;
+
   // ERROR MODES
   case -2:
     // file failure
@@ -367,6 +624,40 @@ void loop()
     break;
   }
 
-  FastLED.show(); // display this frame
-  FastLED.delay(1000 / FRAMES_PER_SECOND);
+  // quantise effects that rendered at 16 bits
+  profileMark(PROF_RENDER);
+  hiresResolve(leds, numLeds);
+  profileMark(PROF_DITHER);
+
+  // accent drum hits on top of the current effect, other than the hits mode itself
+  FastLED.setBrightness(ledMode == 94 ? max_bright : audioBrightness(max_bright));
+
+  bool changed = powerFrame(currentMode, leds, numLeds, FastLED.getBrightness());
+  profileMark(PROF_RENDER);
+
+  if (changed)
+    ledShow(); // display this frame
+  captureFrame(currentMode, leds);
+  profileMark(PROF_SHOW);
+
+  if (firstFrameMicros == 0)
+  {
+    firstFrameMicros = micros();
+  }
+  static bool diagnosticsPending = true;
+  if (diagnosticsPending && millis() > DIAGNOSTICS_DELAY)
+  {
+    diagnosticsPending = false;
+    bootDiagnostics();
+  }
+
+  // pace frames from when this one started, so with an asynchronous driver
+  // the time spent rendering and sending overlaps rather than adds up
+  static unsigned long nextFrame = 0;
+  nextFrame += 1000 / FRAMES_PER_SECOND;
+  long wait = (long)(nextFrame - millis());
+  if (wait > 0)
+    powerWait(wait);
+  else
+    nextFrame = millis(); // running behind; don't try to catch up
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "onset.h"
+
+void OnsetDetector::reset()
+{
+  dc = 512 << 8;
+  lastEnergy = 0;
+  meanFlux = 0;
+  holdoff = 0;
+  strength = 0;
+}
+
+bool OnsetDetector::process(const uint16_t *samples, uint8_t count)
+{
+  if (count == 0)
+    return false;
+
+  // Step 1.  Mean-square energy of this block around a slowly tracked DC level
+  uint32_t energy = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    int32_t x = (int32_t)samples[i] << 8;
+    dc += (x - dc) >> 8;
+    int32_t ac = (x - dc) >> 8; // +/-1023
+    energy += (uint32_t)(ac * ac);
+  }
+  energy /= count;
+
+  // Step 2.  Flux: only rising energy marks the start of a hit
+  uint32_t flux = energy > lastEnergy ? energy - lastEnergy : 0;
+  lastEnergy = energy;
+
+  // Step 3.  Adaptive threshold from the running mean of the flux
+  uint32_t threshold = ((meanFlux >> 4) * sensitivity) >> 4;
+  if (threshold < floor)
+    threshold = floor;
+  meanFlux = meanFlux - (meanFlux >> 4) + flux; // EMA over ~16 frames, Q4
+
+  if (holdoff > 0)
+  {
+    holdoff--;
+    return false;
+  }
+
+  if (flux <= threshold)
+    return false;
+
+  // Step 4.  Report how far over the threshold the hit was
+  uint32_t over = (flux * 64) / threshold; // 64 = just over
+  strength = over > 255 ? 255 : (uint8_t)over;
+  holdoff = refractory;
+  return true;
+}
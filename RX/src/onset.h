@@ -0,0 +1,31 @@
+#ifndef ONSET_H
+#define ONSET_H
+
+#include <stdint.h>
+
+// Drum-hit onset detector: energy flux against an adaptive
+// threshold, integer-only so it can run on the ESP8266 inside the frame
+// loop. Kept free of Arduino dependencies so tools/onset_wav.cpp can tune
+// it against recordings on the host.
+class OnsetDetector
+{
+public:
+  uint8_t sensitivity = 24; // threshold multiplier over mean flux, Q4 (24 = 1.5x)
+  uint16_t floor = 64;      // minimum flux (mean square, ADC units) to count as a hit
+  uint8_t refractory = 3;   // frames to ignore after a hit, so one hit = one onset
+
+  uint8_t strength = 0; // 0-255 strength of the most recent onset
+
+  void reset();
+
+  // Feed one frame's worth of raw 10-bit ADC samples; true on an onset
+  bool process(const uint16_t *samples, uint8_t count);
+
+private:
+  int32_t dc = 512 << 8; // running DC offset of the input, Q8
+  uint32_t lastEnergy = 0;
+  uint32_t meanFlux = 0; // Q4
+  uint8_t holdoff = 0;
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include <Arduino.h>
+#define FASTLED_ALLOW_INTERRUPTS 0
+#include <FastLED.h>
+
+#include "output.h"
+#include "arena.h"
+#include "uartwire.h"
+
+#define CORRECTION TypicalPixelString
+
+#ifdef ESP8266
+extern "C"
+{
+#include <user_interface.h>
+}
+
+// FastLED times the WS2812 bits by counting CPU cycles, for the clock it
+// was built for (F_CPU); the power governor may have changed it since
+class BuildClock
+{
+public:
+  BuildClock() : mhz(system_get_cpu_freq())
+  {
+    if (mhz != F_CPU / 1000000)
+      system_update_cpu_freq(F_CPU / 1000000);
+  }
+  ~BuildClock()
+  {
+    if (mhz != F_CPU / 1000000)
+      system_update_cpu_freq(mhz);
+  }
+
+private:
+  uint8_t mhz;
+};
+#else
+struct BuildClock
+{
+};
+#endif
+
+// The original path: FastLED bit-bangs the strip with interrupts off,
+// so show() blocks for ~30us per pixel. Several strips go out one after
+// another, on the pins left free by the radio: D4, D1 and D3.
+class FastLEDDriver : public LedDriver
+{
+public:
+  bool begin(struct CRGB *leds, const LedStrip *strips, uint8_t stripCount) override
+  {
+    for (uint8_t s = 0; s < stripCount; s++)
+    {
+      // the pin is a template parameter, so each one needs its own case
+      switch (strips[s].pin)
+      {
+      case 2:
+        LEDS.addLeds<WS2812, 2, GRB>(leds, strips[s].count).setCorrection(CORRECTION);
+        break;
+      case 5:
+        LEDS.addLeds<WS2812, 5, GRB>(leds, strips[s].count).setCorrection(CORRECTION);
+        break;
+      case 0:
+        LEDS.addLeds<WS2812, 0, GRB>(leds, strips[s].count).setCorrection(CORRECTION);
+        break;
+      default:
+        Serial.printf("Can't drive a strip on GPIO%u\n", strips[s].pin);
+        break;
+      }
+      leds += strips[s].count;
+    }
+    FastLED.setMaxPowerInVoltsAndMilliamps(LED_VOLTS, LED_MAX_MA);
+    return true;
+  }
+
+  void show(const struct CRGB *leds, int numLeds, uint8_t brightness) override
+  {
+    BuildClock clock;
+    FastLED.show(brightness);
+  }
+
+  bool busy() override
+  {
+    return false;
+  }
+
+  void wait(unsigned long ms) override
+  {
+    BuildClock clock;
+    FastLED.delay(ms); // re-shows the frame, which lets FastLED dither
+  }
+};
+
+#ifdef ESP8266
+
+// GPIO2 is also UART1's TX pin, so the hardware UART can generate the
+// WS2812 waveform for us. At 3.2Mbaud, 6N1 with the output inverted, each
+// UART character is 8 bit-times: the start bit, six data bits and the stop
+// bit make two 1.25us WS2812 bits (see uartwire.h). A frame is encoded into a wire buffer
+// and a timer interrupt keeps the 128-byte TX FIFO topped up, so the CPU is
+// free to render (and talk to the radio) while the strip is clocked out.
+#define UART_BAUD UART_WIRE_BAUD
+#define UART_FIFO_SIZE UART_WIRE_FIFO
+#define UART_REFILL_US UART_WIRE_REFILL_US
+#define LATCH_US 300       // WS2812B needs the line low this long to latch
+
+static uint8_t *wire = nullptr;
+static size_t wireSize = 0; // in LEDs
+static volatile size_t wireLength = 0;
+static volatile size_t wireSent = 0;
+static volatile unsigned long wireEmpty = 0; // micros() when the FIFO will have run dry
+static volatile unsigned long wireDone = 0;  // and when it did, once the last byte was queued
+
+static void IRAM_ATTR uartRefill()
+{
+  size_t queued = (USS(UART1) >> USTXC) & 0xFF;
+  unsigned long now = micros();
+
+  // too late: a strip may have latched part of the frame, so let them all,
+  // then start again
+  if (queued == 0 && wireSent > 0 && wireSent < wireLength && (long)(now - wireEmpty) > UART_WIRE_GAP_US)
+  {
+    wireSent = 0;
+    timer1_write(LATCH_US * 5);
+    return;
+  }
+
+  while (queued < UART_FIFO_SIZE && wireSent < wireLength)
+  {
+    USF(UART1) = wire[wireSent++];
+    queued++;
+  }
+  wireEmpty = now + uartWireUs(queued);
+
+  if (wireSent == wireLength)
+  {
+    timer1_disable();
+    // time for the FIFO to empty, plus the latch
+    wireDone = wireEmpty;
+  }
+  else
+  {
+    timer1_write(UART_REFILL_US * 5); // 5 ticks/us at DIV16
+  }
+}
+
+class Uart1Driver : public LedDriver
+{
+public:
+  bool begin(struct CRGB *leds, const LedStrip *strips, uint8_t stripCount) override
+  {
+    // UART1 only comes out on GPIO2, so this is for a single strip there
+    if (stripCount != 1 || strips[0].pin != 2)
+      return false;
+
+    wire = (uint8_t *)arenaAlloc(strips[0].count * ARENA_WIRE);
+    if (wire == nullptr)
+      return false;
+    wireSize = strips[0].count;
+
+    Serial1.begin(UART_BAUD, SERIAL_6N1, SERIAL_TX_ONLY);
+    USC0(UART1) |= (1 << UCTXI); // idle low, as the strip expects
+
+    correction = CRGB(CORRECTION);
+    timer1_attachInterrupt(uartRefill);
+    return true;
+  }
+
+  void show(const struct CRGB *leds, int numLeds, uint8_t brightness) override
+  {
+    while (busy())
+    {
+      // only if frames are shown back-to-back faster than they go out
+    }
+
+    if (numLeds > (int)wireSize)
+      numLeds = wireSize;
+
+    // FastLED would apply these for us; limit power, then correct colour
+    brightness = calculate_max_brightness_for_power_vmA(leds, numLeds, brightness, LED_VOLTS, LED_MAX_MA);
+    uint8_t scale[3];
+    for (uint8_t c = 0; c < 3; c++)
+      scale[c] = ((uint16_t)correction.raw[c] * (brightness + 1)) >> 8;
+
+    uint8_t *out = wire;
+    for (int i = 0; i < numLeds; i++)
+    {
+      // GRB order on the wire
+      const uint8_t channels[3] = {scale8(leds[i].g, scale[1]), scale8(leds[i].r, scale[0]), scale8(leds[i].b, scale[2])};
+      for (uint8_t c = 0; c < 3; c++)
+        out = uartWireEncode(channels[c], out);
+    }
+
+    wireSent = 0;
+    wireLength = out - wire;
+    uartRefill();
+    if (wireSent < wireLength)
+    {
+      timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+      timer1_write(UART_REFILL_US * 5); // 5 ticks/us at DIV16
+    }
+  }
+
+  bool busy() override
+  {
+    return wireSent < wireLength || (long)(micros() - wireDone) < LATCH_US;
+  }
+
+  void wait(unsigned long ms) override
+  {
+    delay(ms); // the strip holds its last frame by itself
+  }
+
+private:
+  struct CRGB correction;
+};
+
+#endif
+
+static LedDriver *driver = nullptr;
+static struct CRGB *frame = nullptr;
+static int frameLength = 0;
+
+void ledBegin(struct CRGB *leds, const LedStrip *strips, uint8_t stripCount, bool async)
+{
+  frame = leds;
+  frameLength = 0;
+  for (uint8_t s = 0; s < stripCount; s++)
+    frameLength += strips[s].count;
+
+#ifdef ESP8266
+  if (async)
+  {
+    driver = new Uart1Driver();
+    if (!driver->begin(leds, strips, stripCount))
+    {
+      Serial.println("Asynchronous output needs a single strip on D4; using FastLED");
+      delete driver;
+      driver = nullptr;
+    }
+  }
+#endif
+  if (driver == nullptr)
+  {
+    driver = new FastLEDDriver();
+    driver->begin(leds, strips, stripCount);
+  }
+}
+
+void ledShow()
+{
+  driver->show(frame, frameLength, FastLED.getBrightness());
+}
+
+void ledDelay(unsigned long ms)
+{
+  driver->wait(ms);
+}
+
+bool ledBusy()
+{
+  return driver->busy();
+}
+
+// Each pixel only shows its new colour once the whole frame has been
+// clocked out, whichever driver sends it, so a bigger drum lights later
+uint32_t ledLatencyUs()
+{
+  return frameLength * LED_WIRE_US + LED_RESET_US;
+}
+
+void ledClear(bool show)
+{
+  fill_solid(frame, frameLength, CRGB::Black);
+  if (show)
+    ledShow();
+}
@@ -0,0 +1,23 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <FastLED.h>
+
+#include "config.h"
+#include "leddriver.h"
+
+// LED output stage, see output.cpp
+
+#define LED_VOLTS 5
+#define LED_MAX_MA 2000 // brightness is limited to keep the strips under this
+#define LED_WIRE_US 30   // to clock one pixel out, 24 bits of 1.25uS
+#define LED_RESET_US 280 // a WS2812B takes its new colour after the line is low this long
+
+void ledBegin(struct CRGB *leds, const LedStrip *strips, uint8_t stripCount, bool async);
+void ledShow();
+void ledDelay(unsigned long ms);
+bool ledBusy(); // still sending the last frame
+uint32_t ledLatencyUs(); // from ledShow() to the strip lighting up
+void ledClear(bool show = false);
+
+#endif
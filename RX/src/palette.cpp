@@ -0,0 +1,149 @@
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "palette.h"
+
+// ColorFromPalette() reads two entries of a 16-colour palette, from flash
+// for the built-in ones, and interpolates between them, for every pixel of
+// every frame. Instead the palette in use is expanded once into a table of
+// all 256 colours, so an effect looks up a pixel's colour with one indexed
+// load. Switching to another palette straight from one in use blends
+// between the two over a second; only then is the table rebuilt each frame.
+
+#define PALETTE_BLEND_MS 1000
+#define PALETTE_IDLE_MS 200 // unused this long, a palette is switched to at once
+
+struct PaletteSlot
+{
+  uint16_t crc;
+  uint8_t partsReceived; // bitmap
+  bool valid;
+  uint8_t rgb[16 * 3];
+  CRGBPalette16 palette;
+};
+
+static struct CRGB lut[256];
+static CRGBPalette16 current; // as in the table; part-way through a blend, a mix of the two
+static CRGBPalette16 from;
+static CRGBPalette16 to;
+static const void *source = nullptr; // whichever palette "to" came from
+static bool blending = false;
+static unsigned long blendStart = 0;
+static unsigned long lastUsed = 0;
+
+static PaletteSlot slots[PALETTE_SLOTS];
+
+static void expand()
+{
+  for (int i = 0; i < 256; i++)
+    lut[i] = ColorFromPalette(current, i);
+}
+
+static void start(const void *id, const CRGBPalette16 &palette)
+{
+  unsigned long now = millis();
+  if (source != nullptr && now - lastUsed < PALETTE_IDLE_MS)
+  {
+    from = current;
+    blending = true;
+    blendStart = now;
+  }
+  else
+  {
+    current = palette;
+    blending = false;
+    expand();
+  }
+  to = palette;
+  source = id;
+}
+
+static const struct CRGB *update()
+{
+  unsigned long now = millis();
+  if (blending)
+  {
+    unsigned long elapsed = now - blendStart;
+    if (elapsed >= PALETTE_BLEND_MS)
+    {
+      current = to;
+      blending = false;
+    }
+    else
+    {
+      fract8 amount = elapsed * 256 / PALETTE_BLEND_MS;
+      for (uint8_t i = 0; i < 16; i++)
+        current[i] = blend(from[i], to[i], amount);
+    }
+    expand();
+  }
+  lastUsed = now;
+  return lut;
+}
+
+const struct CRGB *paletteLut(const TProgmemRGBPalette16 &palette)
+{
+  if (source != &palette)
+    start(&palette, CRGBPalette16(palette));
+  return update();
+}
+
+const struct CRGB *paletteLut(uint8_t slot)
+{
+  if (slot >= PALETTE_SLOTS || !slots[slot].valid)
+    return nullptr;
+
+  if (source != &slots[slot])
+    start(&slots[slot], slots[slot].palette);
+  return update();
+}
+
+// A slot's colours are complete: make them its palette
+static void install(PaletteSlot &slot)
+{
+  for (uint8_t i = 0; i < 16; i++)
+    slot.palette[i] = CRGB(slot.rgb[i * 3], slot.rgb[i * 3 + 1], slot.rgb[i * 3 + 2]);
+  slot.valid = true;
+  if (source == &slot)
+    source = nullptr; // in use; pick up the new colours
+}
+
+void palettePacket(const PaletteBody &part)
+{
+  if (part.slot >= PALETTE_SLOTS || part.part >= 2)
+    return;
+
+  PaletteSlot &slot = slots[part.slot];
+  if (part.crc != slot.crc)
+  {
+    // a new palette for this slot; the old one stays until it's complete
+    slot.crc = part.crc;
+    slot.partsReceived = 0;
+  }
+  if (slot.partsReceived & (1 << part.part))
+    return;
+
+  memcpy(slot.rgb + part.part * sizeof(part.rgb), part.rgb, sizeof(part.rgb));
+  slot.partsReceived |= 1 << part.part;
+  if (slot.partsReceived != 0b11 || drumCrc16(slot.rgb, sizeof(slot.rgb)) != slot.crc)
+    return;
+
+  install(slot);
+  Serial.printf("Palette in slot %u received\n", part.slot);
+}
+
+void paletteLoad(uint8_t slotNumber, const uint8_t *rgb)
+{
+  if (slotNumber >= PALETTE_SLOTS)
+    return;
+
+  PaletteSlot &slot = slots[slotNumber];
+  uint16_t crc = drumCrc16(rgb, sizeof(slot.rgb));
+  if (slot.valid && slot.crc == crc)
+    return; // already have it
+
+  memcpy(slot.rgb, rgb, sizeof(slot.rgb));
+  slot.crc = crc;
+  slot.partsReceived = 0b11;
+  install(slot);
+}
@@ -0,0 +1,21 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <FastLED.h>
+#include <DrumRadio.h>
+
+// Palettes expanded to 256-entry tables, see palette.cpp
+
+// The table for a built-in palette; changing palette blends from the last
+const struct CRGB *paletteLut(const TProgmemRGBPalette16 &palette);
+
+// The table for a palette sent over the air, nullptr if there isn't one
+const struct CRGB *paletteLut(uint8_t slot);
+
+// Half of a palette from the TX
+void palettePacket(const PaletteBody &part);
+
+// A whole palette for a slot, e.g. from a scene: 16 colours as RGB bytes
+void paletteLoad(uint8_t slot, const uint8_t *rgb);
+
+#endif
@@ -0,0 +1,291 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <FastLED.h>
+
+extern "C"
+{
+#include <user_interface.h>
+}
+
+#include "power.h"
+#include "output.h"
+
+// The receiver only needs the nRF24, so the ESP8266's WiFi modem, which
+// would otherwise idle at some 70mA, is switched off at boot.
+//
+// With power saving on:
+// - the CPU runs at 80MHz unless the current mode takes more than
+//   CLOCK_UP_PERCENT of the frame time to render, when it goes to 160MHz,
+//   coming back down after CLOCK_QUIET_FRAMES frames in a row under
+//   CLOCK_DOWN_PERCENT. Each mode's clock is remembered for next time.
+// - frames the same as the one on the strip aren't shown again, and the
+//   wait between frames idles rather than re-showing the frame to dither.
+//   After STATIC_FRAMES of them, frames slow to one per STATIC_FRAME_MS.
+// - while the strip is dark, waits are spent in light sleep, woken by a
+//   timer or, if it is wired, the nRF24's IRQ as a packet arrives. millis()
+//   may not count light sleep, so it is kept to frames where nothing moves.
+// - without the IRQ, the radio is only read between waits, and the nRF24
+//   holds just three packets, so no wait runs past UNWIRED_WAIT_MS. A
+//   strobe is cued 100ms ahead with a copy every 10ms (see flash.cpp);
+//   this leaves most of them to be read while the drum spins for it, rather
+//   than lost, or read late from the FIFO after a long sleep.
+//
+// For powerReport(), each mode's time awake at each clock and asleep is
+// totted up, along with its LEDs' draw as FastLED reckons it.
+
+#define FRAME_US (1000000 / 35)
+#define CLOCK_UP_PERCENT 60
+#define CLOCK_DOWN_PERCENT 25 // i.e. about half the frame, at 80MHz
+#define CLOCK_QUIET_FRAMES 35
+#define STATIC_FRAMES 8
+#define STATIC_FRAME_MS 100
+#define SLEEP_MIN_MS 10
+#define UNWIRED_WAIT_MS 40 // longest wait without the radio's IRQ
+#define POWER_MODES 16 // modes tracked; later ones share the last slot
+#define LED_SAMPLE_FRAMES 8
+
+// Rough figures from datasheets; worth checking against a meter for a
+// particular build
+#define RADIO_MA 14    // nRF24 listening; PA/LNA modules draw a little more
+#define ESP_MA_80 16   // ESP8266 with the modem off, at 80MHz
+#define ESP_MA_160 22  // and at 160MHz
+#define ESP_MA_SLEEP 1 // in light sleep
+#define REPORT_MAH 10000 // battery the report gives run times for
+
+struct ModePower
+{
+  int16_t mode;
+  uint8_t mhz;
+  uint8_t quietFrames;
+  uint32_t frames;
+  uint64_t awakeUs[2]; // at 80 and 160MHz
+  uint64_t sleepUs;
+  uint64_t ledMa; // total of the samples
+  uint32_t ledSamples;
+};
+
+static ModePower modes[POWER_MODES];
+static uint8_t modeCount = 0;
+static ModePower *current = nullptr;
+
+static bool saving = false;
+static uint8_t irq = 0;
+static uint32_t awakeSince = 0; // micros()
+static uint32_t frameStart = 0;
+static uint32_t lastHash = 0;
+static bool shown = false; // the strip shows the frame that hashed to lastHash
+static bool dark = false;
+static uint8_t unchangedFrames = 0;
+
+static ModePower &modePower(int mode)
+{
+  for (uint8_t m = 0; m < modeCount; m++)
+  {
+    if (modes[m].mode == mode)
+      return modes[m];
+  }
+  if (modeCount < POWER_MODES)
+  {
+    modes[modeCount].mode = mode;
+    modes[modeCount].mhz = 80;
+    return modes[modeCount++];
+  }
+  return modes[POWER_MODES - 1];
+}
+
+static void chargeAwake()
+{
+  uint32_t now = micros();
+  if (current)
+    current->awakeUs[system_get_cpu_freq() > 80] += now - awakeSince;
+  awakeSince = now;
+}
+
+static void setClock(uint8_t mhz)
+{
+  if (system_get_cpu_freq() == mhz)
+    return;
+  chargeAwake();
+  system_update_cpu_freq(mhz);
+}
+
+void powerBegin(bool save, uint8_t irqPin)
+{
+  WiFi.mode(WIFI_OFF);
+  WiFi.forceSleepBegin();
+  delay(1); // the modem goes off once the SDK gets a look in
+
+  saving = save;
+  irq = irqPin;
+  if (irq)
+    pinMode(irq, INPUT);
+  awakeSince = frameStart = micros();
+
+  if (saving)
+    Serial.printf("Power saving on%s\n", irq ? ", waking on the radio's IRQ" : "");
+}
+
+// Cheap enough to run over every frame: FNV-1a, a word at a time
+static uint32_t frameHash(const uint8_t *bytes, int length, uint8_t brightness, bool &anyLit)
+{
+  uint32_t hash = 2166136261u ^ brightness;
+  uint32_t lit = 0;
+  int i = 0;
+  for (; i + 4 <= length; i += 4)
+  {
+    uint32_t word;
+    memcpy(&word, bytes + i, 4);
+    hash = (hash ^ word) * 16777619u;
+    lit |= word;
+  }
+  for (; i < length; i++)
+  {
+    hash = (hash ^ bytes[i]) * 16777619u;
+    lit |= bytes[i];
+  }
+  anyLit = lit != 0 && brightness != 0;
+  return hash;
+}
+
+bool powerFrame(int mode, const struct CRGB *leds, int numLeds, uint8_t brightness)
+{
+  ModePower &entry = modePower(mode);
+  if (&entry != current)
+  {
+    chargeAwake();
+    current = &entry;
+    unchangedFrames = 0;
+    if (saving)
+      setClock(entry.mhz);
+  }
+  entry.frames++;
+
+  if (saving)
+  {
+    // what this frame cost to get this far, at the clock it ran at
+    uint32_t cost = micros() - frameStart;
+    if (entry.mhz < 160)
+    {
+      if (cost > FRAME_US * CLOCK_UP_PERCENT / 100)
+      {
+        entry.mhz = 160;
+        setClock(160);
+      }
+    }
+    else if (cost >= FRAME_US * CLOCK_DOWN_PERCENT / 100)
+    {
+      entry.quietFrames = 0;
+    }
+    else if (++entry.quietFrames >= CLOCK_QUIET_FRAMES)
+    {
+      entry.mhz = 80;
+      entry.quietFrames = 0;
+      setClock(80);
+    }
+  }
+
+  if (entry.frames % LED_SAMPLE_FRAMES == 1)
+  {
+    // as output.cpp limits it
+    uint8_t limited = calculate_max_brightness_for_power_vmA(leds, numLeds, brightness, LED_VOLTS, LED_MAX_MA);
+    entry.ledMa += (uint64_t)calculate_unscaled_power_mW(leds, numLeds) * limited / 256 / LED_VOLTS;
+    entry.ledSamples++;
+  }
+
+  bool lit;
+  uint32_t hash = frameHash((const uint8_t *)leds, numLeds * 3, brightness, lit);
+  bool changed = !shown || hash != lastHash;
+  lastHash = hash;
+  shown = true;
+  dark = !lit;
+  if (changed)
+    unchangedFrames = 0;
+  else if (unchangedFrames < 255)
+    unchangedFrames++;
+
+  return changed || !saving;
+}
+
+void powerRedraw()
+{
+  shown = false;
+}
+
+static void wake()
+{
+}
+
+static void lightSleep(unsigned long ms)
+{
+  uint32_t rtcStart = system_get_rtc_time();
+
+  // swap the modem's forced sleep for a light sleep of the whole chip
+  wifi_fpm_close();
+  wifi_fpm_set_sleep_type(LIGHT_SLEEP_T);
+  wifi_fpm_open();
+  wifi_fpm_set_wakeup_cb(wake);
+  if (irq)
+    gpio_pin_wakeup_enable(GPIO_ID_PIN(irq), GPIO_PIN_INTR_LOLEVEL);
+  wifi_fpm_do_sleep(ms * 1000);
+  delay(ms + 1); // the chip sleeps once the SDK is idle
+
+  if (irq)
+    gpio_pin_wakeup_disable();
+  wifi_fpm_close();
+  wifi_fpm_set_sleep_type(MODEM_SLEEP_T);
+  wifi_fpm_open();
+  wifi_fpm_do_sleep(0xFFFFFFF);
+
+  // the RTC keeps counting through light sleep; its period is in us, Q12
+  uint64_t us = ((uint64_t)(system_get_rtc_time() - rtcStart) * system_rtc_clock_cali_proc()) >> 12;
+  if (current)
+    current->sleepUs += us;
+  awakeSince = micros();
+}
+
+void powerWait(unsigned long ms)
+{
+  chargeAwake();
+
+  if (!saving)
+  {
+    ledDelay(ms);
+  }
+  else
+  {
+    if (unchangedFrames >= STATIC_FRAMES)
+      ms += STATIC_FRAME_MS - FRAME_US / 1000;
+    if (!irq && ms > UNWIRED_WAIT_MS)
+      ms = UNWIRED_WAIT_MS;
+
+    if (dark && unchangedFrames > 0 && ms >= SLEEP_MIN_MS && !ledBusy())
+      lightSleep(ms);
+    else
+      delay(ms);
+  }
+
+  chargeAwake();
+  frameStart = micros();
+}
+
+void powerReport()
+{
+  Serial.printf("Estimated current: radio %u mA, ESP8266 %u/%u mA at 80/160MHz and %u mA asleep, plus LEDs\n", RADIO_MA,
+                ESP_MA_80, ESP_MA_160, ESP_MA_SLEEP);
+  Serial.printf(" mode   frames  160MHz  asleep  ESP mA  LED mA  total mA  hours/%umAh\n", REPORT_MAH);
+  for (uint8_t m = 0; m < modeCount; m++)
+  {
+    const ModePower &entry = modes[m];
+    uint64_t totalUs = entry.awakeUs[0] + entry.awakeUs[1] + entry.sleepUs;
+    if (totalUs == 0)
+      continue;
+
+    uint32_t espMa = (entry.awakeUs[0] * ESP_MA_80 + entry.awakeUs[1] * ESP_MA_160 + entry.sleepUs * ESP_MA_SLEEP) / totalUs;
+    uint32_t ledMa = entry.ledSamples ? entry.ledMa / entry.ledSamples : 0;
+    uint32_t totalMa = RADIO_MA + espMa + ledMa;
+    uint32_t tenthsOfHours = REPORT_MAH * 10 / totalMa;
+    Serial.printf("%5d %8u %6u%% %6u%% %7u %7u %9u %9u.%u\n", entry.mode, entry.frames,
+                  (unsigned)(entry.awakeUs[1] * 100 / totalUs), (unsigned)(entry.sleepUs * 100 / totalUs), espMa,
+                  ledMa, totalMa, tenthsOfHours / 10, tenthsOfHours % 10);
+  }
+}
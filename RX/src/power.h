@@ -0,0 +1,26 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+// Power management and current estimates, see power.cpp
+
+// Turn the WiFi modem off. With save, also clock the CPU to suit each
+// effect, don't re-show frames that haven't changed, and sleep while the
+// strip is dark. irqPin is the GPIO wired to the nRF24's IRQ, 0 if none.
+void powerBegin(bool save, uint8_t irqPin);
+
+// A frame of mode has been rendered into leds at this brightness; false if
+// it is what the strip already shows, so needn't be shown again
+bool powerFrame(int mode, const struct CRGB *leds, int numLeds, uint8_t brightness);
+
+// The strip was drawn on outside the frame loop; show the next frame
+void powerRedraw();
+
+// Wait ms for the next frame; while frames aren't changing, a little longer
+void powerWait(unsigned long ms);
+
+// Print the estimated current draw of each mode seen so far over Serial
+void powerReport();
+
+#endif
@@ -0,0 +1,88 @@
+#include <DrumRadio.h>
+
+#include "prng.h"
+#include "clock.h"
+
+// Effects draw their randomness from here rather than FastLED's shared
+// generator, which every drum seeds differently. Each frame the generator
+// is reseeded from the mode, the band's seed, this drum's salt and a frame
+// number taken from the shared beat clock, so drums in step render the same
+// frames, and the same inputs always give the same output. Below about 130
+// BPM there are fewer frame numbers than frames, so a frame that shares its
+// number with the last one carries on the last one's stream rather than
+// repeating its draws; drums come back into step at the next number.
+
+#define TICK_BITS 4 // 16 frame numbers per beat, ~32 a second at 120 BPM
+
+static uint32_t bandSeed = 0;
+static uint8_t drumSalt = 0;
+static uint32_t state = 1;
+static int seededMode = -1; // what state was last seeded from, -1 for nothing
+static uint32_t seededTick = 0;
+
+// murmur3's finaliser: a cheap way to spread a few similar inputs over
+// the whole state
+static uint32_t mix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85EBCA6B;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35;
+  h ^= h >> 16;
+  return h;
+}
+
+void prngBegin(uint8_t salt)
+{
+  drumSalt = salt;
+  seededMode = -1;
+}
+
+void prngBandSeed(uint16_t seed)
+{
+  if (seed != bandSeed)
+    seededMode = -1;
+  bandSeed = seed;
+}
+
+void prngFrame(int mode)
+{
+  uint32_t tick = clockBeats() >> (BEAT_FRACTION_BITS - TICK_BITS);
+  if (mode == seededMode && tick == seededTick)
+    return;
+  seededMode = mode;
+  seededTick = tick;
+
+  state = mix(mix((uint32_t)mode ^ (bandSeed << 8) ^ ((uint32_t)drumSalt << 24)) ^ tick);
+  if (state == 0)
+    state = 1; // xorshift never leaves 0
+}
+
+static uint32_t next()
+{
+  // xorshift32
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+uint8_t prng8()
+{
+  return next() >> 24;
+}
+
+uint8_t prng8(uint8_t lim)
+{
+  return ((next() >> 24) * lim) >> 8;
+}
+
+uint8_t prng8(uint8_t min, uint8_t lim)
+{
+  return min + prng8(lim - min);
+}
+
+uint16_t prng16(uint16_t lim)
+{
+  return ((next() >> 16) * lim) >> 16;
+}
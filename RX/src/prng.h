@@ -0,0 +1,24 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <stdint.h>
+
+// Reproducible random numbers for effects, see prng.cpp
+
+// This drum's salt from config; 0 renders the same frames as every other
+// drum, anything else deliberately differs
+void prngBegin(uint8_t salt);
+
+// The seed the band shares, from the TX
+void prngBandSeed(uint16_t seed);
+
+// Reseed for this frame of the given mode, or carry on from the last frame
+// if the beat clock hasn't moved on a frame number; call once before rendering
+void prngFrame(int mode);
+
+uint8_t prng8();
+uint8_t prng8(uint8_t lim);              // 0 to lim - 1
+uint8_t prng8(uint8_t min, uint8_t lim); // min to lim - 1
+uint16_t prng16(uint16_t lim);           // 0 to lim - 1
+
+#endif
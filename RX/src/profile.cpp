@@ -0,0 +1,170 @@
+#include <Arduino.h>
+#include <DrumRadio.h>
+
+#include "profile.h"
+#include "ledcount.h"
+
+// A stuttering drum is hard to diagnose from Serial.println, so each frame
+// is timed and filed by mode: totals and worst case per section, and a
+// histogram of busy time, i.e. everything but idle. Frames that overrun the
+// budget are also kept, most recent last, in a small ring. Nothing is
+// printed while running; sending 'P' over Serial gets the lot in one
+// compact binary dump. Marks use micros() rather than the cycle counter,
+// as the power governor changes the CPU clock mid-frame; the cost is still
+// well under 1% of the budget.
+
+#define FRAME_BUDGET_US (1000000 / 35)
+#define PROFILE_MODES 16   // modes tracked; later ones share the last slot
+#define PROFILE_BUCKETS 16 // histogram buckets, the last is open-ended
+#define BUCKET_US 2000
+#define PROFILE_RING 16    // overrunning frames kept
+#define PROFILE_VERSION 4
+
+struct ModeProfile
+{
+  int16_t mode;
+  uint32_t frames;
+  uint32_t totalUs[PROF_SECTIONS];
+  uint32_t worstUs[PROF_SECTIONS];
+  uint32_t histogram[PROFILE_BUCKETS];
+};
+
+struct __attribute__((packed)) Overrun
+{
+  uint32_t millis;
+  int16_t mode;
+  uint16_t us[PROF_SECTIONS];
+};
+
+static ModeProfile modes[PROFILE_MODES];
+static uint8_t modeCount = 0;
+static Overrun ring[PROFILE_RING];
+static uint8_t ringNext = 0;
+static uint8_t ringCount = 0;
+static uint32_t counters[PROF_COUNTERS];
+
+static uint32_t frameUs[PROF_SECTIONS];
+static uint32_t lastMark = 0;
+static int frameMode = 0;
+static bool running = false;
+
+void profileMark(ProfileSection section)
+{
+  uint32_t now = micros();
+  frameUs[section] += now - lastMark;
+  lastMark = now;
+}
+
+void profilePause()
+{
+  running = false;
+}
+
+void profileCount(ProfileCounter counter)
+{
+  counters[counter]++;
+}
+
+void profileAdd(ProfileCounter counter, uint32_t amount)
+{
+  counters[counter] += amount;
+}
+
+static ModeProfile &modeProfile(int mode)
+{
+  for (uint8_t m = 0; m < modeCount; m++)
+  {
+    if (modes[m].mode == mode)
+      return modes[m];
+  }
+  if (modeCount < PROFILE_MODES)
+  {
+    modes[modeCount].mode = mode;
+    return modes[modeCount++];
+  }
+  return modes[PROFILE_MODES - 1];
+}
+
+void profileFrame(int mode)
+{
+  if (!running)
+  {
+    // nothing to file; just start timing from here
+    running = true;
+    lastMark = micros();
+    memset(frameUs, 0, sizeof(frameUs));
+    frameMode = mode;
+    return;
+  }
+  profileMark(PROF_IDLE);
+
+  uint32_t us[PROF_SECTIONS];
+  uint32_t busyUs = 0;
+  ModeProfile &profile = modeProfile(frameMode);
+  profile.frames++;
+  for (uint8_t s = 0; s < PROF_SECTIONS; s++)
+  {
+    us[s] = frameUs[s];
+    frameUs[s] = 0;
+    profile.totalUs[s] += us[s];
+    if (us[s] > profile.worstUs[s])
+      profile.worstUs[s] = us[s];
+    if (s != PROF_IDLE)
+      busyUs += us[s];
+  }
+
+  uint32_t bucket = busyUs / BUCKET_US;
+  profile.histogram[bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1]++;
+
+  if (busyUs > FRAME_BUDGET_US)
+  {
+    counters[PROF_OVERRUNS]++;
+    Overrun &overrun = ring[ringNext];
+    overrun.millis = millis();
+    overrun.mode = frameMode;
+    for (uint8_t s = 0; s < PROF_SECTIONS; s++)
+      overrun.us[s] = us[s] > 0xFFFF ? 0xFFFF : us[s];
+    ringNext = (ringNext + 1) % PROFILE_RING;
+    if (ringCount < PROFILE_RING)
+      ringCount++;
+  }
+
+  frameMode = mode;
+}
+
+static uint16_t dumpCrc;
+
+static void dump(const void *data, size_t length)
+{
+  Serial.write((const uint8_t *)data, length);
+  dumpCrc = drumCrc16((const uint8_t *)data, length, dumpCrc);
+}
+
+void profileDump(uint16_t numLeds)
+{
+  // header, counters, modes, overruns oldest first, then a CRC of it all
+  struct __attribute__((packed))
+  {
+    char magic[4];
+    uint8_t version, sections, counters, buckets;
+    uint16_t bucketUs, budgetUs;
+    uint32_t uptime;
+    uint8_t modes, overruns;
+    uint16_t leds, builtLeds; // builtLeds 0 for the generic build
+  } header = {{'D', 'P', 'R', 'F'}, PROFILE_VERSION, PROF_SECTIONS, PROF_COUNTERS, PROFILE_BUCKETS,
+              BUCKET_US, FRAME_BUDGET_US, (uint32_t)millis(), modeCount, ringCount, numLeds, DRUM_LEDS};
+
+  dumpCrc = 0xFFFF;
+  dump(&header, sizeof(header));
+  dump(counters, sizeof(counters));
+  for (uint8_t m = 0; m < modeCount; m++)
+  {
+    dump(&modes[m].mode, sizeof(modes[m].mode));
+    dump(&modes[m].frames, sizeof(ModeProfile) - offsetof(ModeProfile, frames));
+  }
+  for (uint8_t i = 0; i < ringCount; i++)
+    dump(&ring[(ringNext + PROFILE_RING - ringCount + i) % PROFILE_RING], sizeof(Overrun));
+
+  uint16_t crc = dumpCrc;
+  Serial.write((const uint8_t *)&crc, sizeof(crc));
+}
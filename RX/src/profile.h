@@ -0,0 +1,56 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// Frame profiler and counters, see profile.cpp
+
+// Where a frame's time goes
+enum ProfileSection : uint8_t
+{
+  PROF_RADIO = 0, // polling and handling packets
+  PROF_AUDIO,     // reading the ADC and looking for a hit, see audio.cpp
+  PROF_RENDER,    // clock and the effect itself
+  PROF_DITHER,    // quantising a 16-bit frame, see hires.cpp
+  PROF_SHOW,      // getting the frame to the strip
+  PROF_IDLE,      // waiting for the next frame
+
+  PROF_SECTIONS
+};
+
+// Things worth counting on the hot path
+enum ProfileCounter : uint8_t
+{
+  PROF_PACKETS = 0,     // radio packets read
+  PROF_OVERRUNS,        // frames that took longer than the frame budget
+  PROF_VM_BUDGET,       // VM frames cut short by the instruction budget
+  PROF_RELAYS,          // packets relayed to other drums
+  PROF_RADIO_FAULTS,    // radio checks that failed, see watchdog.cpp
+  PROF_RADIO_SILENT,    // restarts after hearing nothing for a while
+  PROF_RADIO_RESTARTS,  // radio restarted and working again
+  PROF_RADIO_RECOVERY,  // uS from finding a fault to the radio working, in all
+  PROF_REBOOTS,         // reboots by the watchdog, carried across them
+
+  PROF_COUNTERS
+};
+
+// Charge the time since the last mark to a section of this frame
+void profileMark(ProfileSection section);
+
+// Start a new frame of the given mode, charging the wait since the last one
+// to PROF_IDLE and filing that frame away
+void profileFrame(int mode);
+
+// Drop the frame in progress, e.g. while the loop isn't rendering
+void profilePause();
+
+void profileCount(ProfileCounter counter);
+
+// Add to a counter that totals something other than events
+void profileAdd(ProfileCounter counter, uint32_t amount);
+
+// Send the profile over Serial, in the binary format decoded by
+// tools/profile_dump.py, noting the LED count and the one built for
+void profileDump(uint16_t numLeds);
+
+#endif
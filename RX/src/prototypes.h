@@ -14,8 +14,10 @@ extern const TProgmemRGBPalette16 PotassiumFireColors_p FL_PROGMEM = {CRGB::Blac
 // 21-      // bicolor chases
 void chase(struct CRGB *targetArray, int numLeds, const struct CRGB &color0, const struct CRGB &color1 = CRGB::Black);
 
-// 50
-void fire(struct CRGB *targetArray, int numLeds, const struct CRGBPalette16 &colorPalette);
+// 50-53
+// 55-58    // in palettes sent by the TX
+void fireBegin(int numLeds);
+void fire(struct CRGB *targetArray, int numLeds, const struct CRGB *colorLut);
 
 // 61-      // bicolor twinkles
 // 81-88    // single color twinkles (green, yellow, blue, red, white, cyan, magenta, orange)
@@ -26,6 +28,11 @@ void rioSpin(struct CRGB *targetArray, int numLeds);
 void rioDisco(struct CRGB *targetArray, int numLeds);
 void rioFlag(struct CRGB *targetArray, int numLeds);
 
+// 94       // white flash on every drum hit (needs [audio] in config)
+void drumHits(struct CRGB *targetArray, int numLeds);
+
+// 95       // frames streamed from the TX, see stream.cpp
+
 // 97
 void hazards(struct CRGB *targetArray, int numLeds);
 
@@ -37,3 +44,8 @@ void rainbow(struct CRGB *targetArray, int numLeds);
 
 // 199 blue strobe
 void nineninenine(struct CRGB *targetArray, int numLeds);
+
+// audio onset detection, see audio.cpp
+void audioBegin(int sensitivity, bool accentEffects);
+bool audioUpdate();
+uint8_t audioBrightness(uint8_t maxBright);
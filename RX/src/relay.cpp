@@ -0,0 +1,52 @@
+#include <Arduino.h>
+#include <RF24.h>
+
+#include "relay.h"
+#include "flood.h"
+#include "profile.h"
+#include "flash.h"
+
+// Relays go out on the TX's own address, so every drum in range hears them
+// just as if the TX had sent them. The radio is only polled once a frame,
+// so in practice each hop takes a frame or two.
+
+extern RF24 radio;
+
+static Flood flood;
+
+void relayBegin(uint8_t hops, const uint8_t *address)
+{
+  flood.maxHops = hops;
+  if (hops == 0)
+    return;
+
+  radio.openWritingPipe(address);
+  radio.startListening();
+  Serial.printf("Relaying commands for up to %u hops\n", hops);
+}
+
+bool relayHeard(const DrumPacket &packet)
+{
+  // the hardware RNG, as the effects' shared one would have every drum
+  // back off by the same amount
+  return flood.heard(packet, millis(), ESP.random());
+}
+
+void relayPoll()
+{
+  DrumPacket packet;
+  bool sent = false;
+  while (flood.due(packet, millis()))
+  {
+    // a strobe is cued for a moment, which has come closer while it waited
+    if (drumPacketType(packet) == PACKET_STROBE && !flashRelay(packet.strobe))
+      continue;
+    if (!sent)
+      radio.stopListening();
+    radio.write(&packet, sizeof(packet), true);
+    profileCount(PROF_RELAYS);
+    sent = true;
+  }
+  if (sent)
+    radio.startListening();
+}
@@ -0,0 +1,20 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Relaying commands to drums out of the TX's range, see flood.h
+
+// Relay packets that have made fewer than hops hops; 0 relays nothing.
+// address is the one the TX sends to.
+void relayBegin(uint8_t hops, const uint8_t *address);
+
+// A packet just read from the TX or another drum; false if it is a
+// relayed copy of one already heard, which should be ignored
+bool relayHeard(const DrumPacket &packet);
+
+// Send any relays that are due; call every frame after reading the radio
+void relayPoll();
+
+#endif
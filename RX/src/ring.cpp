@@ -0,0 +1,46 @@
+#include <FastLED.h>
+
+#include "ring.h"
+#include "arena.h"
+
+// Patterns that only ever rotate are drawn once into this buffer when the
+// mode starts; each frame is then just two contiguous copies into leds[],
+// however fast the rotation and however complex the pattern.
+static struct CRGB *ring = nullptr;
+static int ringSize = 0;
+static RingPattern ringPattern = nullptr;
+static int ringLength = 0;
+
+void ringBegin(int numLeds)
+{
+  ring = (struct CRGB *)arenaAlloc(numLeds * sizeof(CRGB));
+  ringSize = ring ? numLeds : 0;
+}
+
+void ringReset()
+{
+  ringPattern = nullptr;
+}
+
+void ringShow(struct CRGB *targetArray, int numLeds, RingPattern pattern, int offset)
+{
+  if (numLeds > ringSize)
+    numLeds = ringSize;
+  if (numLeds == 0)
+    return;
+
+  if (pattern != ringPattern || numLeds != ringLength)
+  {
+    pattern(ring, numLeds);
+    ringPattern = pattern;
+    ringLength = numLeds;
+  }
+
+  offset %= numLeds;
+  if (offset < 0)
+    offset += numLeds;
+
+  // pattern pixel i lands on targetArray[i + offset], wrapping round the drum
+  memcpy(targetArray + offset, ring, (numLeds - offset) * sizeof(CRGB));
+  memcpy(targetArray, ring + (numLeds - offset), offset * sizeof(CRGB));
+}
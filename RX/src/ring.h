@@ -0,0 +1,21 @@
+#ifndef RING_H
+#define RING_H
+
+#include <FastLED.h>
+
+// Rotating ring view, see ring.cpp
+
+// Take the pattern buffer from the arena, once at boot
+void ringBegin(int numLeds);
+
+// Draws a static pattern of numLeds pixels into pattern[]
+typedef void (*RingPattern)(struct CRGB *pattern, int numLeds);
+
+// Copy the pattern to targetArray rotated by offset pixels, drawing it first
+// if it isn't the pattern already held
+void ringShow(struct CRGB *targetArray, int numLeds, RingPattern pattern, int offset);
+
+// Forget the held pattern so the next ringShow() redraws it
+void ringReset();
+
+#endif
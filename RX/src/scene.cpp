@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include <MD5Builder.h>
+#include "FS.h"
+#include <DrumRadio.h>
+#include <DrumScene.h>
+
+#include "scene.h"
+#include "palette.h"
+#include "vm.h"
+
+// The whole set is held in RAM, so a recall costs no more than copying a
+// palette and a program into their slots. Each set received is kept in
+// SPIFFS for the next boot, but as with config.ini, reading it back waits
+// until the lights are up; a recall before then shows its fallback mode.
+
+#define SCENE_FILE "/scenes.bin"
+#define SCENE_SET_MAX (sizeof(SceneSetHeader) + SCENE_MAX * sizeof(Scene))
+
+static uint8_t ourType = 0;
+static SceneSetHeader header = {0, 0, 0, 0, 0}; // count 0 until a set is loaded
+static Scene scenes[SCENE_MAX];
+static uint8_t setMd5[16]; // of the set as sent, to recognise a transfer of it
+static uint8_t *incoming = nullptr;
+
+void sceneBegin(uint8_t drumType)
+{
+  ourType = drumType;
+}
+
+// Check a set and, if it is sound, make it the one in use
+static bool install(const uint8_t *data, size_t size)
+{
+  SceneSetHeader candidate;
+  if (size < sizeof(candidate))
+    return false;
+  memcpy(&candidate, data, sizeof(candidate));
+
+  const uint8_t *records = data + sizeof(candidate);
+  if (candidate.magic != SCENE_MAGIC || candidate.format != SCENE_FORMAT || candidate.count > SCENE_MAX ||
+      size != sizeof(candidate) + candidate.count * sizeof(Scene) ||
+      drumCrc16(records, candidate.count * sizeof(Scene)) != candidate.version)
+    return false;
+
+  header = candidate;
+  memcpy(scenes, records, header.count * sizeof(Scene));
+
+  MD5Builder hash;
+  hash.begin();
+  hash.add(data, size);
+  hash.calculate();
+  hash.getBytes(setMd5);
+  return true;
+}
+
+void sceneLoad()
+{
+  if (header.count != 0 || !SPIFFS.begin())
+    return;
+
+  File file = SPIFFS.open(SCENE_FILE, "r");
+  if (!file)
+    return;
+
+  size_t size = file.size();
+  uint8_t *data = size <= SCENE_SET_MAX ? (uint8_t *)malloc(size) : nullptr;
+  if (data != nullptr && file.read(data, size) == size && install(data, size))
+    Serial.printf("Scene set v%04x: %u scenes\n", header.version, header.count);
+  else
+    Serial.println("Cached scene set not valid");
+  free(data);
+  file.close();
+}
+
+int sceneRecall(const SceneBody &recall)
+{
+  if (header.count == 0 || recall.version != header.version || recall.scene >= header.count)
+  {
+    Serial.printf("Scene %u: cached set v%04x is stale (TX has v%04x)\n", recall.scene, header.version,
+                  recall.version);
+    return recall.fallback;
+  }
+
+  const Scene &scene = scenes[recall.scene];
+  if (scene.flags & SCENE_PALETTE)
+    paletteLoad(scene.paletteSlot, scene.palette);
+  if (scene.flags & SCENE_PROGRAM)
+    vmLoad(scene.programSlot, scene.program, min(scene.programLength, (uint8_t)SCENE_PROGRAM_SIZE));
+
+  Serial.printf("Scene %u: %.*s\n", recall.scene, SCENE_NAME_SIZE, scene.name);
+  return sceneMode(scene, ourType);
+}
+
+bool sceneWanted(const BulkStartBody &start)
+{
+  // every run of the TX's carousel sends the set again
+  return header.count == 0 || memcmp(start.md5, setMd5, sizeof(setMd5)) != 0;
+}
+
+static bool sinkBegin(uint32_t size)
+{
+  if (size > SCENE_SET_MAX)
+    return false;
+  incoming = (uint8_t *)malloc(size);
+  return incoming != nullptr;
+}
+
+static void sinkWrite(uint32_t offset, const uint8_t *data, size_t len)
+{
+  memcpy(incoming + offset, data, len);
+}
+
+static void sinkRead(uint32_t offset, uint8_t *data, size_t len)
+{
+  memcpy(data, incoming + offset, len);
+}
+
+static void sinkFinish(uint32_t size)
+{
+  if (!install(incoming, size))
+  {
+    Serial.println("Scene set not valid");
+    return;
+  }
+  Serial.printf("Scene set v%04x received: %u scenes\n", header.version, header.count);
+
+  if (!SPIFFS.begin())
+    return;
+  File file = SPIFFS.open(SCENE_FILE, "w");
+  if (file)
+  {
+    file.write(incoming, size);
+    file.close();
+  }
+}
+
+static void sinkEnd()
+{
+  free(incoming);
+  incoming = nullptr;
+}
+
+const BulkSink sceneSink = {sinkBegin, sinkWrite, sinkRead, sinkFinish, sinkEnd, false};
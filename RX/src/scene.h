@@ -0,0 +1,25 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+#include "bulk.h"
+
+// Scenes cached ahead of a show, see scene.cpp and DrumScene.h
+
+// Scenes give each drum type its own mode; this is ours
+void sceneBegin(uint8_t drumType);
+
+// Read the set kept from the last transfer; slow, so once the lights are up
+void sceneLoad();
+
+// The mode a recall shows on this drum, after loading the scene's palette
+// and program; the recall's fallback if the cached set is stale
+int sceneRecall(const SceneBody &recall);
+
+// For bulk.cpp: receiving a set
+bool sceneWanted(const BulkStartBody &start);
+extern const BulkSink sceneSink;
+
+#endif
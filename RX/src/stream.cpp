@@ -0,0 +1,79 @@
+#include <Arduino.h>
+#include <DrumStream.h>
+
+#include "stream.h"
+#include "geometry.h"
+
+// Each part of a streamed frame is applied as it arrives, over the frame
+// held from before; a lost part leaves its pixels as they were until a later
+// frame changes them, or the next keyframe resets the lot. Deltas are
+// ignored until there's been a keyframe to apply them to. If the stream
+// stops, the last frame is held for a moment and then fades out.
+//
+// A drum follows its own group's stream while there is one, otherwise the
+// stream for all drums: the two are encoded against different frames, so
+// they can't be mixed.
+
+#define STREAM_HOLD_MS 500 // then fade
+#define STREAM_FADE 16     // per frame
+
+static uint8_t pixels[STREAM_PIXELS];
+static uint8_t ownGroup = 0;
+static bool haveKey = false;
+static uint8_t level = 0; // brightness, fading out once the stream stops
+static unsigned long lastPart = 0;
+static unsigned long lastOwnPart = 0;
+static uint32_t lostFrames = 0;
+static uint8_t lastFrame = 0;
+
+void streamBegin(uint8_t group)
+{
+  ownGroup = group;
+}
+
+void streamPacket(const StreamBody &part)
+{
+  unsigned long now = millis();
+  if (part.group == ownGroup && ownGroup != 0)
+    lastOwnPart = now;
+  else if (part.group != 0 || (lastOwnPart != 0 && now - lastOwnPart < STREAM_HOLD_MS))
+    return; // another group's, or we have our own
+
+  if (part.flags & STREAM_KEY)
+    haveKey = true;
+  if (!haveKey || part.length > STREAM_PART_SIZE)
+    return;
+
+  if ((uint8_t)(part.frame - lastFrame) > 1)
+    lostFrames += (uint8_t)(part.frame - lastFrame) - 1;
+  lastFrame = part.frame;
+
+  if (!streamDecode(pixels, part.start, part.data, part.length))
+    return;
+
+  lastPart = now;
+  level = 255;
+}
+
+void streamRender(struct CRGB *targetArray, int numLeds)
+{
+  if (level > 0 && millis() - lastPart > STREAM_HOLD_MS)
+  {
+    level = qsub8(level, STREAM_FADE);
+    if (level == 0)
+      haveKey = false; // start afresh from the next keyframe
+  }
+
+  // each pixel shows the stream pixel at its angle round the drum
+  for (int i = 0; i < numLeds; i++)
+  {
+    uint8_t index = pixels[(geometryAngle(i) * STREAM_PIXELS) >> 8];
+    targetArray[i] = CRGB(streamPalette[index]).nscale8_video(level);
+  }
+
+  EVERY_N_SECONDS(60)
+  {
+    if (lostFrames)
+      Serial.printf("Stream: %u frames lost\n", lostFrames);
+  }
+}
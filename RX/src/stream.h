@@ -0,0 +1,18 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <FastLED.h>
+#include <DrumRadio.h>
+
+// Frames streamed from the TX, see stream.cpp and DrumStream.h
+
+// Which group's stream to show, besides the one for all drums
+void streamBegin(uint8_t group);
+
+// A part of a frame from the TX
+void streamPacket(const StreamBody &part);
+
+// Show the latest frame
+void streamRender(struct CRGB *targetArray, int numLeds);
+
+#endif
@@ -1,69 +1,73 @@
 #include <FastLED.h>
+#include <DrumRadio.h>
 
-#define MAX_LEDS 104 // Maximum number of LEDS to initialise for
+#include "clock.h"
+#include "geometry.h"
+#include "output.h"
+#include "flash.h"
+
+// is the pixel within width of the given angle, either way?
+static bool near(int pixel, uint8_t angle, uint8_t width)
+{
+    uint8_t off = geometryAngle(pixel) - angle;
+    return off <= width || off >= (uint8_t)-width;
+}
 
 void hazards(struct CRGB *targetArray, int numLeds)
 {
-    size_t quartiles = numLeds / 4;
-    const size_t size = 4;
+    const uint8_t width = 7; // either side of the middle, ~1/16th of the shell in all
 
-    EVERY_N_MILLISECONDS(1000)
+    // on for a beat, off for a beat
+    bool lit = ((clockBeats() >> BEAT_FRACTION_BITS) & 1) == 0;
+
+    // on each side of the drum, wherever the strip starts
+    for (int i = 0; i < numLeds; i++)
     {
-        for (size_t i = quartiles - size / 2; i < quartiles + size / 2; i++)
-        {
-            targetArray[i] = CRGB::DarkOrange;
-        }
-        for (size_t i = 3 * quartiles - size / 2; i < 3 * quartiles + size / 2; i++)
+        if (near(i, ANGLE_LEFT, width) || near(i, ANGLE_RIGHT, width))
         {
-            targetArray[i] = CRGB::DarkOrange;
+            targetArray[i] = lit ? CRGB::DarkOrange : CRGB::Black;
         }
-        FastLED.show();
-        FastLED.delay(500);
-        FastLED.clear(true);
     }
 }
 
-void nineninenine(struct CRGB *targetArray, int numLeds)
+// light the quarters of the shell centred on the given angle and the one opposite
+static void quarters(struct CRGB *targetArray, int numLeds, uint8_t angle)
 {
-    size_t quarter = numLeds / 4;
-
-    const int flashes = 3;
-
-    for (size_t f = 0; f < flashes; f++)
+    for (int i = 0; i < numLeds; i++)
     {
-        // quadrant 1
-        for (size_t i = 0; i < quarter; i++)
+        if (near(i, angle, 32) || near(i, angle + 128, 32))
         {
             targetArray[i] = CRGB::Blue;
         }
-        // quadrant 3
-        for (size_t i = 2 * quarter; i < 3 * quarter; i++)
-        {
-            targetArray[i] = CRGB::Blue;
-        }
-        FastLED.show();
-        FastLED.delay(25);
-        FastLED.clear(true);
-        FastLED.delay(25);
     }
-    FastLED.delay(200);
+}
+
+#define NINES_FLASHES 3       // front and back, then the sides
+#define NINES_PAUSE_US 200000  // after each side's flashes
+#define NINES_LATE_US 5000     // a run starting this late still runs
+
+// Each run of flashes starts a whole period after the last, counted from
+// when the mode began (the moment the TX cued), so drums that started
+// together stay together
+void nineninenine(struct CRGB *targetArray, int numLeds)
+{
+    uint32_t width = flashWidth(STROBE_999);
+    uint32_t side = NINES_FLASHES * 2 * width + NINES_PAUSE_US;
+    uint32_t period = 2 * side;
+    uint32_t latency = ledLatencyUs(); // shown this early, to light on time
+    uint32_t elapsed = micros() - flashOrigin();
+    uint32_t start = flashOrigin() + (elapsed + period - NINES_LATE_US) / period * period;
 
-    for (size_t f = 0; f < flashes; f++)
+    for (uint8_t s = 0; s < 2; s++)
     {
-        // quadrant 2
-        for (size_t i = quarter; i < 2 * quarter; i++)
+        for (uint8_t f = 0; f < NINES_FLASHES; f++)
         {
-            targetArray[i] = CRGB::Blue;
-        }
-        // quadrant 4
-        for (size_t i = 3 * quarter; i < numLeds; i++)
-        {
-            targetArray[i] = CRGB::Blue;
+            uint32_t on = start + s * side + f * 2 * width - latency;
+            quarters(targetArray, numLeds, s == 0 ? ANGLE_FRONT : ANGLE_RIGHT);
+            flashUntil(on);
+            ledShow();
+            flashUntil(on + width);
+            ledClear(true);
         }
-        FastLED.show();
-        FastLED.delay(25);
-        FastLED.clear(true);
-        FastLED.delay(25);
     }
-    FastLED.delay(200);
 }
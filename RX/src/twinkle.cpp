@@ -1,43 +1,47 @@
 #include <FastLED.h>
 
-#define MAX_LEDS 104 // Maximum number of LEDS to initialise for
+#include "hires.h"
+#include "ledcount.h"
+#include "twinklepick.h"
 
-void colorTwinkle(struct CRGB *targetArray, int numLeds, const struct CRGB &color0, const struct CRGB &color1 = CRGB::Black, const struct CRGB &color2 = CRGB::Black)
-{
-    static byte activePixels = numLeds / 20; // controls density of lit pixels
-    static byte lastPixel = 0;
-
-    for (byte i = 0; i < activePixels; i++)
-    {
-        fadeToBlackBy(targetArray, numLeds, numLeds / activePixels);
-
-        byte color = random(0,3);
-
-        if (color0.getLuma() > 0 && color == 0)
-        {
-            targetArray[lastPixel] = color0;
-        }
-        else if(color1.getLuma() > 0 && color == 1)
-        {
-            targetArray[lastPixel] = color1;
-        }
-        else if(color2.getLuma() > 0 && color == 2)
-        {
-            targetArray[lastPixel] = color2;
-        }
-        else //fail safe
-        {
-            targetArray[lastPixel] = color0;
-        }
+static int lastPixel = 0;
 
-        lastPixel = random8(numLeds - 1);
+template <typename Count>
+static void twinkleFrame(Count numLeds, const struct CRGB &color0, const struct CRGB &color1, const struct CRGB &color2)
+{
+    // render at 16 bits so the twinkles fade out smoothly
+    struct CRGB16 *frame = hiresFrame();
+
+    // one pass over the strip per frame, however many pixels twinkle
+    hiresFade(frame, numLeds, twinkleFade(numLeds));
+
+    // which pixels, and in which colour, see twinklepick.h
+    twinklePick(
+        numLeds, lastPixel,
+        [&](int pixel, byte color) {
+            if (color0.getLuma() > 0 && color == 0)
+            {
+                frame[pixel] = color0;
+            }
+            else if(color1.getLuma() > 0 && color == 1)
+            {
+                frame[pixel] = color1;
+            }
+            else if(color2.getLuma() > 0 && color == 2)
+            {
+                frame[pixel] = color2;
+            }
+            else //fail safe
+            {
+                frame[pixel] = color0;
+            }
+        },
+        [&](int pixel) { return frame[pixel].isLit(); });
+}
 
-        while (targetArray[lastPixel].red > 0 || targetArray[lastPixel].green > 0 || targetArray[lastPixel].blue > 0)
-        {
-            // pixel already lit, pick again!
-            lastPixel = random8(numLeds - 1);
-        }
-    }
+void colorTwinkle(struct CRGB *targetArray, int numLeds, const struct CRGB &color0, const struct CRGB &color1 = CRGB::Black, const struct CRGB &color2 = CRGB::Black)
+{
+    ledCount(numLeds, [&](auto count) { twinkleFrame(count, color0, color1, color2); });
 }
 
 void rioDisco(struct CRGB *targetArray, int numLeds)
@@ -0,0 +1,56 @@
+#ifndef TWINKLEPICK_H
+#define TWINKLEPICK_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "prng.h"
+
+// How twinkle.cpp fades its pixels and picks the ones to light. Kept free
+// of FastLED, so tools/prng_golden.cpp can check it picks the same pixels
+// as it always has.
+
+#define TWINKLE_LIT_PERCENT 50 // of the strip, lit at any one time
+#define TWINKLE_TRIES 8        // picks of an unlit pixel before taking a lit one
+
+// Pixels lit each frame; controls density of lit pixels
+template <typename Count>
+inline int twinkleActive(Count numLeds)
+{
+  return numLeds >= 40 ? numLeds / 20 : 1;
+}
+
+// With activePixels lit a frame, each staying visible for n frames,
+// about activePixels * n are lit at once. A pixel fading by fade a frame
+// falls from full to below 8 bits after ln(257) / -ln(1 - fade / 256)
+// frames, so fade to keep TWINKLE_LIT_PERCENT of the strip lit
+template <typename Count>
+inline uint8_t twinkleFade(Count numLeds)
+{
+  float frames = (float)numLeds * TWINKLE_LIT_PERCENT / (100 * twinkleActive(numLeds));
+  int fade = 256 * (1 - powf(257, -1 / frames));
+  return fade < 1 ? 1 : fade > 255 ? 255 : fade;
+}
+
+// Light this frame's pixels: light(pixel, colour) with a colour from 0 to
+// 2, then pick the next pixel, trying for one where lit(pixel) is false.
+// lastPixel carries the pick over to the next frame.
+template <typename Count, typename Light, typename Lit>
+inline void twinklePick(Count numLeds, int &lastPixel, Light light, Lit lit)
+{
+  int activePixels = twinkleActive(numLeds);
+  for (int i = 0; i < activePixels; i++)
+  {
+    light(lastPixel, prng8(3));
+
+    lastPixel = prng16(numLeds);
+
+    for (int tries = 1; tries < TWINKLE_TRIES && lit(lastPixel); tries++)
+    {
+      // pixel already lit, pick again! On a busy strip, settle for the last pick
+      lastPixel = prng16(numLeds);
+    }
+  }
+}
+
+#endif
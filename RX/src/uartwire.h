@@ -0,0 +1,48 @@
+#ifndef UARTWIRE_H
+#define UARTWIRE_H
+
+#include <stdint.h>
+
+// How Uart1Driver turns a byte into WS2812 bits on UART1, see output.cpp.
+// Kept free of Arduino, so tools/uart_wire.cpp can check the waveform on
+// the host.
+//
+// The UART sends a start bit, six data bits LSB first, then a stop bit, all
+// inverted, so each character is the line levels
+//   high, ~d0, ~d1, ~d2, ~d3, ~d4, ~d5, low
+// 312.5ns apiece at 3.2Mbaud. Four of those are a 1.25us WS2812 bit: high
+// for one then low for three is a 0, high for three then low for one a 1.
+// The table gives the character for each pair of bits, first bit the high
+// one, as the strip takes them MSB first.
+
+#define UART_WIRE_BAUD 3200000
+#define UART_WIRE_BYTES 4 // characters per colour byte
+
+// A timer interrupt tops up UART1's FIFO as it drains. Should it come so
+// late that the FIFO has run dry, the line idles low mid-frame; an
+// original WS2812 latches after 50us of that. A gap longer than
+// UART_WIRE_GAP_US isn't carried on from: the line is held low until any
+// strip has latched, and the frame sent again from the start.
+#define UART_WIRE_FIFO 128
+#define UART_WIRE_REFILL_US 100 // the FIFO drains in 320us
+#define UART_WIRE_GAP_US 30
+
+// How long the UART takes to send this many characters
+inline uint32_t uartWireUs(uint32_t characters)
+{
+  return characters * 8 * 1000000UL / UART_WIRE_BAUD;
+}
+
+static const uint8_t uartWireBits[4] = {0b110111, 0b000111, 0b110100, 0b000100};
+
+// The UART_WIRE_BYTES characters that send v
+inline uint8_t *uartWireEncode(uint8_t v, uint8_t *out)
+{
+  *out++ = uartWireBits[(v >> 6) & 3];
+  *out++ = uartWireBits[(v >> 4) & 3];
+  *out++ = uartWireBits[(v >> 2) & 3];
+  *out++ = uartWireBits[v & 3];
+  return out;
+}
+
+#endif
@@ -0,0 +1,228 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include <DrumRadio.h>
+#include <DrumVM.h>
+
+#include "vm.h"
+#include "vmrun.h"
+#include "clock.h"
+#include "geometry.h"
+#include "prng.h"
+#include "profile.h"
+
+// Programs are checked once, when the last part arrives: every opcode,
+// register, input, palette and jump target must be in range, so the
+// interpreter itself needs no checks beyond the instruction budget. The
+// budget bounds a frame however a program loops; pixels it doesn't reach,
+// a block of VM_LANES at a time (see vmrun.h), keep their previous colour. It grows with the strip, so that a long one
+// isn't cut off partway by a program that suits a short one.
+
+#define VM_PIXEL_BUDGET 64 // instructions per pixel
+#define VM_LED_BUDGET 77   // instructions per frame, per LED: 8000 for 104
+#define VM_MAX_PARTS ((VM_MAX_PROGRAM + PROGRAM_PART_SIZE - 1) / PROGRAM_PART_SIZE)
+
+struct VmSlot
+{
+  uint16_t crc;
+  uint8_t length;
+  uint8_t parts;
+  uint16_t partsReceived; // bitmap
+  bool valid;
+  uint8_t code[VM_MAX_PROGRAM];
+};
+
+static VmSlot slots[VM_SLOTS];
+static uint32_t frame = 0;
+static uint32_t overruns = 0;
+
+static const TProgmemRGBPalette16 *const palettes[VM_PALETTE_COUNT] = {
+    &RainbowColors_p, &PartyColors_p, &HeatColors_p, &OceanColors_p, &ForestColors_p, &LavaColors_p};
+
+struct FastLedMaths
+{
+  static int32_t scale8(int32_t a, int32_t b) { return ::scale8(a, b); }
+  static int32_t sin8(int32_t a) { return ::sin8(a); }
+  static int32_t noise(int32_t a, int32_t b) { return inoise8(a, b); }
+  static int32_t rand8() { return prng8(); }
+};
+
+static bool isArithmetic(uint8_t op)
+{
+  return op >= VM_ADD && op <= VM_NOISE;
+}
+
+static bool validate(const uint8_t *code, uint8_t length)
+{
+  if (length % 3 != 0)
+    return false;
+
+  uint8_t count = length / 3;
+  for (uint8_t pc = 0; pc < count; pc++)
+  {
+    uint8_t op = code[pc * 3];
+    uint8_t a = code[pc * 3 + 1];
+    uint8_t b = code[pc * 3 + 2];
+    bool immediate = op & VM_IMM;
+    op &= ~VM_IMM;
+
+    if (op >= VM_OP_COUNT || (immediate && !isArithmetic(op)))
+      return false;
+
+    switch (op)
+    {
+    case VM_END:
+      break;
+    case VM_JMP:
+      if (a > count)
+        return false;
+      break;
+    case VM_JZ:
+    case VM_JNZ:
+      if (a >= VM_REGISTERS || b > count)
+        return false;
+      break;
+    case VM_IN:
+      if (a >= VM_REGISTERS || b >= VM_INPUT_COUNT)
+        return false;
+      break;
+    case VM_RGB:
+    case VM_HSV:
+      if (a > VM_REGISTERS - 3)
+        return false;
+      break;
+    case VM_PAL:
+      if (a >= VM_REGISTERS || b >= VM_PALETTE_COUNT)
+        return false;
+      break;
+    default:
+      if (a >= VM_REGISTERS || ((isArithmetic(op) || op == VM_MOV) && !immediate && b >= VM_REGISTERS))
+        return false;
+      break;
+    }
+  }
+  return true;
+}
+
+void vmPacket(const ProgramBody &program)
+{
+  if (program.slot >= VM_SLOTS || program.parts == 0 || program.parts > VM_MAX_PARTS || program.part >= program.parts ||
+      program.length > VM_MAX_PROGRAM)
+    return;
+
+  VmSlot &slot = slots[program.slot];
+  if (slot.valid && slot.crc == program.crc)
+    return; // already have it
+
+  if (slot.crc != program.crc || slot.parts != program.parts)
+  {
+    // a new program for this slot
+    slot.valid = false;
+    slot.crc = program.crc;
+    slot.length = program.length;
+    slot.parts = program.parts;
+    slot.partsReceived = 0;
+  }
+
+  uint16_t offset = program.part * PROGRAM_PART_SIZE;
+  memcpy(slot.code + offset, program.data, min(PROGRAM_PART_SIZE, VM_MAX_PROGRAM - offset));
+  slot.partsReceived |= 1u << program.part;
+
+  if (slot.partsReceived != (1u << slot.parts) - 1)
+    return;
+
+  slot.valid = drumCrc16(slot.code, slot.length) == slot.crc && validate(slot.code, slot.length);
+  Serial.printf("VM program in slot %u: %u bytes, %s\n", program.slot, slot.length, slot.valid ? "ok" : "rejected");
+}
+
+bool vmLoad(uint8_t slotNumber, const uint8_t *code, uint8_t length)
+{
+  if (slotNumber >= VM_SLOTS || length > VM_MAX_PROGRAM)
+    return false;
+
+  VmSlot &slot = slots[slotNumber];
+  uint16_t crc = drumCrc16(code, length);
+  if (slot.valid && slot.crc == crc)
+    return true; // already have it
+
+  if (!validate(code, length))
+    return false;
+  memcpy(slot.code, code, length);
+  slot.crc = crc;
+  slot.length = length;
+  slot.parts = 0; // so parts of a program arriving over the air start afresh
+  slot.valid = true;
+  return true;
+}
+
+void vmReset()
+{
+  frame = 0;
+}
+
+bool vmRender(struct CRGB *targetArray, int numLeds, uint8_t slotNumber)
+{
+  if (slotNumber >= VM_SLOTS || !slots[slotNumber].valid)
+    return false;
+
+  const VmSlot &slot = slots[slotNumber];
+  const uint8_t count = slot.length / 3;
+
+  int32_t inputs[VM_INPUT_COUNT];
+  inputs[VM_IN_COUNT] = numLeds;
+  inputs[VM_IN_MILLIS] = millis();
+  inputs[VM_IN_BEAT] = clockBeatPhase();
+  inputs[VM_IN_BAR] = clockBarPhase();
+  inputs[VM_IN_FRAME] = frame++;
+
+  int32_t budget = numLeds * VM_LED_BUDGET;
+  static CRGBPalette16 palette;
+  static int paletteId = -1;
+
+  static VmPixel pixels[VM_LANES];
+  static VmResult results[VM_LANES];
+  for (int first = 0; first < numLeds && budget > 0; first += VM_LANES)
+  {
+    uint8_t n = numLeds - first < VM_LANES ? numLeds - first : VM_LANES;
+    for (uint8_t l = 0; l < n; l++)
+      pixels[l] = {first + l, geometryAngle(first + l), geometryBand(first + l)};
+    vmRun<FastLedMaths>(slot.code, count, inputs, pixels, n, VM_PIXEL_BUDGET, results);
+
+    for (uint8_t l = 0; l < n; l++)
+    {
+      const VmResult &result = results[l];
+      const int32_t *v = result.v;
+      CRGB &pixel = targetArray[first + l];
+      switch (result.op)
+      {
+      case VM_RGB:
+        pixel = CRGB(v[0], v[1], v[2]);
+        break;
+      case VM_HSV:
+        pixel = CHSV(v[0], v[1], v[2]);
+        break;
+      case VM_PAL:
+        if (result.palette != paletteId)
+        {
+          palette = *palettes[result.palette];
+          paletteId = result.palette;
+        }
+        pixel = ColorFromPalette(palette, v[0]);
+        break;
+      case VM_FADE:
+        pixel.nscale8(v[0]);
+        break;
+      }
+      budget -= result.steps;
+    }
+  }
+
+  if (budget <= 0)
+  {
+    overruns++;
+    profileCount(PROF_VM_BUDGET);
+    if (overruns == 1 || overruns % 100 == 0)
+      Serial.printf("VM program %u over budget (%u times)\n", slotNumber, overruns);
+  }
+
+  return true;
+}
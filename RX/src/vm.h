@@ -0,0 +1,22 @@
+#ifndef VM_H
+#define VM_H
+
+#include <FastLED.h>
+#include <DrumRadio.h>
+
+// Effect bytecode VM, see vm.cpp and DrumVM.h
+
+// A part of a program from the TX
+void vmPacket(const ProgramBody &program);
+
+// Put a whole program in a slot, e.g. from a scene; false if it is invalid
+bool vmLoad(uint8_t slot, const uint8_t *code, uint8_t length);
+
+// Render a frame with the program in the given slot; false if there is
+// no valid program there
+bool vmRender(struct CRGB *targetArray, int numLeds, uint8_t slot);
+
+// Restart frame counting, e.g. on a change of mode
+void vmReset();
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef VMRUN_H
+#define VMRUN_H
+
+#include <stdint.h>
+#include <DrumVM.h>
+
+// The interpreter's inner loop, kept free of Arduino and FastLED so that
+// tools/vm_bench.cpp can time it against native effects; see vm.cpp.
+//
+// Decoding an instruction costs more than most instructions do, so a block
+// of up to VM_LANES pixels runs together: each instruction is decoded once,
+// then done for every pixel in the group. A conditional jump that goes
+// different ways for different pixels splits the group in two, each going
+// on from its own instruction; groups never merge again, so every pixel in
+// one has run the same instructions, and shares its step count and stack
+// depth. A register whose value is the same for the whole group (set from
+// a constant, a frame input, or others like it) is held once for the group
+// rather than per pixel, so work such as scaling the beat is done once per
+// group, not once per pixel. Arithmetic wraps at 32 bits rather than
+// overflowing, whatever a program from the air does.
+
+#define VM_LANES 32
+
+// What a pixel's program has to go on, besides the frame's inputs
+struct VmPixel
+{
+  int32_t pixel;
+  int32_t angle;
+  int32_t band;
+};
+
+// How a pixel's program finished: op is VM_RGB, VM_HSV, VM_PAL or VM_FADE,
+// with its operands in v and palette, or VM_END to leave the pixel alone
+struct VmResult
+{
+  uint8_t op;
+  uint8_t palette;
+  uint8_t steps; // instructions run
+  int32_t v[3];
+};
+
+// Run a validated program for n (up to VM_LANES) pixels, for at most budget
+// instructions each. inputs holds the frame's; those of each pixel come
+// from pixels. Maths has static scale8(), sin8(), noise() and rand8(), as
+// FastLED's
+template <typename Maths>
+inline void vmRun(const uint8_t *code, uint8_t count, const int32_t *inputs, const VmPixel *pixels, uint8_t n,
+                  uint8_t budget, VmResult *results)
+{
+  struct Group
+  {
+    uint8_t first, size; // in order[]
+    bool ordered;        // order[] is still 0, 1, 2... there, as before any split
+    uint8_t pc, sp, steps;
+    uint8_t varying;             // registers held per pixel, a bit each
+    int32_t same[VM_REGISTERS];  // the rest
+  };
+
+  // static, as they would take much of the ESP8266's 4K stack
+  static int32_t r[VM_REGISTERS][VM_LANES];
+  static int32_t stack[VM_STACK][VM_LANES];
+  static uint8_t order[VM_LANES];
+  static Group groups[VM_LANES];
+
+  for (uint8_t l = 0; l < n; l++)
+  {
+    order[l] = l;
+    results[l].op = VM_END;
+  }
+  groups[0] = {0, n, true, 0, 0, 0, 0, {0}};
+  uint8_t groupCount = n ? 1 : 0;
+
+  while (groupCount)
+  {
+    Group g = groups[--groupCount];
+    const uint8_t *lanes = order + g.first;
+    bool done = false;
+
+    while (!done && g.pc < count && g.steps < budget)
+    {
+      g.steps++;
+      const uint8_t *ins = code + g.pc * 3;
+      uint8_t op = ins[0] & ~VM_IMM;
+      uint8_t a = ins[1];
+      uint8_t bi = ins[2];
+      uint8_t rbi = bi & (VM_REGISTERS - 1);
+      // LDI, LDH and IN take b as it is, as do the VM_IMM forms
+      bool literal = (ins[0] & VM_IMM) || op == VM_LDI || op == VM_LDH || op == VM_IN;
+      int32_t *ra = r[a];
+      const int32_t *rb = r[rbi];
+      g.pc++;
+
+// r[a] = expr for every pixel, with x the old r[a] and b the operand (ua
+// and ub the same, unsigned); just once if neither varies from pixel to
+// pixel
+#define VM_ALU(readsA, readsB, expr)                                         \
+  {                                                                          \
+    bool aVaries = (readsA) && (g.varying & (1 << a));                       \
+    bool bVaries = (readsB) && !literal && (g.varying & (1 << rbi));         \
+    if (!aVaries && !bVaries)                                                \
+    {                                                                        \
+      int32_t x = g.same[a], b = literal ? bi : g.same[rbi];                 \
+      uint32_t ua = x, ub = b;                                               \
+      (void)ua, (void)ub;                                                    \
+      g.same[a] = (expr);                                                    \
+      g.varying &= ~(1 << a);                                                \
+    }                                                                        \
+    else                                                                     \
+    {                                                                        \
+      if ((readsA) && !aVaries)                                              \
+        for (uint8_t k = 0; k < g.size; k++)                                 \
+          ra[lanes[k]] = g.same[a];                                          \
+      int32_t same = literal ? bi : g.same[rbi];                             \
+      if (bVaries)                                                           \
+        VM_LOOP(rb[l], expr)                                                 \
+      else                                                                   \
+        VM_LOOP(same, expr)                                                  \
+      g.varying |= 1 << a;                                                   \
+    }                                                                        \
+  }
+#define VM_LOOP(operand, expr)                                               \
+  {                                                                          \
+    if (g.ordered)                                                           \
+      VM_LANE_LOOP(l = g.first + k, operand, expr)                           \
+    else                                                                     \
+      VM_LANE_LOOP(l = lanes[k], operand, expr)                              \
+  }
+// a group in order, as most are, can skip looking up each pixel
+#define VM_LANE_LOOP(lane, operand, expr)                                    \
+  {                                                                          \
+    for (uint8_t k = 0; k < g.size; k++)                                     \
+    {                                                                        \
+      uint8_t lane;                                                          \
+      int32_t x = ra[l], b = operand;                                        \
+      uint32_t ua = x, ub = b;                                               \
+      (void)ua, (void)ub;                                                    \
+      ra[l] = (expr);                                                        \
+    }                                                                        \
+  }
+// the value of register i for pixel l
+#define VM_VALUE(i, l) ((g.varying & (1 << (i))) ? r[i][l] : g.same[i])
+
+      switch (op)
+      {
+      case VM_END:
+        done = true;
+        break;
+
+      case VM_LDI: VM_ALU(false, false, b); break;
+      case VM_LDH: VM_ALU(true, false, (int32_t)((ua << 8) | ub)); break;
+      case VM_IN:
+        if (bi == VM_IN_PIXEL || bi == VM_IN_ANGLE || bi == VM_IN_BAND)
+        {
+          const int32_t VmPixel::*field = bi == VM_IN_PIXEL ? &VmPixel::pixel
+                                          : bi == VM_IN_ANGLE ? &VmPixel::angle
+                                                              : &VmPixel::band;
+          for (uint8_t k = 0; k < g.size; k++)
+            ra[lanes[k]] = pixels[lanes[k]].*field;
+          g.varying |= 1 << a;
+        }
+        else
+        {
+          g.same[a] = inputs[bi];
+          g.varying &= ~(1 << a);
+        }
+        break;
+      case VM_MOV: VM_ALU(false, true, b); break;
+      case VM_ADD: VM_ALU(true, true, (int32_t)(ua + ub)); break;
+      case VM_SUB: VM_ALU(true, true, (int32_t)(ua - ub)); break;
+      case VM_MUL: VM_ALU(true, true, (int32_t)(ua * ub)); break;
+      case VM_DIV: VM_ALU(true, true, b == 0 ? 0 : b == -1 ? (int32_t)(0 - ua) : x / b); break;
+      case VM_MOD: VM_ALU(true, true, b == 0 || b == -1 ? 0 : x % b); break;
+      case VM_AND: VM_ALU(true, true, x & b); break;
+      case VM_OR: VM_ALU(true, true, x | b); break;
+      case VM_XOR: VM_ALU(true, true, x ^ b); break;
+      case VM_SHL: VM_ALU(true, true, (int32_t)(ua << (b & 31))); break;
+      case VM_SHR: VM_ALU(true, true, x >> (b & 31)); break;
+      case VM_MIN: VM_ALU(true, true, x < b ? x : b); break;
+      case VM_MAX: VM_ALU(true, true, x > b ? x : b); break;
+      case VM_LT: VM_ALU(true, true, x < b); break;
+      case VM_SCALE8: VM_ALU(true, true, Maths::scale8(x, b)); break;
+      case VM_SIN8: VM_ALU(true, false, Maths::sin8(x)); break;
+      case VM_NOISE: VM_ALU(true, true, Maths::noise(x, b)); break;
+      case VM_RAND:
+        // a different number for each pixel
+        for (uint8_t k = 0; k < g.size; k++)
+          ra[lanes[k]] = Maths::rand8();
+        g.varying |= 1 << a;
+        break;
+
+      case VM_JMP:
+        g.pc = a;
+        break;
+      case VM_JZ:
+      case VM_JNZ:
+      {
+        bool onZero = op == VM_JZ;
+        if (!(g.varying & (1 << a)))
+        {
+          if ((g.same[a] == 0) == onZero)
+            g.pc = bi;
+          break;
+        }
+
+        // the pixels that jump go to the end of the group
+        uint8_t *group = order + g.first;
+        uint8_t stay = g.size;
+        for (uint8_t k = 0; k < stay;)
+        {
+          if ((ra[group[k]] == 0) == onZero)
+          {
+            uint8_t lane = group[k];
+            group[k] = group[--stay];
+            group[stay] = lane;
+          }
+          else
+          {
+            k++;
+          }
+        }
+        if (stay < g.size)
+          g.ordered = false;
+        if (stay == 0)
+        {
+          g.pc = bi;
+        }
+        else if (stay < g.size)
+        {
+          Group &jumped = groups[groupCount++];
+          jumped = g;
+          jumped.first = g.first + stay;
+          jumped.size = g.size - stay;
+          jumped.pc = bi;
+          g.size = stay;
+        }
+        break;
+      }
+      case VM_PUSH:
+        if (g.sp < VM_STACK)
+        {
+          int32_t *slot = stack[g.sp++];
+          for (uint8_t k = 0; k < g.size; k++)
+            slot[lanes[k]] = VM_VALUE(a, lanes[k]);
+        }
+        break;
+      case VM_POP:
+        if (g.sp)
+        {
+          const int32_t *slot = stack[--g.sp];
+          for (uint8_t k = 0; k < g.size; k++)
+            ra[lanes[k]] = slot[lanes[k]];
+          g.varying |= 1 << a;
+        }
+        else
+        {
+          g.same[a] = 0;
+          g.varying &= ~(1 << a);
+        }
+        break;
+
+      case VM_RGB:
+      case VM_HSV:
+      case VM_PAL:
+      case VM_FADE:
+        for (uint8_t k = 0; k < g.size; k++)
+        {
+          uint8_t l = lanes[k];
+          VmResult &result = results[l];
+          result.op = op;
+          result.palette = bi;
+          result.v[0] = VM_VALUE(a, l);
+          if (op == VM_RGB || op == VM_HSV)
+          {
+            result.v[1] = VM_VALUE(a + 1, l);
+            result.v[2] = VM_VALUE(a + 2, l);
+          }
+        }
+        done = true;
+        break;
+      }
+#undef VM_ALU
+#undef VM_LOOP
+#undef VM_LANE_LOOP
+#undef VM_VALUE
+    }
+
+    for (uint8_t k = 0; k < g.size; k++)
+      results[lanes[k]].steps = g.steps;
+  }
+}
+
+#endif
@@ -0,0 +1,183 @@
+#include <Arduino.h>
+#include <RF24.h>
+#include <DrumRadio.h>
+
+#include "watchdog.h"
+#include "channel.h"
+#include "profile.h"
+
+// An nRF24 can stop hearing anything without a word: a brownout as the
+// LEDs flash resets it to channel 2 and powered down, and noise on SPI can
+// leave it wedged with its RX FIFO full. Every WATCHDOG_CHECK_MS the
+// watchdog reads back SETUP_AW (as isChipConnected() does) and the channel
+// the radio should be on, and checks that the RX FIFO isn't staying full,
+// though it is read every frame. On a fault the radio is set up again in
+// place, which takes a few mS; the mode and everything the effects hold are
+// left alone, so the animation carries on. A radio that still fails is
+// tried again at each check, and after WATCHDOG_TRIES the drum reboots.
+// With its config cached that is the quickest way back to a first frame
+// (see bootDiagnostics()), and the mode showing is kept in RTC memory,
+// which survives the restart, for the drum to carry on with. If the radio
+// isn't working after WATCHDOG_REBOOTS reboots in a row, rebooting isn't
+// helping, so it is only restarted every WATCHDOG_SLOW_MS from then on.
+//
+// A radio that reads back fine can still have stopped receiving, so after
+// WATCHDOG_SILENT_MS with no packet from a TX that was heard before, it is
+// restarted once, then after twice as long, and so on up to
+// WATCHDOG_SILENT_MAX_MS, as the TX may simply be off. Silence alone never
+// reboots the drum. Faults, restarts, reboots and the time from finding a
+// fault to the radio working again all go to the profiler.
+
+extern RF24 radio;
+
+#define WATCHDOG_CHECK_MS 500
+#define WATCHDOG_TRIES 3
+#define WATCHDOG_REBOOTS 2
+#define WATCHDOG_SLOW_MS 5000
+#define WATCHDOG_SILENT_MS 10000
+#define WATCHDOG_SILENT_MAX_MS 80000
+#define WATCHDOG_FULL_CHECKS 2 // in a row with the RX FIFO full
+#define WATCHDOG_RTC_BLOCK 32  // the blocks before hold eboot's command, see bulk.cpp
+#define WATCHDOG_MAGIC 0x47444452 // "RDDG"
+
+// Kept in RTC memory across a reboot
+struct Resume
+{
+  uint32_t magic;
+  uint32_t reboots; // by the watchdog, since power on
+  int16_t mode;
+  uint8_t inRow;    // reboots since the radio last worked
+  uint8_t reserved;
+  uint16_t crc;
+  uint16_t pad;
+};
+
+static bool (*restart)() = nullptr;
+static Resume resume;
+static uint8_t tries = 0; // restarts since the radio last worked
+static uint8_t full = 0;
+static uint32_t faultAt = 0; // micros()
+static unsigned long lastCheck = 0;
+static unsigned long lastHeard = 0;
+static unsigned long silentMs = WATCHDOG_SILENT_MS;
+static bool heard = false;
+
+static uint16_t resumeCrc()
+{
+  return drumCrc16((const uint8_t *)&resume, offsetof(Resume, crc));
+}
+
+void watchdogBegin(bool (*start)(), bool up)
+{
+  restart = start;
+
+  if (ESP.rtcUserMemoryRead(WATCHDOG_RTC_BLOCK, (uint32_t *)&resume, sizeof(resume)) &&
+      resume.magic == WATCHDOG_MAGIC && resume.crc == resumeCrc())
+  {
+    Serial.printf("Rebooted by the radio watchdog (%u since power on), carrying on with mode %d\n",
+                  resume.reboots, resume.mode);
+    profileAdd(PROF_REBOOTS, resume.reboots);
+
+    // any other kind of reset starts afresh
+    uint32_t magic = 0;
+    ESP.rtcUserMemoryWrite(WATCHDOG_RTC_BLOCK, &magic, sizeof(magic));
+  }
+  else
+  {
+    memset(&resume, 0, sizeof(resume));
+    resume.mode = -1;
+  }
+
+  if (!up)
+  {
+    profileCount(PROF_RADIO_FAULTS);
+    faultAt = micros();
+    tries = 1;
+  }
+  lastCheck = millis();
+}
+
+int watchdogResumed()
+{
+  return resume.mode;
+}
+
+void watchdogHeard()
+{
+  lastHeard = millis();
+  silentMs = WATCHDOG_SILENT_MS;
+  heard = true;
+}
+
+// Does the radio read back as it was set up?
+static bool healthy()
+{
+  if (!radio.isChipConnected() || radio.getChannel() != channelTuned())
+    return false;
+  full = radio.rxFifoFull() ? full + 1 : 0;
+  return full < WATCHDOG_FULL_CHECKS;
+}
+
+static void reboot(int mode)
+{
+  Serial.printf("Radio still not working after %u restarts, rebooting\n", tries);
+  resume.magic = WATCHDOG_MAGIC;
+  resume.reboots++;
+  resume.mode = mode;
+  resume.inRow++;
+  resume.crc = resumeCrc();
+  ESP.rtcUserMemoryWrite(WATCHDOG_RTC_BLOCK, (uint32_t *)&resume, sizeof(resume));
+  ESP.restart();
+}
+
+bool watchdogPoll(int mode)
+{
+  unsigned long now = millis();
+  if (now - lastCheck < (tries > WATCHDOG_TRIES ? WATCHDOG_SLOW_MS : WATCHDOG_CHECK_MS))
+    return false;
+  lastCheck = now;
+
+  if (tries == 0)
+  {
+    bool working = healthy();
+    bool silent = heard && now - lastHeard >= silentMs;
+    if (working && !silent)
+    {
+      resume.inRow = 0;
+      return false;
+    }
+
+    faultAt = micros();
+    if (working)
+    {
+      profileCount(PROF_RADIO_SILENT);
+      Serial.printf("Radio: nothing heard for %lus, restarting it\n", (now - lastHeard) / 1000);
+      lastHeard = now;
+      silentMs = silentMs * 2 < WATCHDOG_SILENT_MAX_MS ? silentMs * 2 : WATCHDOG_SILENT_MAX_MS;
+    }
+    else
+    {
+      profileCount(PROF_RADIO_FAULTS);
+      Serial.println("Radio: not as it was set up, restarting it");
+    }
+  }
+  else if (tries >= WATCHDOG_TRIES && resume.inRow < WATCHDOG_REBOOTS)
+  {
+    reboot(mode);
+  }
+
+  if (tries < 255)
+    tries++;
+  full = 0;
+  if (!restart() || !healthy())
+    return false;
+
+  uint32_t us = micros() - faultAt;
+  profileCount(PROF_RADIO_RESTARTS);
+  profileAdd(PROF_RADIO_RECOVERY, us);
+  Serial.printf("Radio working again after %u restart%s, %lu us\n", tries, tries == 1 ? "" : "s",
+                (unsigned long)us);
+  tries = 0;
+  resume.inRow = 0;
+  return true;
+}
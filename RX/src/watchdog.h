@@ -0,0 +1,24 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdint.h>
+
+// Keeping the radio working, see watchdog.cpp
+
+// start() sets the radio up and says whether it answered; up is whether it
+// did at boot
+void watchdogBegin(bool (*start)(), bool up);
+
+// The mode showing when the watchdog last rebooted the drum, to carry on
+// with, or -1
+int watchdogResumed();
+
+// A packet from the TX was just read
+void watchdogHeard();
+
+// Check the radio when due, restarting it if it has gone wrong; call every
+// frame after reading the radio, with the mode showing. True if the radio
+// has just been brought back
+bool watchdogPoll(int mode);
+
+#endif
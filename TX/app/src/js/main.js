@@ -14,6 +14,10 @@ var networkModal = Modal.getOrCreateInstance(networkModalEl); // Returns a Boots
 
 let websocket;
 
+const TAP_RESET = 2000; // mS gap after which a tap starts a new tempo
+const TAP_COUNT = 5;    // number of taps averaged
+let taps = [];
+
 function initWebSocket() {
     console.log('Trying to open a WebSocket connection...');
     websocket = new WebSocket(gateway);
@@ -39,6 +43,25 @@ function onMessage(event) {
     let msg = JSON.parse(event.data);
     console.log(msg);
 
+    if (msg.tempo) {
+        $('#btnTap').text(`${msg.tempo} BPM`);
+    }
+
+    if (msg.idle !== undefined) {
+        showMetrics(msg);
+        return;
+    }
+
+    if (msg.channel !== undefined) {
+        showChannels(msg);
+        return;
+    }
+
+    if (msg.update !== undefined) {
+        $('#btnUpdate').text(msg.update < 100 ? `Updating drums: ${msg.update}%` : 'Update drum firmware');
+        return;
+    }
+
     document.querySelectorAll('.btn.active').forEach((b) => {
         b.classList.remove('active');
     });
@@ -64,6 +87,32 @@ function onMessage(event) {
     }
 }
 
+// one bar per radio channel, as tall as the share of the survey's samples
+// that found something there
+function showChannels(msg) {
+    $('#btnSurvey').text('Survey radio channels').prop('disabled', false);
+    $('#channelInfo').text(`Drums on channel ${msg.channel} (${2400 + msg.channel} MHz)`);
+    if (!msg.survey) {
+        return;
+    }
+
+    let map = $('#channelMap').empty();
+    msg.survey.forEach((percent, channel) => {
+        $('<div>')
+            .css('height', `${percent}%`)
+            .attr('title', `${channel}: ${percent}%`)
+            .toggleClass('current', channel == msg.channel)
+            .appendTo(map);
+    });
+}
+
+// how busy the TX is, and how late its timers run
+function showMetrics(msg) {
+    let timers = msg.timers.filter((t) => t.runs > 0)
+        .map((t) => `${t.name} ${t.late.toFixed(1)}/${t.worst} ms`);
+    $('#metrics').text(`TX idle ${msg.idle}% · timers late, mean/worst: ${timers.join(', ')}`);
+}
+
 $(function(){
 
     initWebSocket();
@@ -87,6 +136,54 @@ $(function(){
         websocket.send(JSON.stringify(msg));
     });
 
+    $('#btnTap').on("pointerdown", function(e) {
+        e.preventDefault()
+
+        let now = performance.now();
+        if (taps.length && now - taps[taps.length - 1] > TAP_RESET) {
+            taps = [];
+        }
+        taps.push(now);
+        if (taps.length > TAP_COUNT) {
+            taps.shift();
+        }
+        if (taps.length < 2) {
+            return;
+        }
+
+        // average interval across the recent taps
+        let interval = (taps[taps.length - 1] - taps[0]) / (taps.length - 1);
+        let msg = {
+            tempo: Math.round(600000 / interval) / 10
+        };
+        console.log('Sending to websocket... ');
+        console.log(msg);
+        websocket.send(JSON.stringify(msg));
+    });
+
+    $('#btnUpdateConfirm').on("click", function(e) {
+        e.preventDefault()
+
+        let msg = {
+            update: "firmware"
+        };
+        console.log('Sending to websocket... ');
+        console.log(msg);
+        websocket.send(JSON.stringify(msg));
+    });
+
+    $('#btnSurvey').on("click", function(e) {
+        e.preventDefault()
+
+        let msg = {
+            survey: true
+        };
+        console.log('Sending to websocket... ');
+        console.log(msg);
+        websocket.send(JSON.stringify(msg));
+        $(this).text('Surveying...').prop('disabled', true);
+    });
+
     $('#btnNineNineNine').on("click", function(e) {
         e.preventDefault()
 
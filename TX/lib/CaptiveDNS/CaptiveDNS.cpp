@@ -0,0 +1,94 @@
+// CaptiveDNS.cpp
+
+#include <Arduino.h>
+#include <CaptiveDNS.h>
+
+#define DNS_HEADER_SIZE 12
+#define DNS_MAX_PACKET 512
+#define DNS_TYPE_A 1
+#define DNS_TYPE_ANY 255
+#define DNS_CLASS_IN 1
+
+CaptiveDNS::CaptiveDNS() {
+  answeredCount = 0;
+  droppedCount = 0;
+}
+
+bool CaptiveDNS::start(uint16_t port, const IPAddress &ip, uint32_t ttl) {
+  // The answer is identical for every query, apart from the name it points
+  // back at, which is always the first question at offset 12 (0xC00C)
+  const uint8_t answer[16] = {
+      0xC0, 0x0C,                                          // name: pointer to question
+      0x00, DNS_TYPE_A,                                    // type
+      0x00, DNS_CLASS_IN,                                  // class
+      (uint8_t)(ttl >> 24), (uint8_t)(ttl >> 16), (uint8_t)(ttl >> 8), (uint8_t)ttl,
+      0x00, 0x04,                                          // rdlength
+      ip[0], ip[1], ip[2], ip[3]};
+  memcpy(answerTemplate, answer, sizeof(answerTemplate));
+
+  if (!udp.listen(port))
+    return false;
+
+  udp.onPacket([this](AsyncUDPPacket packet) { handlePacket(packet); });
+  return true;
+}
+
+void CaptiveDNS::stop() {
+  udp.close();
+}
+
+uint32_t CaptiveDNS::answered() {
+  return answeredCount;
+}
+
+uint32_t CaptiveDNS::dropped() {
+  return droppedCount;
+}
+
+void CaptiveDNS::handlePacket(AsyncUDPPacket &packet) {
+  const uint8_t *query = packet.data();
+  size_t len = packet.length();
+
+  // a standard query (QR=0, opcode 0) with exactly one question
+  if (len < DNS_HEADER_SIZE || (query[2] & 0xF8) != 0 || query[4] != 0 || query[5] != 1) {
+    droppedCount++;
+    return;
+  }
+
+  // walk the labels of the question name
+  size_t pos = DNS_HEADER_SIZE;
+  while (pos < len && query[pos] != 0) {
+    if (query[pos] & 0xC0) { // compression is not valid in a question
+      droppedCount++;
+      return;
+    }
+    pos += query[pos] + 1;
+  }
+  pos += 1 + 4; // terminating zero, qtype, qclass
+  if (pos > len || pos + sizeof(answerTemplate) > DNS_MAX_PACKET) {
+    droppedCount++;
+    return;
+  }
+
+  uint16_t qtype = (query[pos - 4] << 8) | query[pos - 3];
+  bool answerable = (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY);
+
+  uint8_t response[DNS_MAX_PACKET];
+  memcpy(response, query, pos); // header and question; EDNS records are dropped
+
+  response[2] = 0x84 | (query[2] & 0x01); // QR, AA, keep RD
+  response[3] = 0x80;                     // RA, NoError
+  response[6] = 0;
+  response[7] = answerable ? 1 : 0; // ancount
+  response[8] = response[9] = 0;    // nscount
+  response[10] = response[11] = 0;  // arcount
+
+  size_t responseLen = pos;
+  if (answerable) {
+    memcpy(response + pos, answerTemplate, sizeof(answerTemplate));
+    responseLen += sizeof(answerTemplate);
+  }
+
+  packet.write(response, responseLen);
+  answeredCount++;
+}
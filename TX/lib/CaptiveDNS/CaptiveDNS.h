@@ -0,0 +1,53 @@
+// CaptiveDNS.h
+#ifndef CAPTIVE_DNS_H
+#define CAPTIVE_DNS_H
+
+/*
+ * Event-driven wildcard DNS responder for the captive portal.
+ *
+ * Every A (or ANY) query is answered with the soft-AP address, straight
+ * from the AsyncUDP packet callback, so bursts of connectivity checks from
+ * phones joining the network are answered as fast as they arrive rather
+ * than one per pass of loop().
+ */
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+class CaptiveDNS {
+  public:
+
+    CaptiveDNS();
+
+    /**
+      Start answering queries on the given port
+      @param port UDP port to listen on, normally 53
+      @param ip the address every name resolves to
+      @param ttl seconds clients may cache the answer for
+    */
+    bool start(uint16_t port, const IPAddress &ip, uint32_t ttl);
+
+    /**
+      Stop listening; queued queries are dropped
+    */
+    void stop();
+
+    /**
+      Number of queries answered since start()
+    */
+    uint32_t answered();
+
+    /**
+      Number of packets ignored as malformed or not a standard query
+    */
+    uint32_t dropped();
+
+  private:
+    void handlePacket(AsyncUDPPacket &packet);
+
+    AsyncUDP udp;
+    uint8_t answerTemplate[16]; // compressed name pointer, A/IN, TTL, address
+    volatile uint32_t answeredCount;
+    volatile uint32_t droppedCount;
+};
+#endif
@@ -0,0 +1,209 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <MD5Builder.h>
+#include <DrumRadio.h>
+
+#include "bulk.h"
+#include "leader.h"
+
+// Receivers can't reply, so a transfer is sent several times over
+// ("passes"), each receiver keeping whatever chunks it is missing. Each
+// group of chunks is followed by its XOR parity, so a single lost chunk in
+// a group is rebuilt on the spot rather than waiting for the next pass.
+//
+// Firmware is sent flat out, receivers stopping everything else to keep up.
+// Scene sets are trickled out instead, slowly enough for drums to catch
+// them between frames, and the TX carries on sending its other packets.
+
+#define BULK_PASSES 3
+#define BULK_PACKET_US 1000         // gap between packets, while receivers write to flash
+#define BULK_TRICKLE_US 20000       // gap for background transfers; drums read the radio once a frame
+#define BULK_ERASE_MS_PER_SECTOR 50 // receivers erase flash for the image after the start packet
+#define BULK_PUMP_MS 20             // longest one bulkPump() call keeps loop() waiting
+
+enum BulkState
+{
+  BULK_IDLE,
+  BULK_START,
+  BULK_ERASING,
+  BULK_DATA,
+  BULK_END,
+};
+
+static BulkState state = BULK_IDLE;
+static File file;
+static uint8_t kind;
+static uint16_t transferId;
+static uint32_t size;
+static uint32_t chunkCount;
+static uint8_t md5[16];
+static uint8_t pass;
+static uint32_t chunk;
+static uint8_t parity[BULK_CHUNK_SIZE];
+static bool parityDue;
+static unsigned long gapUs;
+static unsigned long nextPacket; // micros()
+static unsigned long waitUntil;
+static unsigned long passStarted;
+
+static void send(DrumPacket &packet)
+{
+  leaderSend(packet);
+}
+
+bool bulkStart(const char *path, uint8_t newKind)
+{
+  if (state != BULK_IDLE)
+  {
+    // firmware can't wait for a background transfer, which is sent again later
+    if (kind == BULK_FIRMWARE || newKind != BULK_FIRMWARE)
+      return false;
+    file.close();
+    state = BULK_IDLE;
+  }
+
+  file = LittleFS.open(path, "r");
+  if (!file)
+  {
+    Serial.printf("Bulk transfer: %s not found\n", path);
+    return false;
+  }
+
+  size = file.size();
+  chunkCount = (size + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE;
+  if (chunkCount == 0 || chunkCount > 0xFFFF)
+  {
+    Serial.printf("Bulk transfer: %s is too large\n", path);
+    file.close();
+    return false;
+  }
+
+  MD5Builder hash;
+  hash.begin();
+  hash.addStream(file, size);
+  hash.calculate();
+  hash.getBytes(md5);
+
+  kind = newKind;
+  gapUs = kind == BULK_FIRMWARE ? BULK_PACKET_US : BULK_TRICKLE_US;
+  transferId = random(1, 0x10000);
+  pass = 0;
+  state = BULK_START;
+
+  Serial.printf("Bulk transfer #%u: %s, %u bytes in %u chunks\n", transferId, path, size, chunkCount);
+  return true;
+}
+
+bool bulkPump()
+{
+  unsigned long started = millis();
+  DrumPacket packet;
+
+  while (state != BULK_IDLE && millis() - started < BULK_PUMP_MS)
+  {
+    switch (state)
+    {
+    case BULK_START:
+      drumPacketInit(packet, PACKET_BULK_START);
+      packet.bulkStart.kind = kind;
+      packet.bulkStart.transfer = transferId;
+      packet.bulkStart.size = size;
+      memcpy(packet.bulkStart.md5, md5, sizeof(md5));
+      send(packet);
+
+      file.seek(0);
+      chunk = 0;
+      memset(parity, 0, sizeof(parity));
+      parityDue = false;
+      passStarted = millis();
+      nextPacket = micros();
+      waitUntil = millis();
+      if (kind == BULK_FIRMWARE)
+        waitUntil += ((size + 4095) / 4096) * BULK_ERASE_MS_PER_SECTOR;
+      state = BULK_ERASING;
+      break;
+
+    case BULK_ERASING:
+      if ((long)(millis() - waitUntil) < 0)
+        return true; // come back later rather than hold up loop()
+      state = BULK_DATA;
+      break;
+
+    case BULK_DATA:
+      if ((long)(micros() - nextPacket) < 0)
+      {
+        if (gapUs > BULK_PACKET_US)
+          return true; // trickling: come back later rather than hold up loop()
+        break;
+      }
+      nextPacket = micros() + gapUs;
+
+      if (parityDue)
+      {
+        drumPacketInit(packet, PACKET_BULK_PARITY);
+        packet.bulkData.transfer = transferId;
+        packet.bulkData.index = (chunk - 1) / BULK_GROUP_SIZE;
+        memcpy(packet.bulkData.data, parity, BULK_CHUNK_SIZE);
+        send(packet);
+        memset(parity, 0, sizeof(parity));
+        parityDue = false;
+
+        if (chunk == chunkCount)
+          state = BULK_END;
+        break;
+      }
+
+      drumPacketInit(packet, PACKET_BULK_DATA);
+      packet.bulkData.transfer = transferId;
+      packet.bulkData.index = chunk;
+      file.read(packet.bulkData.data, BULK_CHUNK_SIZE); // zero-padded at the end
+      send(packet);
+
+      for (uint8_t b = 0; b < BULK_CHUNK_SIZE; b++)
+        parity[b] ^= packet.bulkData.data[b];
+      chunk++;
+      parityDue = chunk % BULK_GROUP_SIZE == 0 || chunk == chunkCount;
+      break;
+
+    case BULK_END:
+    {
+      drumPacketInit(packet, PACKET_BULK_END);
+      packet.bulkEnd.transfer = transferId;
+      send(packet);
+
+      unsigned long took = millis() - passStarted;
+      Serial.printf("Bulk transfer #%u: pass %u took %lu mS (%lu bytes/s)\n",
+                    transferId, pass + 1, took, took ? size * 1000UL / took : 0);
+
+      pass++;
+      if (pass < BULK_PASSES)
+      {
+        state = BULK_START;
+      }
+      else
+      {
+        file.close();
+        state = BULK_IDLE;
+      }
+      break;
+    }
+
+    case BULK_IDLE:
+      break;
+    }
+  }
+
+  return state != BULK_IDLE;
+}
+
+uint8_t bulkKind()
+{
+  return state == BULK_IDLE ? 0 : kind;
+}
+
+uint8_t bulkProgress()
+{
+  if (state == BULK_IDLE || chunkCount == 0)
+    return 0;
+  return ((pass * chunkCount + chunk) * 100) / (BULK_PASSES * chunkCount);
+}
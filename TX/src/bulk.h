@@ -0,0 +1,21 @@
+#ifndef BULK_H
+#define BULK_H
+
+#include <stdint.h>
+
+// Broadcasting a file from LittleFS to every receiver, see bulk.cpp
+
+// Begin sending path as a transfer of the given BulkKind; false if busy or
+// missing. Firmware takes over from a background transfer of scenes
+bool bulkStart(const char *path, uint8_t kind);
+
+// Send the next packets; call every loop. True while a transfer is running
+bool bulkPump();
+
+// The BulkKind being sent, 0 if none
+uint8_t bulkKind();
+
+// 0-100 percent through all passes
+uint8_t bulkProgress();
+
+#endif
@@ -0,0 +1,218 @@
+#include <Arduino.h>
+#include <RF24.h>
+#include <DrumRadio.h>
+
+#include "channel.h"
+#include "leader.h"
+
+// The survey samples every channel for a carrier (the nRF24's RPD, set by
+// anything above -64dBm) CHANNEL_SWEEPS times, a slice of channels each
+// loop, so heartbeats carry on meanwhile and a standby doesn't take over.
+// The leader then picks the channel whose neighbours are quietest too, and
+// if it's clearly better than the one in use, counts down to the switch on
+// the current channel. From then on it beacons the channel in use on
+// CHANNEL_DEFAULT; receivers return there when they lose the TX, and a
+// standby listens there at boot.
+
+extern RF24 radio;
+
+#define CHANNEL_FIRST 2      // below 2.402GHz...
+#define CHANNEL_LAST 80      // ...and above 2.480GHz is outside the ISM band in places
+#define CHANNEL_SWEEPS 20
+#define CHANNEL_SLICE 16     // channels sampled per loop, a few mS
+#define CHANNEL_SETTLE_US 128
+#define CHANNEL_MARGIN 4     // percent quieter before it's worth moving
+#define CHANNEL_STARTUP_MS 2000 // first survey, after the election settles
+#define CHANNEL_NOTICE_MS 1000  // countdown to a switch
+#define CHANNEL_REPEAT_MS 100   // countdown packets
+
+static ChannelSurveyed surveyed;
+static uint8_t current = CHANNEL_DEFAULT;
+static uint16_t hits[CHANNEL_COUNT];
+static uint8_t occupancy[CHANNEL_COUNT];
+static bool haveSurvey = false;
+static bool surveying = false;
+static bool startupSurvey = true;
+static uint8_t sweep = 0;
+static uint8_t next = 0; // channel to sample
+static int16_t target = -1;
+static unsigned long switchAt = 0;
+static unsigned long lastCountdown = 0;
+static unsigned long lastBeacon = 0;
+
+static void tune(uint8_t channel)
+{
+  leaderBorrow();
+  radio.setChannel(channel);
+}
+
+static void switchNow(uint8_t channel)
+{
+  target = -1;
+  if (channel == current)
+    return;
+  current = channel;
+  tune(current);
+  Serial.printf("Radio moved to channel %u\n", current);
+  surveyed();
+}
+
+void channelBegin(ChannelSurveyed newSurveyed)
+{
+  surveyed = newSurveyed;
+  radio.setChannel(current);
+}
+
+void channelSurvey()
+{
+  if (surveying)
+    return;
+  memset(hits, 0, sizeof(hits));
+  sweep = 0;
+  next = 0;
+  surveying = true;
+  Serial.println("Surveying radio channels");
+}
+
+// The quietest channel, taking its neighbours into account: at 1Mbps the
+// drums' signal is about a channel wide, and so is a neighbour's
+static uint8_t quietest(uint16_t &score)
+{
+  uint8_t best = current;
+  score = UINT16_MAX;
+  for (uint8_t c = CHANNEL_FIRST; c <= CHANNEL_LAST; c++)
+  {
+    uint16_t s = 2 * occupancy[c] + occupancy[c - 1] + occupancy[c + 1];
+    if (s < score || (s == score && c == current))
+    {
+      best = c;
+      score = s;
+    }
+  }
+  return best;
+}
+
+static void finish()
+{
+  surveying = false;
+  haveSurvey = true;
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++)
+    occupancy[c] = (hits[c] * 100 + CHANNEL_SWEEPS / 2) / CHANNEL_SWEEPS;
+
+  uint16_t best;
+  uint8_t channel = quietest(best);
+  uint16_t now = 2 * occupancy[current] + occupancy[current - 1] + occupancy[current + 1];
+  Serial.printf("Survey done: channel %u at %u%%, quietest %u at %u%%\n", current, occupancy[current], channel,
+                occupancy[channel]);
+
+  if (channel != current && best + 4 * CHANNEL_MARGIN <= now && leaderLeading())
+  {
+    target = channel;
+    switchAt = millis() + CHANNEL_NOTICE_MS;
+    lastCountdown = 0;
+  }
+  surveyed();
+}
+
+static void sample()
+{
+  leaderBorrow();
+  uint8_t end = next + CHANNEL_SLICE < CHANNEL_COUNT ? next + CHANNEL_SLICE : CHANNEL_COUNT;
+  for (; next < end; next++)
+  {
+    radio.setChannel(next);
+    radio.startListening();
+    delayMicroseconds(CHANNEL_SETTLE_US);
+    radio.stopListening();
+    if (radio.testRPD())
+      hits[next]++;
+  }
+  radio.setChannel(current);
+
+  if (next == CHANNEL_COUNT)
+  {
+    next = 0;
+    if (++sweep == CHANNEL_SWEEPS)
+      finish();
+  }
+}
+
+static void send(uint8_t channel, uint16_t delay)
+{
+  DrumPacket packet;
+  drumPacketInit(packet, PACKET_CHANNEL);
+  packet.channel.channel = channel;
+  packet.channel.delay = delay;
+  leaderSend(packet);
+}
+
+void channelPoll(bool busy)
+{
+  unsigned long now = millis();
+
+  if (target >= 0)
+  {
+    // the countdown goes out on the channel in use; a leader that stood
+    // down meanwhile switches anyway, as the receivers will
+    if ((long)(now - switchAt) >= 0)
+    {
+      switchNow(target);
+    }
+    else if (now - lastCountdown >= CHANNEL_REPEAT_MS)
+    {
+      send(target, switchAt - now);
+      lastCountdown = now;
+    }
+    return;
+  }
+
+  if (!leaderLeading())
+  {
+    startupSurvey = startupSurvey && now < CHANNEL_STARTUP_MS;
+    return;
+  }
+
+  if (current != CHANNEL_DEFAULT && now - lastBeacon >= CHANNEL_BEACON_MS)
+  {
+    tune(CHANNEL_DEFAULT);
+    send(current, 0);
+    radio.setChannel(current);
+    lastBeacon = now;
+  }
+
+  if (startupSurvey && now >= CHANNEL_STARTUP_MS)
+  {
+    startupSurvey = false;
+    channelSurvey();
+  }
+  if (surveying && !busy)
+    sample();
+}
+
+void channelFollow(const ChannelBody &body)
+{
+  if (body.channel >= CHANNEL_COUNT || body.channel == current)
+    return;
+  if (body.delay == 0)
+  {
+    switchNow(body.channel);
+    return;
+  }
+  target = body.channel;
+  switchAt = millis() + body.delay;
+}
+
+uint8_t channelCurrent()
+{
+  return current;
+}
+
+bool channelSurveying()
+{
+  return surveying;
+}
+
+const uint8_t *channelOccupancy()
+{
+  return haveSurvey ? occupancy : nullptr;
+}
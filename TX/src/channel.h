@@ -0,0 +1,30 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Surveying the band and moving the drums to a quiet channel, see channel.cpp
+
+typedef void (*ChannelSurveyed)(); // a survey has finished, or the channel changed
+
+void channelBegin(ChannelSurveyed surveyed);
+
+// Survey all channels, then move to the quietest if it's worth it
+void channelSurvey();
+
+// Carry on with a survey, a switch or the beacon; call every loop. A survey
+// waits while busy, which is when something else needs the air
+void channelPoll(bool busy);
+
+// A standby follows the leader's switch; called by leader.cpp
+void channelFollow(const ChannelBody &body);
+
+uint8_t channelCurrent();
+bool channelSurveying();
+
+// From the last survey, per channel: the percentage of samples that found
+// a carrier, or nullptr before the first survey
+const uint8_t *channelOccupancy();
+
+#endif
@@ -0,0 +1,78 @@
+#include "election.h"
+
+void Election::begin(unsigned long now)
+{
+  started = now;
+  leading = false;
+  heardLeader = false;
+}
+
+bool Election::follow(uint8_t theirTerm, unsigned long now)
+{
+  announce = false;
+  term = theirTerm;
+  leading = false;
+  lastHeard = now;
+  heardLeader = true;
+  return true;
+}
+
+bool Election::heard(uint8_t theirTerm, unsigned long now)
+{
+  if (leading)
+  {
+    // only a newer term displaces us; the same term needs a heartbeat to
+    // say whose it is
+    if (theirTerm != term && drumTermCurrent(theirTerm, term))
+      return follow(theirTerm, now);
+    return false;
+  }
+
+  // until we've heard a leader, any term will do, as ours means nothing yet
+  if (!heardLeader || drumTermCurrent(theirTerm, term))
+    return follow(theirTerm, now);
+  return false; // a deposed leader that hasn't heard yet
+}
+
+bool Election::heard(uint8_t theirTerm, uint8_t theirPriority, uint8_t theirId, unsigned long now)
+{
+  if (leading && theirTerm == term && theirId != id)
+  {
+    // both took over at once; the preferred one keeps it
+    if (theirPriority < priority || (theirPriority == priority && theirId < id))
+      return follow(theirTerm, now);
+    return false;
+  }
+  return heard(theirTerm, now);
+}
+
+bool Election::update(unsigned long now)
+{
+  if (leading)
+    return false;
+
+  unsigned long wait = (heardLeader ? FAILOVER_MS : BOOT_LISTEN_MS) + priority * PRIORITY_STAGGER_MS;
+  if (now - (heardLeader ? lastHeard : started) < wait)
+    return false;
+
+  claim();
+  return true;
+}
+
+void Election::claim()
+{
+  if (leading)
+    return;
+  term++;
+  leading = true;
+  announce = true;
+}
+
+bool Election::heartbeatDue(unsigned long now)
+{
+  if (!leading || (!announce && now - lastHeartbeat < HEARTBEAT_MS))
+    return false;
+  lastHeartbeat = now;
+  announce = false;
+  return true;
+}
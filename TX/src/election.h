@@ -0,0 +1,58 @@
+#ifndef ELECTION_H
+#define ELECTION_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Which of a primary and standby transmitter leads, decided from the
+// packets each hears from the other. Kept free of Arduino and radio
+// dependencies, so tools/failover_sim.cpp can run it on the host.
+//
+// There is no vote: a transmitter that hears nothing from a leader for
+// FAILOVER_MS takes over with a new term, and one that hears a newer term
+// (or the same term from a preferred transmitter) gives way. Priority only
+// breaks ties and staggers the waits, so a recovered primary doesn't take
+// the lead back from a standby that is running fine.
+#define FAILOVER_MS 450      // silence from the leader before taking over
+#define BOOT_LISTEN_MS 600   // at boot, listen this long for a leader first
+#define PRIORITY_STAGGER_MS 150 // added to both waits per step of priority
+
+class Election
+{
+public:
+  Election(uint8_t priority, uint8_t id) : priority(priority), id(id) {}
+
+  uint8_t priority;
+  uint8_t id;
+
+  bool leading = false;
+  uint8_t term = 0;
+
+  void begin(unsigned long now);
+
+  // A packet heard from another transmitter, in its term; priority and id
+  // are only known from a heartbeat. True if this transmitter follows it,
+  // i.e. should adopt the state in its heartbeats.
+  bool heard(uint8_t theirTerm, unsigned long now);
+  bool heard(uint8_t theirTerm, uint8_t theirPriority, uint8_t theirId, unsigned long now);
+
+  // Call often; true when this transmitter has just taken the lead
+  bool update(unsigned long now);
+
+  // Take the lead now, e.g. because this transmitter's UI is being used
+  void claim();
+
+  // For the leader: true when a heartbeat is due, which is then counted sent
+  bool heartbeatDue(unsigned long now);
+
+private:
+  bool follow(uint8_t theirTerm, unsigned long now);
+
+  unsigned long started = 0;
+  unsigned long lastHeard = 0;
+  unsigned long lastHeartbeat = 0;
+  bool heardLeader = false;
+  bool announce = false; // send a heartbeat straight away
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <RF24.h>
+#include <DrumRadio.h>
+
+#include "leader.h"
+#include "election.h"
+#include "channel.h"
+
+// A standby transmitter listens to the primary's packets and heartbeats,
+// keeping its mode, tempo and auto state in step, and takes over when the
+// primary goes quiet (see election.h). The leader listens too, between
+// sends, so two leaders find out about each other and one stands down.
+
+extern RF24 radio;
+
+static Election *election = nullptr;
+static LeaderFill fill;
+static LeaderAdopt adopt;
+static LeaderElected elected;
+static bool listening = false;
+
+void leaderBegin(uint8_t priority, LeaderFill newFill, LeaderAdopt newAdopt, LeaderElected newElected)
+{
+  // the last byte of the MAC tells two transmitters apart
+  uint8_t id = ESP.getEfuseMac() >> 40;
+
+  election = new Election(priority, id);
+  election->begin(millis());
+  fill = newFill;
+  adopt = newAdopt;
+  elected = newElected;
+
+  radio.startListening();
+  listening = true;
+  Serial.printf("TX %u, priority %u: listening for a leader\n", id, priority);
+}
+
+bool leaderSend(DrumPacket &packet)
+{
+  if (!election->leading)
+    return false;
+
+  leaderBorrow();
+  packet.term = election->term;
+  return radio.write(&packet, sizeof(packet), true);
+}
+
+void leaderPoll()
+{
+  unsigned long now = millis();
+
+  if (election->update(now))
+  {
+    Serial.printf("Taking the lead in term %u\n", election->term);
+    elected();
+  }
+
+  if (election->heartbeatDue(now))
+  {
+    DrumPacket packet;
+    drumPacketInit(packet, PACKET_HEARTBEAT);
+    packet.heartbeat.priority = election->priority;
+    packet.heartbeat.id = election->id;
+    fill(packet.heartbeat);
+    leaderSend(packet);
+  }
+
+  if (!listening)
+  {
+    radio.startListening();
+    listening = true;
+  }
+
+  byte pipe;
+  while (radio.available(&pipe))
+  {
+    DrumPacket packet;
+    radio.read(&packet, sizeof(packet));
+    if (drumPacketLegacy(packet))
+      continue;
+
+    bool wasLeading = election->leading;
+    if (drumPacketType(packet) == PACKET_HEARTBEAT)
+    {
+      const HeartbeatBody &heartbeat = packet.heartbeat;
+      if (election->heard(packet.term, heartbeat.priority, heartbeat.id, now))
+        adopt(heartbeat);
+    }
+    else
+    {
+      election->heard(packet.term, now);
+    }
+
+    if (wasLeading && !election->leading)
+      Serial.printf("Standing down for term %u\n", election->term);
+
+    // follow the leader to another channel, with the receivers
+    if (drumPacketType(packet) == PACKET_CHANNEL && !election->leading)
+      channelFollow(packet.channel);
+  }
+}
+
+void leaderBorrow()
+{
+  if (listening)
+  {
+    radio.stopListening();
+    listening = false;
+  }
+}
+
+void leaderClaim()
+{
+  if (election->leading)
+    return;
+  election->claim();
+  Serial.printf("Taking the lead in term %u, as this UI is in use\n", election->term);
+  elected();
+}
+
+bool leaderLeading()
+{
+  return election->leading;
+}
@@ -0,0 +1,32 @@
+#ifndef LEADER_H
+#define LEADER_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Sharing the air with a standby transmitter, see leader.cpp
+
+typedef void (*LeaderFill)(HeartbeatBody &heartbeat);        // our state, for a heartbeat
+typedef void (*LeaderAdopt)(const HeartbeatBody &heartbeat); // the leader's state, to carry on from
+typedef void (*LeaderElected)();                             // we've just taken over
+
+void leaderBegin(uint8_t priority, LeaderFill fill, LeaderAdopt adopt, LeaderElected elected);
+
+// Listen for the other transmitter, send heartbeats and take over when
+// it goes quiet; call every loop
+void leaderPoll();
+
+// Stop listening, to use the radio for something else (the channel
+// survey); leaderPoll() starts again
+void leaderBorrow();
+
+// Take the lead now, e.g. because this transmitter's UI is in use
+void leaderClaim();
+
+bool leaderLeading();
+
+// Send packet in our term; everything the TX sends goes through here.
+// False, and nothing sent, while standing by
+bool leaderSend(DrumPacket &packet);
+
+#endif
@@ -12,17 +12,27 @@
 #include <WiFi.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
-#include <DNSServer.h>
 #include <esp_wifi.h> //Used for mpdu_rx_disable android workaround
 #include <SPI.h>
 #include <nRF24L01.h>
 #include <RF24.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
-#include <millisDelay.h>
+#include <CaptiveDNS.h>
+#include <DrumRadio.h>
+#include <DrumStream.h>
 
 #include <secrets.h>
 
+#include "bulk.h"
+#include "channel.h"
+#include "leader.h"
+#include "scene.h"
+#include "scheduler.h"
+#include "programs.h"
+#include "palettes.h"
+#include "stream.h"
+
 // Setup the network
 const byte DNS_PORT = 53;
 const byte HTTP_PORT = 80;
@@ -30,12 +40,12 @@ const IPAddress localIP(192, 168, 4, 1);          // the IP address the web serv
 const IPAddress gatewayIP(192, 168, 4, 1);        // IP address of the network should be the same as the local IP for captive portals
 const IPAddress subnetMask(255, 255, 255, 0); // no need to change: https://avinetworks.com/glossary/subnet-mask/
 const String localIPURL = "http://192.168.4.1";   // a string version of the local IP with http, used for redirecting clients to your webpage
-#define DNS_INTERVAL 30
+const uint32_t DNS_TTL = 3600;
 
 // Setup the servers
 AsyncWebServer webServer(HTTP_PORT);
 AsyncWebSocket ws("/ws");
-DNSServer dnsServer;
+CaptiveDNS dnsServer;
 
 // Setup the nRF24L01 radio
 #define NRF24L01_PIN_CE 17
@@ -44,13 +54,66 @@ RF24 radio(NRF24L01_PIN_CE, NRF24L01_PIN_CS);
 const byte address[5] = {'R', 'x', 'A', 'A', '1'};
 const byte RETRANSMITS = 5; // how many times we retransmit every message, for reliability in noisy RF environments
 
+#ifndef TX_PRIORITY
+#define TX_PRIORITY 0 // 0 for the primary transmitter, 1 for a hot standby (see platformio.ini)
+#endif
+
 #define LED_BUILTIN 2
 
 int CurrentMode = 0;
+uint16_t bandSeed = 0; // picked at boot; drums seed their random effects from it
+
+void nextAutoMode();
+void broadcastTempo();
+void notifyProgress();
+void notifyMetrics();
 
 const unsigned long AUTO_TIME = 30000; // in mS
 const int AUTO_MODE = -1;
-millisDelay autoDelay; // the delay object
+Task autoTask = {"auto", nextAutoMode};
+
+const unsigned long TEMPO_INTERVAL = 1000; // how often the tempo is rebroadcast, in mS
+uint16_t tempoBpm = 120 << 8;               // 8.8 fixed point
+unsigned long beatOrigin = 0;               // millis() at beat 0, the last tap
+Task tempoTask = {"tempo", broadcastTempo};
+
+const unsigned long CLEANUP_INTERVAL = 1000; // how often dead websocket clients are dropped
+Task cleanupTask = {"ws cleanup", [] { ws.cleanupClients(); }};
+
+const unsigned long METRICS_INTERVAL = 5000; // how often timer and idle metrics go to the UI
+Task metricsTask = {"metrics", notifyMetrics};
+
+const unsigned long STROBE_LEAD_US = 100000;          // strobes are cued this far ahead...
+const byte STROBE_COPIES = 10;                       // ...and sent this many times meanwhile (see tools/strobe_sim.cpp)
+const uint32_t STROBE_WIDTH_US[2] = {30000, 25000}; // how long each flash is held: strobe (98), 999 (199)
+uint16_t strobeCue = 0;
+uint8_t commandNumber = 0; // mode and scene commands sent, see drumPacketNumber()
+
+const char *FIRMWARE_FILE = "/firmware.bin"; // RX firmware image to broadcast on request
+const unsigned long UPDATE_NOTIFY_TIME = 1000;  // how often update progress is sent to the UI, in mS
+Task updateTask = {"update progress", notifyProgress};
+
+// WebSocket messages arrive on the AsyncTCP task, while loop() has the
+// radio and the election; so the handler only queues what was asked for,
+// and loop() acts on it
+enum CommandKind : uint8_t
+{
+  COMMAND_MODE,
+  COMMAND_TEMPO,
+  COMMAND_UPDATE,
+  COMMAND_SURVEY,
+  COMMAND_CONNECT, // a UI has just connected
+};
+
+struct Command
+{
+  CommandKind kind;
+  int mode;
+  float bpm;
+};
+
+const UBaseType_t COMMAND_QUEUE = 8;
+QueueHandle_t commands;
 
 const int autoModes[24] = {
     1, 2, 3, 4, 5, 6, 7, 8,
@@ -97,6 +160,7 @@ void initRadio()
   }
 
   radio.openWritingPipe(address);
+  radio.openReadingPipe(1, address); // to hear the other transmitter, if there is one
   // Set the PA Level to try preventing power supply related problems
   radio.setPALevel(RF24_PA_MAX); // RF24_PA_MAX is default
   radio.setAutoAck(false);
@@ -129,9 +193,10 @@ void setUpWebserver(AsyncWebServer &webServer, const IPAddress &localIP)
 
 void notifyClients()
 {
-  const size_t size = JSON_OBJECT_SIZE(1);
+  const size_t size = JSON_OBJECT_SIZE(2);
   StaticJsonDocument<size> json;
   json["mode"] = CurrentMode;
+  json["tempo"] = (tempoBpm + 128) >> 8;
 
   char msg[32];
   size_t len = serializeJson(json, msg);
@@ -140,16 +205,180 @@ void notifyClients()
   Serial.printf("CurrentMode #%d broadcasted to WS\n", CurrentMode);
 }
 
+void notifyUpdate(uint8_t percent)
+{
+  const size_t size = JSON_OBJECT_SIZE(1);
+  StaticJsonDocument<size> json;
+  json["update"] = percent;
+
+  char msg[32];
+  size_t len = serializeJson(json, msg);
+  ws.textAll(msg, len);
+}
+
+// the channel in use and the last survey, for the Setup tab
+void notifyChannel()
+{
+  const uint8_t *occupancy = channelOccupancy();
+  DynamicJsonDocument json(JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(CHANNEL_COUNT));
+  json["channel"] = channelCurrent();
+  if (occupancy != nullptr)
+  {
+    JsonArray survey = json.createNestedArray("survey");
+    for (uint8_t c = 0; c < CHANNEL_COUNT; c++)
+      survey.add(occupancy[c]);
+  }
+
+  String msg;
+  serializeJson(json, msg);
+  ws.textAll(msg);
+}
+
+// Strobes are cued for a moment just ahead rather than sent as modes, so
+// that every drum flashes at once; each copy says how long is left
+void broadcastStrobe(StrobePattern pattern)
+{
+  DrumPacket packet;
+  drumPacketInit(packet, PACKET_STROBE);
+  packet.strobe.cue = ++strobeCue;
+  packet.strobe.pattern = pattern;
+  packet.strobe.width = STROBE_WIDTH_US[pattern];
+
+  unsigned long fireAt = micros() + STROBE_LEAD_US;
+  for (size_t i = 0; i < STROBE_COPIES && (long)(fireAt - micros()) > 0; i++)
+  {
+    packet.strobe.delay = fireAt - micros();
+    leaderSend(packet);
+    delay(10);
+  }
+  Serial.printf("Strobe %u cued to RF\n", strobeCue);
+}
+
 void broadcastRF()
 {
+  if (CurrentMode == 98 || CurrentMode == 199)
+  {
+    broadcastStrobe(CurrentMode == 98 ? STROBE_FLASH : STROBE_999);
+    return;
+  }
+
+  DrumPacket packet;
+  if (sceneIsMode(CurrentMode))
+  {
+    // the receivers have the scene already; just recall it
+    drumPacketInit(packet, PACKET_SCENE);
+    sceneRecall(packet.scene, CurrentMode);
+    packet.scene.seed = bandSeed;
+  }
+  else
+  {
+    drumPacketInit(packet, PACKET_MODE);
+    packet.mode.mode = CurrentMode;
+    packet.mode.seed = bandSeed;
+  }
+  drumPacketNumber(packet, ++commandNumber);
+
   for (size_t i = 0; i < RETRANSMITS; i++)
   {
-    radio.write(&CurrentMode, sizeof(CurrentMode), true);
+    leaderSend(packet);
     delay(10);
   }
   Serial.printf("CurrentMode #%d broadcasted to RF\n", CurrentMode);
 }
 
+void broadcastProgram(uint8_t slot)
+{
+  const VmProgram &program = vmPrograms[slot];
+
+  DrumPacket packet;
+  drumPacketInit(packet, PACKET_PROGRAM);
+  packet.program.slot = slot;
+  packet.program.parts = (program.length + PROGRAM_PART_SIZE - 1) / PROGRAM_PART_SIZE;
+  packet.program.length = program.length;
+  packet.program.crc = drumCrc16(program.code, program.length);
+
+  for (uint8_t part = 0; part < packet.program.parts; part++)
+  {
+    uint8_t offset = part * PROGRAM_PART_SIZE;
+    packet.program.part = part;
+    memset(packet.program.data, 0, PROGRAM_PART_SIZE);
+    memcpy(packet.program.data, program.code + offset, min(PROGRAM_PART_SIZE, program.length - offset));
+
+    for (size_t i = 0; i < RETRANSMITS; i++)
+    {
+      leaderSend(packet);
+      delay(10);
+    }
+  }
+  Serial.printf("VM program %u broadcasted to RF\n", slot);
+}
+
+void broadcastPalette(uint8_t slot)
+{
+  uint8_t rgb[16 * 3];
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    rgb[i * 3] = firePalettes[slot][i] >> 16;
+    rgb[i * 3 + 1] = firePalettes[slot][i] >> 8;
+    rgb[i * 3 + 2] = firePalettes[slot][i];
+  }
+
+  DrumPacket packet;
+  drumPacketInit(packet, PACKET_PALETTE);
+  packet.palette.slot = slot;
+  packet.palette.crc = drumCrc16(rgb, sizeof(rgb));
+
+  for (uint8_t part = 0; part < 2; part++)
+  {
+    packet.palette.part = part;
+    memcpy(packet.palette.rgb, rgb + part * sizeof(packet.palette.rgb), sizeof(packet.palette.rgb));
+
+    for (size_t i = 0; i < RETRANSMITS; i++)
+    {
+      leaderSend(packet);
+      delay(10);
+    }
+  }
+  Serial.printf("Palette %u broadcasted to RF\n", slot);
+}
+
+// beats per mS at the current tempo, in the same 8.24 format as the RX clock
+uint64_t beatRate()
+{
+  return ((uint64_t)tempoBpm << 16) / 60000;
+}
+
+void broadcastTempo()
+{
+  // beats elapsed since the last tap
+  uint32_t beat = (uint32_t)(beatRate() * (millis() - beatOrigin));
+
+  DrumPacket packet;
+  drumPacketInit(packet, PACKET_TEMPO);
+  packet.tempo.bpm = tempoBpm;
+  packet.tempo.beat = beat;
+
+  // sent every TEMPO_INTERVAL anyway, so no need to retransmit
+  leaderSend(packet);
+}
+
+void setTempo(float bpm)
+{
+  if (bpm < 30 || bpm > 300)
+  {
+    Serial.printf("Ignoring tempo %.1f BPM\n", bpm);
+    return;
+  }
+
+  tempoBpm = (uint16_t)(bpm * 256 + 0.5);
+  beatOrigin = millis(); // the tap that set the tempo was on the beat
+  Serial.printf("Tempo set to %.1f BPM\n", bpm);
+
+  broadcastTempo();
+  taskEvery(tempoTask, TEMPO_INTERVAL);
+  notifyClients();
+}
+
 void handleWSMessage(void *arg, uint8_t *data, size_t len)
 {
   AwsFrameInfo *info = (AwsFrameInfo *)arg;
@@ -166,40 +395,107 @@ void handleWSMessage(void *arg, uint8_t *data, size_t len)
       return;
     }
 
-    int previousMode = CurrentMode;
+    Command command = {COMMAND_MODE, 0, 0};
+    if (json.containsKey("tempo"))
+    {
+      command.kind = COMMAND_TEMPO;
+      command.bpm = json["tempo"];
+    }
+    else if (json.containsKey("update"))
+    {
+      command.kind = COMMAND_UPDATE;
+    }
+    else if (json.containsKey("survey"))
+    {
+      command.kind = COMMAND_SURVEY;
+    }
+    else
+    {
+      command.mode = json["mode"];
+    }
 
-    int newMode = json["mode"];
+    if (xQueueSend(commands, &command, 0) != pdTRUE)
+      Serial.println("WebSocket command dropped; too many waiting");
+  }
+}
 
-    Serial.printf("Received mode #%d\n", newMode);
+// Act on a command from a UI, in loop()
+void runCommand(const Command &command)
+{
+  if (command.kind == COMMAND_CONNECT)
+  {
+    notifyChannel();
+    return;
+  }
 
-    if (newMode == AUTO_MODE)
-    { // auto
-      Serial.printf("AUTO mode set ON\n");
+  // whichever transmitter's UI is being used leads
+  leaderClaim();
 
-      // set a random mode
-      newMode = autoModes[random(24)];
-      Serial.printf("CurrentMode randomised to #%d\n", newMode);
-      autoDelay.start(AUTO_TIME);
-    }
-    else if (CurrentMode = AUTO_MODE)
+  if (command.kind == COMMAND_TEMPO)
+  {
+    setTempo(command.bpm);
+    return;
+  }
+
+  if (command.kind == COMMAND_UPDATE)
+  {
+    // broadcast new firmware to every receiver
+    if (bulkStart(FIRMWARE_FILE, BULK_FIRMWARE))
     {
-      autoDelay.stop();
-      Serial.printf("AUTO mode set OFF\n");
+      notifyUpdate(0);
+      taskEvery(updateTask, UPDATE_NOTIFY_TIME);
     }
+    return;
+  }
 
-    CurrentMode = newMode;
-    Serial.printf("CurrentMode set to #%d\n", CurrentMode);
+  if (command.kind == COMMAND_SURVEY)
+  {
+    channelSurvey();
+    return;
+  }
 
-    broadcastRF();
+  int previousMode = CurrentMode;
 
-    if (newMode == 98)
-    { // revert mode for strobe (RX automatically revert so no need to TX)
-      CurrentMode = previousMode;
-      Serial.printf("CurrentMode reverted to #%d\n", previousMode);
-    }
+  int newMode = command.mode;
 
-    notifyClients();
+  Serial.printf("Received mode #%d\n", newMode);
+
+  if (newMode == AUTO_MODE)
+  { // auto
+    Serial.printf("AUTO mode set ON\n");
+
+    // set a random mode
+    newMode = autoModes[random(24)];
+    Serial.printf("CurrentMode randomised to #%d\n", newMode);
+    taskEvery(autoTask, AUTO_TIME);
   }
+  else if (CurrentMode = AUTO_MODE)
+  {
+    taskStop(autoTask);
+    Serial.printf("AUTO mode set OFF\n");
+  }
+
+  CurrentMode = newMode;
+  Serial.printf("CurrentMode set to #%d\n", CurrentMode);
+
+  if (CurrentMode >= VM_MODE_FIRST && CurrentMode < VM_MODE_FIRST + vmProgramCount)
+  { // make sure the receivers have the program before running it
+    broadcastProgram(CurrentMode - VM_MODE_FIRST);
+  }
+  if (CurrentMode >= PALETTE_MODE_FIRST && CurrentMode < PALETTE_MODE_FIRST + firePaletteCount)
+  { // and the palette
+    broadcastPalette(CurrentMode - PALETTE_MODE_FIRST);
+  }
+
+  broadcastRF();
+
+  if (newMode == 98)
+  { // revert mode for strobe (RX automatically revert so no need to TX)
+    CurrentMode = previousMode;
+    Serial.printf("CurrentMode reverted to #%d\n", previousMode);
+  }
+
+  notifyClients();
 }
 
 void onWSEvent(AsyncWebSocket *server,
@@ -214,6 +510,10 @@ void onWSEvent(AsyncWebSocket *server,
   {
   case WS_EVT_CONNECT:
     Serial.printf("WebSocket client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
+    {
+      Command command = {COMMAND_CONNECT, 0, 0};
+      xQueueSend(commands, &command, 0);
+    }
     break;
   case WS_EVT_DISCONNECT:
     Serial.printf("WebSocket client #%u disconnected\n", client->id());
@@ -234,12 +534,14 @@ void initWebSocket()
   webServer.addHandler(&ws);
 }
 
-void setUpDNSServer(DNSServer &dnsServer, const IPAddress &localIP)
+void setUpDNSServer(CaptiveDNS &dnsServer, const IPAddress &localIP)
 {
-  // Respond to all DNS requests with the ESP's IP
-  dnsServer.setErrorReplyCode(DNSReplyCode::NoError);
-  dnsServer.setTTL(3600);
-  dnsServer.start(DNS_PORT, "*", WiFi.softAPIP());
+  // Respond to all DNS requests with the ESP's IP, as they arrive
+  if (!dnsServer.start(DNS_PORT, WiFi.softAPIP(), DNS_TTL))
+  {
+    Serial.println("DNS server failed to start");
+    return;
+  }
   Serial.println("DNS server started");
 }
 
@@ -266,6 +568,48 @@ void startAccessPoint(const char *ssid, const char *password, const IPAddress &l
   vTaskDelay(100 / portTICK_PERIOD_MS); // Add a small delay
 }
 
+void fillHeartbeat(HeartbeatBody &heartbeat)
+{
+  heartbeat.mode = CurrentMode;
+  heartbeat.autoMode = taskRunning(autoTask);
+  heartbeat.seed = bandSeed;
+  heartbeat.bpm = tempoBpm;
+  heartbeat.beat = (uint32_t)(beatRate() * (millis() - beatOrigin));
+}
+
+void adoptHeartbeat(const HeartbeatBody &heartbeat)
+{
+  bool changed = heartbeat.mode != CurrentMode || heartbeat.bpm != tempoBpm;
+
+  CurrentMode = heartbeat.mode;
+  bandSeed = heartbeat.seed;
+  if (heartbeat.bpm >= 30 << 8)
+  {
+    tempoBpm = heartbeat.bpm;
+    beatOrigin = millis() - heartbeat.beat / beatRate();
+  }
+
+  // keep the timer from running out while the leader is heard, so that
+  // if we take over, auto mode carries on
+  if (heartbeat.autoMode)
+    taskEvery(autoTask, AUTO_TIME);
+  else
+    taskStop(autoTask);
+
+  if (changed)
+    notifyClients();
+}
+
+void takeOver()
+{
+  // the receivers already have the leader's programs and palettes, so
+  // the mode and beat are all that need repeating
+  broadcastTempo();
+  taskEvery(tempoTask, TEMPO_INTERVAL);
+  if (CurrentMode != 0)
+    broadcastRF();
+}
+
 void setup()
 {
   pinMode(LED_BUILTIN, OUTPUT);
@@ -277,11 +621,16 @@ void setup()
   }
 
   initRadio();
+  bandSeed = esp_random();
+  leaderBegin(TX_PRIORITY, fillHeartbeat, adoptHeartbeat, takeOver);
+  channelBegin(notifyChannel);
 
   if(!LittleFS.begin(true)){
     Serial.println("An Error has occurred while mounting LITTLEFS");
     return;
   }
+  streamBegin();
+  sceneBegin();
 
   startAccessPoint(WIFI_SSID, WIFI_PASS, localIP, gatewayIP, subnetMask);
 
@@ -290,28 +639,75 @@ void setup()
   setUpWebserver(webServer, localIP);
   webServer.begin();
 
+  commands = xQueueCreate(COMMAND_QUEUE, sizeof(Command));
   initWebSocket();
 
+  taskEvery(tempoTask, TEMPO_INTERVAL);
+  taskEvery(cleanupTask, CLEANUP_INTERVAL);
+  taskEvery(metricsTask, METRICS_INTERVAL);
+
   Serial.println("Ready; HTTP server started on " + WiFi.softAPIP().toString());
 }
 
-void loop()
+void nextAutoMode()
 {
-  dnsServer.processNextRequest();
-  ws.cleanupClients();
+  // set a random mode
+  CurrentMode = autoModes[random(24)];
+  Serial.printf("CurrentMode randomised to #%d\n", CurrentMode);
+
+  broadcastRF();
+  notifyClients();
+}
 
-  if (autoDelay.justFinished())
+void notifyProgress()
+{
+  if (bulkKind() == BULK_FIRMWARE)
   {
-    // set a random mode
-    CurrentMode = autoModes[random(24)];
-    Serial.printf("CurrentMode randomised to #%d\n", CurrentMode);
+    notifyUpdate(bulkProgress());
+    return;
+  }
+  notifyUpdate(100);
+  taskStop(updateTask);
+}
 
-    broadcastRF();
-    notifyClients();
+// how late each timer runs and how much of the loop is idle, for the Setup tab
+void notifyMetrics()
+{
+  DynamicJsonDocument json(1024);
+  json["idle"] = schedulerIdlePercent();
+  JsonArray timers = json.createNestedArray("timers");
+  for (const Task *task = schedulerTasks(); task; task = task->listed)
+  {
+    JsonObject timer = timers.createNestedObject();
+    timer["name"] = task->name;
+    timer["runs"] = task->runs;
+    timer["late"] = task->runs ? (float)task->lateTotal / task->runs : 0;
+    timer["worst"] = task->lateWorst;
+  }
+
+  String msg;
+  serializeJson(json, msg);
+  ws.textAll(msg);
+}
+
+void loop()
+{
+  Command command;
+  while (xQueueReceive(commands, &command, 0) == pdTRUE)
+    runCommand(command);
+
+  leaderPoll();
+  schedulerRun();
 
-    autoDelay.repeat(); // repeat
-    Serial.println("autoDelay restarted");
+  scenePoll(CurrentMode == STREAM_MODE);
+
+  bool sending = bulkPump();
+  if (!sending && CurrentMode == STREAM_MODE)
+  {
+    streamPump();
   }
 
-  delay(DNS_INTERVAL);  // seems to help with stability, if you are doing other things in the loop this may not be needed
+  bool busy = sending || CurrentMode == STREAM_MODE;
+  channelPoll(busy);
+  schedulerIdle(busy || channelSurveying());
 }
@@ -0,0 +1,22 @@
+#include <DrumRadio.h>
+
+// Fire palettes for the receivers, sent to them when first selected; the
+// palette at index n here is shown by mode PALETTE_MODE_FIRST + n. Black to
+// the hottest colour, as the receivers' own fire palettes run.
+
+// 55: ice
+const uint32_t iceFire[16] = {0x000000, 0x000814, 0x001028, 0x00183c, 0x002050, 0x002864, 0x103c78, 0x20508c,
+                              0x3064a0, 0x4078b4, 0x608cc8, 0x80a0d8, 0xa0b8e4, 0xc0d0f0, 0xe0e8f8, 0xffffff};
+
+// 56: toxic
+const uint32_t toxicFire[16] = {0x000000, 0x081000, 0x102000, 0x183000, 0x204000, 0x285000, 0x346400, 0x407800,
+                                0x508c00, 0x60a000, 0x78b400, 0x90c800, 0xa8dc10, 0xc0f020, 0xd8ff40, 0xf0ff80};
+
+// 57: sunset
+const uint32_t sunsetFire[16] = {0x000000, 0x100010, 0x200020, 0x300030, 0x480038, 0x600040, 0x780040, 0x900038,
+                                 0xa80830, 0xc01828, 0xd82820, 0xf04010, 0xff6000, 0xff8000, 0xffa020, 0xffc040};
+
+const uint32_t *const firePalettes[] = {iceFire, toxicFire, sunsetFire};
+const uint8_t firePaletteCount = sizeof(firePalettes) / sizeof(firePalettes[0]);
+
+static_assert(sizeof(firePalettes) / sizeof(firePalettes[0]) <= PALETTE_SLOTS, "more palettes than the receivers have slots");
@@ -0,0 +1,72 @@
+#include <DrumVM.h>
+
+// Effect programs for the receivers' VM, sent to them when first selected;
+// the program at index n here runs as mode VM_MODE_FIRST + n
+
+// 200: rainbow, once round the colour wheel per bar
+const uint8_t vmRainbow[] = {
+    VM_IN, 0, VM_IN_BAR,      // 0  r0 = bar phase
+    VM_SHR | VM_IMM, 0, 8,    // 1  r0 >>= 8
+    VM_IN, 1, VM_IN_PIXEL,    // 2  r1 = pixel
+    VM_MUL | VM_IMM, 1, 7,    // 3  r1 *= 7
+    VM_ADD, 0, 1,             // 4  hue = r0 + r1
+    VM_AND | VM_IMM, 0, 255,  // 5
+    VM_LDI, 1, 240,           // 6  saturation
+    VM_LDI, 2, 255,           // 7  value
+    VM_HSV, 0, 0,             // 8
+};
+
+// 201: blue chase, four dots moving one segment per beat with fading tails
+const uint8_t vmChase[] = {
+    VM_IN, 0, VM_IN_COUNT,    // 0  r0 = segment length
+    VM_DIV | VM_IMM, 0, 4,    // 1
+    VM_IN, 1, VM_IN_PIXEL,    // 2  r1 = position within segment
+    VM_MOD, 1, 0,             // 3
+    VM_IN, 2, VM_IN_BEAT,     // 4  r2 = where the dots are this beat
+    VM_SCALE8, 2, 0,          // 5
+    VM_SUB, 1, 2,             // 6
+    VM_JNZ, 1, 12,            // 7  not a dot: fade
+    VM_LDI, 3, 0,             // 8
+    VM_LDI, 4, 0,             // 9
+    VM_LDI, 5, 255,           // 10
+    VM_RGB, 3, 0,             // 11 blue
+    VM_LDI, 6, 155,           // 12
+    VM_FADE, 6, 0,            // 13
+};
+
+// 202: slowly churning lava, from noise
+const uint8_t vmLava[] = {
+    VM_IN, 0, VM_IN_PIXEL,    // 0  r0 = pixel * 30
+    VM_MUL | VM_IMM, 0, 30,   // 1
+    VM_IN, 1, VM_IN_MILLIS,   // 2  r1 = time / 4
+    VM_SHR | VM_IMM, 1, 2,    // 3
+    VM_NOISE, 0, 1,           // 4
+    VM_PAL, 0, VM_PAL_LAVA,   // 5
+};
+
+// 203: a wave of colour sweeping across the whole band, left to right, each bar
+const uint8_t vmWave[] = {
+    VM_IN, 0, VM_IN_BAND,     // 0  r0 = band position - bar phase
+    VM_IN, 1, VM_IN_BAR,      // 1
+    VM_SHR | VM_IMM, 1, 8,    // 2
+    VM_SUB, 0, 1,             // 3
+    VM_SIN8, 0, 0,            // 4  r2 = brightness
+    VM_MOV, 2, 0,             // 5
+    VM_LDI, 0, 160,           // 6  hue
+    VM_LDI, 1, 255,           // 7  saturation
+    VM_HSV, 0, 0,             // 8
+};
+
+struct VmProgram
+{
+  const uint8_t *code;
+  uint8_t length;
+};
+
+const VmProgram vmPrograms[] = {
+    {vmRainbow, sizeof(vmRainbow)},
+    {vmChase, sizeof(vmChase)},
+    {vmLava, sizeof(vmLava)},
+    {vmWave, sizeof(vmWave)},
+};
+const uint8_t vmProgramCount = sizeof(vmPrograms) / sizeof(vmPrograms[0]);
@@ -0,0 +1,126 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <DrumRadio.h>
+#include <DrumScene.h>
+
+#include "scene.h"
+#include "scenes.h"
+#include "bulk.h"
+#include "leader.h"
+
+// Receivers can't say what they hold, so the leader sends the whole set
+// every SCENE_RESEND_MS, as a background bulk transfer. A drum that already
+// has it ignores the transfer, one that was off or out of range picks it
+// up, and one whose set is stale shows each recall's fallback mode until
+// then. The set is written to LittleFS for bulk.cpp to send, only when it
+// has changed.
+
+#define SCENE_FILE "/scenes.bin"
+#define SCENE_FIRST_MS 5000   // after boot, before sending the set
+#define SCENE_RESEND_MS 60000
+
+static SceneSetHeader header;
+static Scene scenes[SCENE_MAX];
+static unsigned long lastSent = 0;
+static bool sent = false;
+
+static void build(const SceneDef &def, Scene &scene)
+{
+  memset(&scene, 0, sizeof(scene));
+  strncpy(scene.name, def.name, SCENE_NAME_SIZE);
+  scene.mode = def.mode;
+  memcpy(scene.groups, def.groups, sizeof(scene.groups));
+
+  if (def.palette >= 0 && def.palette < firePaletteCount)
+  {
+    scene.flags |= SCENE_PALETTE;
+    scene.paletteSlot = def.palette;
+    for (uint8_t i = 0; i < 16; i++)
+    {
+      scene.palette[i * 3] = firePalettes[def.palette][i] >> 16;
+      scene.palette[i * 3 + 1] = firePalettes[def.palette][i] >> 8;
+      scene.palette[i * 3 + 2] = firePalettes[def.palette][i];
+    }
+  }
+
+  if (def.program >= 0 && def.program < vmProgramCount)
+  {
+    const VmProgram &program = vmPrograms[def.program];
+    if (program.length <= SCENE_PROGRAM_SIZE)
+    {
+      scene.flags |= SCENE_PROGRAM;
+      scene.programSlot = def.program;
+      scene.programLength = program.length;
+      memcpy(scene.program, program.code, program.length);
+    }
+    else
+    {
+      Serial.printf("Scene %s: program %d is too long for a scene\n", def.name, def.program);
+    }
+  }
+}
+
+void sceneBegin()
+{
+  for (uint8_t n = 0; n < sceneCount; n++)
+    build(sceneDefs[n], scenes[n]);
+
+  header.magic = SCENE_MAGIC;
+  header.format = SCENE_FORMAT;
+  header.count = sceneCount;
+  header.reserved = 0;
+  header.version = sceneSetVersion(scenes, sceneCount);
+  size_t size = sceneCount * sizeof(Scene);
+
+  // rewrite the file only if it differs, to spare the flash
+  File file = LittleFS.open(SCENE_FILE, "r");
+  bool same = file && file.size() == sizeof(header) + size;
+  if (same)
+  {
+    SceneSetHeader existing;
+    same = file.read((uint8_t *)&existing, sizeof(existing)) == sizeof(existing) &&
+           memcmp(&existing, &header, sizeof(header)) == 0;
+  }
+  if (file)
+    file.close();
+
+  if (!same)
+  {
+    file = LittleFS.open(SCENE_FILE, "w");
+    if (!file)
+    {
+      Serial.println("Scenes: can't write " SCENE_FILE);
+      return;
+    }
+    file.write((const uint8_t *)&header, sizeof(header));
+    file.write((const uint8_t *)scenes, size);
+    file.close();
+  }
+  Serial.printf("Scene set v%04x: %u scenes\n", header.version, header.count);
+}
+
+void scenePoll(bool streaming)
+{
+  unsigned long now = millis();
+  if (streaming || !leaderLeading() || bulkKind() != 0)
+    return;
+  if (sent ? now - lastSent < SCENE_RESEND_MS : now < SCENE_FIRST_MS)
+    return;
+
+  bulkStart(SCENE_FILE, BULK_SCENES);
+  sent = true;
+  lastSent = now;
+}
+
+bool sceneIsMode(int mode)
+{
+  return mode >= SCENE_MODE_FIRST && mode < SCENE_MODE_FIRST + sceneCount;
+}
+
+void sceneRecall(SceneBody &recall, int mode)
+{
+  uint8_t n = mode - SCENE_MODE_FIRST;
+  recall.scene = n;
+  recall.version = header.version;
+  recall.fallback = scenes[n].mode;
+}
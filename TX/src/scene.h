@@ -0,0 +1,22 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdint.h>
+#include <DrumRadio.h>
+
+// Scenes cached on the receivers, see scene.cpp and scenes.h
+
+// Build the set from scenes.h, and keep it in LittleFS for sending
+void sceneBegin();
+
+// Send the set again when it's due; call every loop. Not while streaming,
+// which needs the air
+void scenePoll(bool streaming);
+
+// Is mode a scene's?
+bool sceneIsMode(int mode);
+
+// Fill in a recall of the scene with the given mode
+void sceneRecall(SceneBody &recall, int mode);
+
+#endif
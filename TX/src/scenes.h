@@ -0,0 +1,33 @@
+#include <DrumScene.h>
+
+#include "palettes.h"
+#include "programs.h"
+
+// Scenes for the receivers to cache, sent to them in the background; the
+// scene at index n here is recalled by mode SCENE_MODE_FIRST + n. groups
+// give drum types (as in each receiver's [drum] section) a mode of their
+// own; palette and program are indices into palettes.h and programs.h,
+// loaded into the same slots their own modes use, or -1 for none.
+
+struct SceneDef
+{
+  const char *name;
+  int16_t mode;
+  SceneGroup groups[SCENE_GROUPS];
+  int8_t palette;
+  int8_t program;
+};
+
+const SceneDef sceneDefs[] = {
+    // 300: the flag round the type 1 drums, the rest spinning
+    {"Carnival", 91, {{1, 93}}, -1, -1},
+    // 301: ice, with the type 1 drums burning orange
+    {"Ice & fire", PALETTE_MODE_FIRST + 0, {{1, 50}}, 0, -1},
+    // 302: lava, with red fire on the type 1 drums
+    {"Lava glow", VM_MODE_FIRST + 2, {{1, 53}}, -1, 2},
+    // 303: the wave across the band over a blue chase on the type 1 drums
+    {"Blue wave", VM_MODE_FIRST + 3, {{1, 13}}, -1, 3},
+};
+const uint8_t sceneCount = sizeof(sceneDefs) / sizeof(sceneDefs[0]);
+
+static_assert(sizeof(sceneDefs) / sizeof(sceneDefs[0]) <= SCENE_MAX, "more scenes than the receivers can cache");
@@ -0,0 +1,199 @@
+#include <Arduino.h>
+
+#include "scheduler.h"
+
+// A hashed timer wheel with a slot per millisecond: a task sits in the slot
+// for its due time modulo the wheel, so each loop only looks at the slots
+// for the milliseconds that have passed, and a task due further ahead than
+// one turn stays put until its turn comes round. Lateness (the jitter of
+// each dispatch against its deadline) is kept per task; idle time is what
+// schedulerIdle() gave away. WebSocket commands are queued for the loop
+// (see main.cpp), but the wheel is still only touched under a lock, in
+// case a task is started from another FreeRTOS task; it is never held
+// while a callback runs.
+
+#define WHEEL_SLOTS 64
+#define SCHEDULER_IDLE_MS 5
+
+static Task *wheel[WHEEL_SLOTS];
+static Task *tasks = nullptr; // every task ever started
+static unsigned long lastRun = 0;
+static bool running = false;
+static unsigned long idleUs = 0;
+static unsigned long windowStart = 0;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void unlink(Task &task)
+{
+  if (!task.queued)
+    return;
+  for (Task **link = &wheel[task.due % WHEEL_SLOTS]; *link; link = &(*link)->next)
+  {
+    if (*link == &task)
+    {
+      *link = task.next;
+      break;
+    }
+  }
+  task.queued = false;
+}
+
+static void queue(Task &task, unsigned long due)
+{
+  task.due = due;
+  Task *&slot = wheel[due % WHEEL_SLOTS];
+  task.next = slot;
+  slot = &task;
+  task.queued = true;
+}
+
+static void start(Task &task, unsigned long ms, unsigned long period)
+{
+  portENTER_CRITICAL(&lock);
+  if (!running)
+  {
+    running = true;
+    lastRun = millis();
+    windowStart = micros();
+  }
+
+  bool listed = false;
+  for (const Task *t = tasks; t; t = t->listed)
+    listed = listed || t == &task;
+  if (!listed)
+  {
+    task.listed = tasks;
+    tasks = &task;
+  }
+
+  unlink(task);
+  task.period = period;
+  queue(task, millis() + ms);
+  portEXIT_CRITICAL(&lock);
+}
+
+void taskEvery(Task &task, unsigned long ms)
+{
+  start(task, ms, ms ? ms : 1);
+}
+
+void taskAfter(Task &task, unsigned long ms)
+{
+  start(task, ms, 0);
+}
+
+void taskStop(Task &task)
+{
+  portENTER_CRITICAL(&lock);
+  unlink(task);
+  portEXIT_CRITICAL(&lock);
+}
+
+bool taskRunning(const Task &task)
+{
+  return task.queued;
+}
+
+// Take the next task in the slot for tick that is due by now off the
+// wheel, putting it back for its next run if it repeats
+static Task *takeDue(unsigned long tick, unsigned long now)
+{
+  for (Task **link = &wheel[tick % WHEEL_SLOTS]; *link; link = &(*link)->next)
+  {
+    Task &task = **link;
+    if ((long)(now - task.due) < 0)
+      continue; // a later turn of the wheel
+
+    *link = task.next;
+    task.queued = false;
+
+    uint32_t late = now - task.due;
+    task.runs++;
+    task.lateTotal += late;
+    if (late > task.lateWorst)
+      task.lateWorst = late;
+
+    if (task.period != 0)
+    {
+      // keep to the original schedule, unless a whole period has been missed
+      unsigned long due = task.due + task.period;
+      queue(task, (long)(due - now) > 0 ? due : now + task.period);
+    }
+    return &task;
+  }
+  return nullptr;
+}
+
+static void runSlot(unsigned long tick, unsigned long now)
+{
+  for (;;)
+  {
+    portENTER_CRITICAL(&lock);
+    Task *task = takeDue(tick, now);
+    portEXIT_CRITICAL(&lock);
+    if (task == nullptr)
+      return;
+    task->callback(); // may restart or stop any task, itself included
+  }
+}
+
+void schedulerRun()
+{
+  if (!running)
+    return;
+
+  unsigned long now = millis();
+  unsigned long ticks = now - lastRun + 1;
+  if (ticks > WHEEL_SLOTS)
+    ticks = WHEEL_SLOTS; // every slot once covers a long stall
+  for (unsigned long t = 0; t < ticks; t++)
+    runSlot(now - t, now);
+  lastRun = now + 1;
+}
+
+// mS until the next task is due, looking at most limit ahead
+static unsigned long untilNext(unsigned long limit)
+{
+  unsigned long now = millis();
+  unsigned long ahead = 0;
+  portENTER_CRITICAL(&lock);
+  for (; ahead < limit; ahead++)
+  {
+    bool found = false;
+    for (const Task *task = wheel[(now + ahead) % WHEEL_SLOTS]; task && !found; task = task->next)
+      found = task->due == now + ahead;
+    if (found)
+      break;
+  }
+  portEXIT_CRITICAL(&lock);
+  return ahead;
+}
+
+void schedulerIdle(bool busy)
+{
+  if (busy)
+    return;
+
+  unsigned long wait = untilNext(SCHEDULER_IDLE_MS);
+  if (wait == 0)
+    return;
+
+  unsigned long start = micros();
+  delay(wait); // lets the WiFi and web server tasks have the CPU
+  idleUs += micros() - start;
+}
+
+uint8_t schedulerIdlePercent()
+{
+  unsigned long now = micros();
+  unsigned long total = now - windowStart;
+  uint8_t percent = total ? (uint64_t)idleUs * 100 / total : 0;
+  idleUs = 0;
+  windowStart = now;
+  return percent;
+}
+
+const Task *schedulerTasks()
+{
+  return tasks;
+}
@@ -0,0 +1,49 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Timed jobs for the main loop, dispatched from a timer wheel; see scheduler.cpp
+
+typedef void (*TaskCallback)();
+
+// A job; the caller owns it, the scheduler only links it in while it runs.
+// Set name and callback, and leave the rest to the scheduler
+struct Task
+{
+  const char *name;
+  TaskCallback callback;
+
+  unsigned long period; // mS, 0 for once
+  unsigned long due;
+  Task *next;
+  bool queued;
+  Task *listed; // every task started, for the metrics
+
+  uint32_t runs;
+  uint32_t lateTotal; // mS past due, summed over runs
+  uint32_t lateWorst;
+};
+
+// Run the task every ms from now, or once in ms; either restarts it if it
+// is already running
+void taskEvery(Task &task, unsigned long ms);
+void taskAfter(Task &task, unsigned long ms);
+void taskStop(Task &task);
+bool taskRunning(const Task &task);
+
+// Call any tasks that are due; call every loop
+void schedulerRun();
+
+// Unless busy, give the CPU away until the next task is due, or
+// SCHEDULER_IDLE_MS at most so the rest of the loop still polls; call at
+// the end of every loop
+void schedulerIdle(bool busy);
+
+// For metrics: the share of the time since the last call spent idle
+uint8_t schedulerIdlePercent();
+
+// Every task started so far, for its metrics
+const Task *schedulerTasks();
+
+#endif
@@ -0,0 +1,184 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <DrumRadio.h>
+#include <DrumStream.h>
+
+#include "stream.h"
+#include "leader.h"
+
+// Looks that are easier drawn centrally than coded on the drums are played
+// from /sequence.txt, one frame per line. A line holds a frame for every
+// drum, as 64 hex digits (palette indices, see DrumStream.h), and/or frames
+// for particular drum types, as "type:" and 64 hex digits; lines starting
+// with # are comments. Without a sequence, a built-in one is played.
+//
+// Each frame is sent just once: the receivers cover for lost packets, and
+// every STREAM_KEY_INTERVAL frames a keyframe puts them right.
+
+#define SEQUENCE_FILE "/sequence.txt"
+#define STREAM_FPS 20
+#define STREAM_GROUPS 16     // drum types 0-15; 0 means every drum
+#define STREAM_MAX_STEPS 512 // lines of sequence held in memory
+
+struct StreamStep
+{
+  uint16_t groups; // bitmap of the groups with a frame in this step
+  uint8_t (*frames)[STREAM_PIXELS];
+};
+
+static StreamStep *steps = nullptr;
+static uint16_t stepCount = 0;
+static uint16_t step = 0;
+static uint8_t frameNumber = 0;
+static uint8_t previous[STREAM_GROUPS][STREAM_PIXELS];
+static unsigned long lastFrame = 0;
+
+static int hexDigit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseFrame(const String &hex, uint8_t *frame)
+{
+  if (hex.length() != STREAM_PIXELS)
+    return false;
+  for (uint8_t i = 0; i < STREAM_PIXELS; i++)
+  {
+    int digit = hexDigit(hex[i]);
+    if (digit < 0)
+      return false;
+    frame[i] = digit;
+  }
+  return true;
+}
+
+static bool parseStep(String line, StreamStep &parsed)
+{
+  uint8_t frames[STREAM_GROUPS][STREAM_PIXELS];
+  uint16_t groups = 0;
+
+  line.trim();
+  while (line.length() > 0)
+  {
+    int space = line.indexOf(' ');
+    String token = space < 0 ? line : line.substring(0, space);
+    line = space < 0 ? "" : line.substring(space + 1);
+    line.trim();
+
+    int group = 0;
+    int colon = token.indexOf(':');
+    if (colon >= 0)
+    {
+      group = token.substring(0, colon).toInt();
+      token = token.substring(colon + 1);
+    }
+    if (group < 0 || group >= STREAM_GROUPS || !parseFrame(token, frames[group]))
+      return false;
+    groups |= 1 << group;
+  }
+  if (groups == 0)
+    return false;
+
+  // keep only the frames this step has
+  uint8_t count = __builtin_popcount(groups);
+  parsed.groups = groups;
+  parsed.frames = (uint8_t(*)[STREAM_PIXELS])malloc(count * STREAM_PIXELS);
+  if (parsed.frames == nullptr)
+    return false;
+  uint8_t n = 0;
+  for (uint8_t g = 0; g < STREAM_GROUPS; g++)
+  {
+    if (groups & (1 << g))
+      memcpy(parsed.frames[n++], frames[g], STREAM_PIXELS);
+  }
+  return true;
+}
+
+void streamBegin()
+{
+  File file = LittleFS.open(SEQUENCE_FILE, "r");
+  if (!file)
+  {
+    Serial.println("No " SEQUENCE_FILE "; streaming the built-in sequence");
+    return;
+  }
+
+  steps = (StreamStep *)malloc(STREAM_MAX_STEPS * sizeof(StreamStep));
+  int lineNumber = 0;
+  while (steps && file.available() && stepCount < STREAM_MAX_STEPS)
+  {
+    String line = file.readStringUntil('\n');
+    lineNumber++;
+    line.trim();
+    if (line.length() == 0 || line[0] == '#')
+      continue;
+    if (parseStep(line, steps[stepCount]))
+      stepCount++;
+    else
+      Serial.printf(SEQUENCE_FILE " line %d: not a frame\n", lineNumber);
+  }
+  file.close();
+  Serial.printf("Stream sequence of %u frames loaded\n", stepCount);
+}
+
+// Green, gold and blue thirds turning round the drums, with a white spark
+// that goes the other way
+static void builtInFrame(uint8_t frame, uint8_t *pixels)
+{
+  const uint8_t colours[3] = {6, 5, 10};
+  for (uint8_t i = 0; i < STREAM_PIXELS; i++)
+    pixels[(i + frame) % STREAM_PIXELS] = colours[i * 3 / STREAM_PIXELS];
+  pixels[(STREAM_PIXELS - frame % STREAM_PIXELS) % STREAM_PIXELS] = 1;
+}
+
+static void sendFrame(uint8_t group, const uint8_t *pixels)
+{
+  bool key = frameNumber % STREAM_KEY_INTERVAL == 0;
+
+  DrumPacket packet;
+  uint8_t pixel = 0;
+  do
+  {
+    drumPacketInit(packet, PACKET_STREAM);
+    packet.stream.group = group;
+    packet.stream.frame = frameNumber;
+    packet.stream.start = pixel;
+    packet.stream.length = streamEncode(pixels, key ? nullptr : previous[group], pixel, packet.stream.data, STREAM_PART_SIZE);
+    packet.stream.flags = (key ? STREAM_KEY : 0) | (pixel == STREAM_PIXELS ? STREAM_LAST : 0);
+    leaderSend(packet);
+  } while (pixel < STREAM_PIXELS);
+
+  memcpy(previous[group], pixels, STREAM_PIXELS);
+}
+
+void streamPump()
+{
+  if (millis() - lastFrame < 1000 / STREAM_FPS)
+    return;
+  lastFrame = millis();
+
+  if (stepCount == 0)
+  {
+    uint8_t pixels[STREAM_PIXELS];
+    builtInFrame(frameNumber, pixels);
+    sendFrame(0, pixels);
+  }
+  else
+  {
+    const StreamStep &current = steps[step];
+    uint8_t n = 0;
+    for (uint8_t g = 0; g < STREAM_GROUPS; g++)
+    {
+      if (current.groups & (1 << g))
+        sendFrame(g, current.frames[n++]);
+    }
+    step = (step + 1) % stepCount;
+  }
+  frameNumber++;
+}
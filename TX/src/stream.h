@@ -0,0 +1,12 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+// Frames rendered here and streamed to the drums, see stream.cpp
+
+// Load the sequence from LittleFS, if there is one
+void streamBegin();
+
+// Send the next frame when it's due; call every loop while streaming
+void streamPump();
+
+#endif
@@ -0,0 +1,287 @@
+// DrumRadio.h
+#ifndef DRUM_RADIO_H
+#define DRUM_RADIO_H
+
+/*
+ * Radio packet format shared by the Drum Lights transmitter and receivers.
+ *
+ * Every packet fills the nRF24's fixed 32-byte payload. The first byte is
+ * always DRUM_MAGIC, then the packet type, never 0. The original firmware
+ * sent a plain little-endian int mode number, zero-padded, which receivers
+ * still accept. Its modes run from -3 to 199, but its TX sends whatever
+ * number it is given, and one whose low byte is 0xD7, such as 215, also
+ * starts with DRUM_MAGIC; for 0 to 255 the next byte is 0, which tells it
+ * apart (see drumPacketLegacy()). Larger ones, such as 471, are taken for
+ * new packets.
+ *
+ * The last byte is the sending transmitter's leadership term, see
+ * HeartbeatBody. It sits at the end, not in the header, so that bodies of
+ * up to 29 bytes are laid out as they were before it was added.
+ */
+
+#include <stdint.h>
+
+#define DRUM_MAGIC 0xD7
+#define DRUM_PAYLOAD_SIZE 32
+
+enum DrumPacketType : uint8_t
+{
+  PACKET_MODE = 1,        // switch to a new mode
+  PACKET_TEMPO = 2,       // tempo and beat phase, sent periodically
+  PACKET_BULK_START = 3,  // a bulk transfer (e.g. firmware) is starting a pass
+  PACKET_BULK_DATA = 4,   // one chunk of it
+  PACKET_BULK_PARITY = 5, // XOR of a group of chunks, to rebuild one that was lost
+  PACKET_BULK_END = 6,    // end of one pass through the transfer
+  PACKET_PROGRAM = 7,     // part of an effect program for the VM, see DrumVM.h
+  PACKET_STREAM = 8,      // part of a frame rendered by the TX, see DrumStream.h
+  PACKET_PALETTE = 9,     // half of a 16-colour palette
+  PACKET_HEARTBEAT = 10,  // the leading transmitter's state, see HeartbeatBody
+  PACKET_SCENE = 11,      // recall a scene cached on the receivers, see DrumScene.h
+  PACKET_CHANNEL = 12,    // move to another radio channel, see ChannelBody
+  PACKET_STROBE = 13,     // a strobe cued for a moment just ahead, see StrobeBody
+};
+
+// Receivers can relay what they hear to drums out of the TX's range. A
+// relayed copy counts the hops it has made in the top bits of type; the
+// TX always sends 0, so older receivers only ever see the TX's packets
+#define PACKET_TYPE_MASK 0x1F
+#define PACKET_HOPS_SHIFT 5
+#define PACKET_MAX_HOPS 7
+
+// Beat positions are counted in 8.24 fixed point: the top byte is the beat
+// number (wrapping every 256 beats, a whole number of bars) and the low 24
+// bits the phase within the beat
+#define BEAT_FRACTION_BITS 24
+#define BEATS_PER_BAR 4
+
+struct __attribute__((packed)) ModeBody
+{
+  int32_t mode;
+  uint16_t seed; // shared by the band, so random effects match across drums
+};
+
+struct __attribute__((packed)) TempoBody
+{
+  uint16_t bpm;  // beats per minute, 8.8 fixed point
+  uint32_t beat; // beat position when sent, 8.24 fixed point
+};
+
+// Bulk transfers are repeated in several passes ("carousel"), as receivers
+// can't ask for what they missed. Each group of BULK_GROUP_SIZE chunks is
+// followed by a parity chunk, so a receiver missing just one chunk of a
+// group can rebuild it without waiting for the next pass.
+#define BULK_CHUNK_SIZE 24 // a multiple of 4, so chunks can go straight to flash
+#define BULK_GROUP_SIZE 8
+
+enum BulkKind : uint8_t
+{
+  BULK_FIRMWARE = 1, // a new RX firmware image
+  BULK_SCENES = 2,   // the set of scenes, see DrumScene.h
+};
+
+struct __attribute__((packed)) BulkStartBody
+{
+  uint8_t kind;
+  uint16_t transfer; // identifies this transfer across all its passes
+  uint32_t size;     // in bytes
+  uint8_t md5[16];   // of the whole transfer
+};
+
+struct __attribute__((packed)) BulkDataBody
+{
+  uint16_t transfer;
+  uint16_t index; // chunk number, or group number for a parity chunk
+  uint8_t data[BULK_CHUNK_SIZE];
+};
+
+struct __attribute__((packed)) BulkEndBody
+{
+  uint16_t transfer;
+};
+
+// Effect programs are small enough to send in a few packets, each carrying
+// the CRC of the whole program so parts of different versions don't mix
+#define PROGRAM_PART_SIZE 23
+
+struct __attribute__((packed)) ProgramBody
+{
+  uint8_t slot;
+  uint8_t part;
+  uint8_t parts;
+  uint8_t length; // of the whole program, in bytes
+  uint16_t crc;   // of the whole program
+  uint8_t data[PROGRAM_PART_SIZE];
+};
+
+// Streamed frames are split into parts that each decode on their own
+#define STREAM_PART_SIZE 24
+#define STREAM_KEY 0x01  // a keyframe, not a delta on the previous frame
+#define STREAM_LAST 0x02 // the last part of the frame
+
+struct __attribute__((packed)) StreamBody
+{
+  uint8_t group;  // drum type this frame is for, 0 for all
+  uint8_t frame;  // frame number, wrapping
+  uint8_t flags;  // STREAM_KEY, STREAM_LAST
+  uint8_t start;  // first pixel this part covers
+  uint8_t length; // of data, in bytes
+  uint8_t data[STREAM_PART_SIZE];
+};
+
+// Palettes sent over the air are held in slots on the receivers; mode
+// PALETTE_MODE_FIRST + n is fire in the palette in slot n
+#define PALETTE_SLOTS 4
+#define PALETTE_PART_COLOURS 8 // two parts to a palette
+#define PALETTE_MODE_FIRST 55
+
+struct __attribute__((packed)) PaletteBody
+{
+  uint8_t slot;
+  uint8_t part;
+  uint16_t crc; // of the whole palette, all 48 bytes
+  uint8_t rgb[PALETTE_PART_COLOURS * 3];
+};
+
+// A band can run a standby transmitter alongside the primary. Only the
+// leader sends; it sends a heartbeat every HEARTBEAT_MS with enough of its
+// state for the other to carry on where it left off. A transmitter that
+// takes over starts a new term, one more than the last it heard, and stamps
+// it on every packet: receivers drop packets from an older term, so a
+// leader that hasn't yet heard it was replaced can't fight the new one.
+// Terms wrap, and are compared with drumTermCurrent().
+#define HEARTBEAT_MS 100
+
+struct __attribute__((packed)) HeartbeatBody
+{
+  uint8_t priority; // lower is preferred, 0 for the primary
+  uint8_t id;       // distinguishes transmitters of equal priority
+  int32_t mode;
+  uint8_t autoMode; // 1 if cycling through modes by itself
+  uint16_t seed;
+  uint16_t bpm;  // as TempoBody
+  uint32_t beat; // as TempoBody
+};
+
+struct __attribute__((packed)) SceneBody
+{
+  uint8_t scene;
+  uint16_t version; // of the TX's scene set
+  uint16_t seed;    // as ModeBody
+  int32_t fallback; // mode for drums without this version of the set
+};
+
+// Everyone starts on CHANNEL_DEFAULT. The leading TX can move the band to
+// a quieter channel: it counts down to the switch for a while beforehand,
+// so receivers and the standby change together, then repeats the channel
+// in use on CHANNEL_DEFAULT every CHANNEL_BEACON_MS (with a delay of 0) for
+// anyone who missed it or has just started.
+#define CHANNEL_DEFAULT 76 // the nRF24's own default
+#define CHANNEL_COUNT 126
+#define CHANNEL_BEACON_MS 250
+
+struct __attribute__((packed)) ChannelBody
+{
+  uint8_t channel;
+  uint16_t delay; // mS until the switch, 0 for at once
+};
+
+// Strobes fire at a moment cued a little ahead, so the whole band flashes
+// together however late each drum reads its copy of the command. Drums
+// have no shared clock, so each copy gives the time left when it was sent.
+enum StrobePattern : uint8_t
+{
+  STROBE_FLASH = 0, // one white flash, then back to the mode (mode 98)
+  STROBE_999 = 1,   // the 999 flashes, repeating (mode 199)
+};
+
+struct __attribute__((packed)) StrobeBody
+{
+  uint16_t cue; // tells copies of one strobe from the next
+  uint8_t pattern;
+  uint32_t delay; // uS from sending this copy to the first flash
+  uint32_t width; // uS each flash is held
+};
+
+struct __attribute__((packed)) DrumPacket
+{
+  uint8_t magic;
+  uint8_t type;
+  union
+  {
+    ModeBody mode;
+    TempoBody tempo;
+    BulkStartBody bulkStart;
+    BulkDataBody bulkData;
+    BulkEndBody bulkEnd;
+    ProgramBody program;
+    StreamBody stream;
+    PaletteBody palette;
+    HeartbeatBody heartbeat;
+    SceneBody scene;
+    ChannelBody channel;
+    StrobeBody strobe;
+    uint8_t raw[DRUM_PAYLOAD_SIZE - 3];
+  };
+  uint8_t term; // of the transmitter that sent it
+};
+
+static_assert(sizeof(DrumPacket) == DRUM_PAYLOAD_SIZE, "DrumPacket must fill one nRF24 payload");
+
+inline void drumPacketInit(DrumPacket &packet, DrumPacketType type)
+{
+  for (uint8_t i = 0; i < sizeof(packet.raw); i++)
+    packet.raw[i] = 0;
+  packet.magic = DRUM_MAGIC;
+  packet.type = type;
+  packet.term = 0; // set by the transmitter as it sends
+}
+
+// Relaying drums spot copies of a command by its contents (see flood.cpp),
+// so the TX numbers each mode and scene command in the last byte of the
+// body, which they leave spare, the same on each retransmission. Sending
+// mode 11, 12 and 11 again within a second then gives three commands, not
+// a copy of the first. Older receivers ignore the byte
+inline void drumPacketNumber(DrumPacket &packet, uint8_t number)
+{
+  packet.raw[sizeof(packet.raw) - 1] = number;
+}
+
+static_assert(sizeof(ModeBody) < sizeof(DrumPacket::raw) && sizeof(SceneBody) < sizeof(DrumPacket::raw),
+              "mode and scene bodies must leave the last byte for drumPacketNumber()");
+
+// Sent by an original transmitter, as just a mode number?
+inline bool drumPacketLegacy(const DrumPacket &packet)
+{
+  return packet.magic != DRUM_MAGIC || packet.type == 0;
+}
+
+inline uint8_t drumPacketType(const DrumPacket &packet)
+{
+  return packet.type & PACKET_TYPE_MASK;
+}
+
+inline uint8_t drumPacketHops(const DrumPacket &packet)
+{
+  return packet.type >> PACKET_HOPS_SHIFT;
+}
+
+// True if term is no older than current, allowing for wrapping
+inline bool drumTermCurrent(uint8_t term, uint8_t current)
+{
+  return (int8_t)(term - current) >= 0;
+}
+
+// CRC-16/CCITT-FALSE, for checking data reassembled from several packets;
+// pass the previous result as crc to continue over more data
+inline uint16_t drumCrc16(const uint8_t *data, uint16_t length, uint16_t crc = 0xFFFF)
+{
+  while (length--)
+  {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,79 @@
+// DrumScene.h
+#ifndef DRUM_SCENE_H
+#define DRUM_SCENE_H
+
+/*
+ * Scenes: a mode for each drum type, with the palette and effect program
+ * they need, stored on the receivers ahead of a show so that one small
+ * PACKET_SCENE recalls any of them within a frame, however much it holds.
+ *
+ * The TX sends the whole set as a bulk transfer of kind BULK_SCENES: a
+ * SceneSetHeader followed by count Scenes. The header's version is the CRC
+ * of the scenes, and every recall carries the version the TX has, so a
+ * drum holding a different set knows its cache is stale; it shows the
+ * recall's fallback mode until the TX next sends the set. SCENE_FORMAT
+ * changes whenever Scene does, and receivers ignore sets in other formats.
+ *
+ * Header-only and Arduino-free.
+ */
+
+#include <stdint.h>
+
+#include "DrumRadio.h"
+
+#define SCENE_MAGIC 0x53 // 'S'
+#define SCENE_FORMAT 1
+#define SCENE_MAX 16
+#define SCENE_NAME_SIZE 12
+#define SCENE_GROUPS 4         // drum types a scene can give a mode of their own
+#define SCENE_PROGRAM_SIZE 48  // bytes, i.e. 16 instructions
+#define SCENE_MODE_FIRST 300   // on the TX, mode 300 + n recalls scene n
+
+#define SCENE_PALETTE 0x01 // flags: the scene loads a palette into paletteSlot
+#define SCENE_PROGRAM 0x02 // and a VM program into programSlot
+
+struct __attribute__((packed)) SceneSetHeader
+{
+  uint8_t magic;
+  uint8_t format;
+  uint8_t count;
+  uint8_t reserved;
+  uint16_t version; // CRC of the scenes that follow
+};
+
+struct __attribute__((packed)) SceneGroup
+{
+  uint8_t type; // drum type, as in the receivers' config; 0 if unused
+  int16_t mode;
+};
+
+struct __attribute__((packed)) Scene
+{
+  char name[SCENE_NAME_SIZE]; // for logs; not terminated if it fills the field
+  int16_t mode;               // for drums of any type not in groups
+  SceneGroup groups[SCENE_GROUPS];
+  uint8_t flags;
+  uint8_t paletteSlot;
+  uint8_t programSlot;
+  uint8_t programLength;
+  uint8_t palette[16 * 3];
+  uint8_t program[SCENE_PROGRAM_SIZE];
+};
+
+inline uint16_t sceneSetVersion(const Scene *scenes, uint8_t count)
+{
+  return drumCrc16((const uint8_t *)scenes, count * sizeof(Scene));
+}
+
+// The mode a scene shows on a drum of the given type
+inline int16_t sceneMode(const Scene &scene, uint8_t drumType)
+{
+  for (uint8_t g = 0; g < SCENE_GROUPS; g++)
+  {
+    if (scene.groups[g].type != 0 && scene.groups[g].type == drumType)
+      return scene.groups[g].mode;
+  }
+  return scene.mode;
+}
+
+#endif
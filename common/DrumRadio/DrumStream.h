@@ -0,0 +1,171 @@
+// DrumStream.h
+#ifndef DRUM_STREAM_H
+#define DRUM_STREAM_H
+
+/*
+ * Codec for frames rendered on the TX and streamed to the drums.
+ *
+ * A frame is STREAM_PIXELS palette indices round the drum, each receiver
+ * mapping its own pixels onto them by angle. Frames are encoded as a list of
+ * one-byte ops, the top two bits the op and the low six the count less one:
+ *
+ *   STREAM_SKIP n     n pixels unchanged from the previous frame
+ *   STREAM_RUN n, c   n pixels of colour c
+ *   STREAM_LITERAL n  n colours follow, two to a byte, high nibble first
+ *
+ * Keyframes use no skips. An encoded frame is split across packets so that
+ * each part decodes on its own, starting at the pixel it says: a lost part
+ * only leaves its own pixels showing the previous frame.
+ *
+ * Header-only and Arduino-free, so tools/stream_codec.cpp can build it.
+ */
+
+#include <stdint.h>
+
+#define STREAM_PIXELS 64
+#define STREAM_COLOURS 16
+#define STREAM_KEY_INTERVAL 8 // every 8th frame is a keyframe
+#define STREAM_MODE 95        // mode showing the stream
+
+#define STREAM_SKIP 0x00
+#define STREAM_RUN 0x40
+#define STREAM_LITERAL 0x80
+#define STREAM_OP_MASK 0xC0
+#define STREAM_MAX_COUNT 64
+
+#define STREAM_MIN_RUN 3 // shorter runs are cheaper as literals
+
+// The colours an index can be, as 0xRRGGBB
+static const uint32_t streamPalette[STREAM_COLOURS] = {
+    0x000000, // 0 black
+    0xFFFFFF, // 1 white
+    0xFF0000, // 2 red
+    0xFF4500, // 3 orange red
+    0xFF8C00, // 4 dark orange
+    0xFFD700, // 5 gold
+    0x00FF00, // 6 green
+    0x008000, // 7 dark green
+    0x00FFFF, // 8 cyan
+    0x0000FF, // 9 blue
+    0x00008B, // 10 dark blue
+    0x4B0082, // 11 indigo
+    0xFF00FF, // 12 magenta
+    0xFF1493, // 13 deep pink
+    0x404040, // 14 grey
+    0x800000, // 15 maroon
+};
+
+inline uint8_t streamRunLength(const uint8_t *frame, uint8_t pixel)
+{
+  uint8_t n = 1;
+  while (pixel + n < STREAM_PIXELS && n < STREAM_MAX_COUNT && frame[pixel + n] == frame[pixel])
+    n++;
+  return n;
+}
+
+inline uint8_t streamSkipLength(const uint8_t *frame, const uint8_t *previous, uint8_t pixel)
+{
+  uint8_t n = 0;
+  while (previous && pixel + n < STREAM_PIXELS && n < STREAM_MAX_COUNT && frame[pixel + n] == previous[pixel + n])
+    n++;
+  return n;
+}
+
+// Encode frame from pixel on, against previous (nullptr for a keyframe),
+// into at most capacity bytes of out. Returns the bytes used and moves pixel
+// on to the first pixel not covered, STREAM_PIXELS once the frame is done.
+inline uint8_t streamEncode(const uint8_t *frame, const uint8_t *previous, uint8_t &pixel, uint8_t *out, uint8_t capacity)
+{
+  uint8_t used = 0;
+  while (pixel < STREAM_PIXELS && used < capacity)
+  {
+    uint8_t skip = streamSkipLength(frame, previous, pixel);
+    if (skip > 0)
+    {
+      if (pixel + skip == STREAM_PIXELS)
+      {
+        pixel = STREAM_PIXELS; // unchanged to the end; nothing to send
+        break;
+      }
+      out[used++] = STREAM_SKIP | (skip - 1);
+      pixel += skip;
+      continue;
+    }
+
+    uint8_t run = streamRunLength(frame, pixel);
+    if (run >= STREAM_MIN_RUN)
+    {
+      if (used + 2 > capacity)
+        break;
+      out[used++] = STREAM_RUN | (run - 1);
+      out[used++] = frame[pixel];
+      pixel += run;
+      continue;
+    }
+
+    // a literal, until something cheaper starts or it fills the packet
+    uint8_t n = 0;
+    while (pixel + n < STREAM_PIXELS && n < STREAM_MAX_COUNT && used + 1 + (n + 2) / 2 <= capacity)
+    {
+      if (n > 0 && (streamSkipLength(frame, previous, pixel + n) >= 2 || streamRunLength(frame, pixel + n) >= STREAM_MIN_RUN))
+        break;
+      n++;
+    }
+    if (n == 0)
+      break;
+
+    out[used++] = STREAM_LITERAL | (n - 1);
+    for (uint8_t i = 0; i < n; i += 2)
+    {
+      uint8_t high = frame[pixel + i] & 0x0F;
+      uint8_t low = i + 1 < n ? frame[pixel + i + 1] & 0x0F : 0;
+      out[used++] = (high << 4) | low;
+    }
+    pixel += n;
+  }
+  return used;
+}
+
+// Apply one encoded part to frame, starting at pixel start. False if it is
+// malformed, in which case frame may be partly updated.
+inline bool streamDecode(uint8_t *frame, uint8_t start, const uint8_t *data, uint8_t length)
+{
+  uint16_t pixel = start;
+  uint8_t at = 0;
+  while (at < length)
+  {
+    uint8_t op = data[at] & STREAM_OP_MASK;
+    uint8_t n = (data[at++] & ~STREAM_OP_MASK) + 1;
+    if (pixel + n > STREAM_PIXELS)
+      return false;
+
+    switch (op)
+    {
+    case STREAM_SKIP:
+      break;
+
+    case STREAM_RUN:
+      if (at >= length)
+        return false;
+      for (uint8_t i = 0; i < n; i++)
+        frame[pixel + i] = data[at] & 0x0F;
+      at++;
+      break;
+
+    case STREAM_LITERAL:
+      if (at + (n + 1) / 2 > length)
+        return false;
+      for (uint8_t i = 0; i < n; i++)
+        frame[pixel + i] = i & 1 ? data[at + i / 2] & 0x0F : data[at + i / 2] >> 4;
+      at += (n + 1) / 2;
+      break;
+
+    default:
+      return false;
+    }
+    pixel += n;
+  }
+  return true;
+}
+
+#endif
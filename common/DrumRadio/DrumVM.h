@@ -0,0 +1,95 @@
+// DrumVM.h
+#ifndef DRUM_VM_H
+#define DRUM_VM_H
+
+/*
+ * Instruction set for the receivers' effect bytecode VM.
+ *
+ * A program runs once per pixel per frame and finishes by writing that
+ * pixel's colour (VM_RGB, VM_HSV, VM_PAL, VM_FADE) or leaving it alone
+ * (VM_END, or running off the end). Every instruction is three bytes:
+ * opcode, a, b. For the arithmetic ops a is the destination register and
+ * b the source register, or an 8-bit immediate when the opcode is or'd
+ * with VM_IMM. Jump targets are instruction numbers, not byte offsets.
+ */
+
+#include <stdint.h>
+
+#define VM_REGISTERS 8
+#define VM_STACK 8
+#define VM_MAX_PROGRAM 192 // bytes, i.e. 64 instructions
+#define VM_SLOTS 8         // programs cached on each receiver
+#define VM_MODE_FIRST 200  // mode 200 + n runs the program in slot n
+
+#define VM_IMM 0x80
+
+enum VmOp : uint8_t
+{
+  VM_END = 0, // done, leave the pixel as it is
+
+  // r[a] = ...
+  VM_LDI,  // b                 (load immediate)
+  VM_LDH,  // (r[a] << 8) | b   (extend an immediate past 8 bits)
+  VM_IN,   // input b, a VmInput
+  VM_MOV,  // r[b]
+  VM_ADD,  // r[a] + b
+  VM_SUB,  // r[a] - b
+  VM_MUL,  // r[a] * b
+  VM_DIV,  // r[a] / b, or 0 if b is 0
+  VM_MOD,  // r[a] % b, or 0 if b is 0
+  VM_AND,  // r[a] & b
+  VM_OR,   // r[a] | b
+  VM_XOR,  // r[a] ^ b
+  VM_SHL,  // r[a] << b
+  VM_SHR,  // r[a] >> b
+  VM_MIN,  // min(r[a], b)
+  VM_MAX,  // max(r[a], b)
+  VM_LT,   // r[a] < b ? 1 : 0
+  VM_SCALE8, // scale8(r[a], b)
+  VM_SIN8,   // sin8(r[a])
+  VM_NOISE,  // inoise8(r[a], b)
+  VM_RAND,   // random8()
+
+  // flow
+  VM_JMP,  // to instruction a
+  VM_JZ,   // to instruction b if r[a] == 0
+  VM_JNZ,  // to instruction b if r[a] != 0
+  VM_PUSH, // r[a] onto the stack
+  VM_POP,  // r[a] off the stack
+
+  // set the pixel and finish
+  VM_RGB,  // CRGB(r[a], r[a+1], r[a+2])
+  VM_HSV,  // CHSV(r[a], r[a+1], r[a+2])
+  VM_PAL,  // ColorFromPalette(palette b, r[a])
+  VM_FADE, // keep the pixel, scaled by r[a]/256
+
+  VM_OP_COUNT
+};
+
+enum VmInput : uint8_t
+{
+  VM_IN_PIXEL = 0, // index of this pixel
+  VM_IN_COUNT,     // number of pixels
+  VM_IN_MILLIS,    // time in mS
+  VM_IN_BEAT,      // 0-255 through the current beat
+  VM_IN_BAR,       // 0-65535 through the current bar
+  VM_IN_FRAME,     // frames since the mode started
+  VM_IN_ANGLE,     // 0-255 round the shell, 0 facing the audience
+  VM_IN_BAND,      // 0-255 across the band, from the audience's left
+
+  VM_INPUT_COUNT
+};
+
+enum VmPalette : uint8_t
+{
+  VM_PAL_RAINBOW = 0,
+  VM_PAL_PARTY,
+  VM_PAL_HEAT,
+  VM_PAL_OCEAN,
+  VM_PAL_FOREST,
+  VM_PAL_LAVA,
+
+  VM_PALETTE_COUNT
+};
+
+#endif
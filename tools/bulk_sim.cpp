@@ -0,0 +1,249 @@
+/* Bulk transfer carousel simulator
+ *
+ * Sends a firmware image the way TX/src/bulk.cpp does, to a band of drums
+ * each losing packets on its own, and has each drum keep chunks as
+ * RX/src/bulk.cpp does: a drum starts on the first start packet it hears,
+ * keeps every chunk it is missing, and rebuilds a chunk from its group's
+ * XOR parity when that is the only one of the group it lacks. Losses are
+ * either independent, or in bursts averaging BURST_PACKETS packets, as when
+ * a drum's own LEDs flash or a drummer turns away.
+ *
+ * For each loss rate this prints the share of drums with the whole image
+ * after each of the TX's passes, the time until every drum has it (the
+ * fleet update time), and how many passes that would take if the TX kept
+ * going, with parity chunks and without. A 360KB image is 15000 chunks, so
+ * with any loss at all hardly a drum has it all after one pass. With
+ * parity, the three passes the TX sends get every drum updated in about
+ * 50-60s at up to 2% independent loss; without, some drums need a fourth.
+ * At 5% and above, or with the losses in bursts, which parity can't mend,
+ * some drums are still short after three passes, and have to be sent the
+ * update again.
+ *
+ *   g++ -O2 -Wall -Wextra -I common/DrumRadio tools/bulk_sim.cpp -o bulk_sim
+ *   ./bulk_sim [image bytes] [drums] [trials]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "DrumRadio.h"
+
+#define BULK_PASSES 3 // as the TX sends
+#define MAX_PASSES 12  // to see how many it would take
+#define BULK_PACKET_US 1000
+#define BULK_ERASE_MS_PER_SECTOR 50
+#define BURST_PACKETS 6
+
+// What the TX sends, and when
+enum Kind
+{
+  START,
+  DATA,
+  PARITY,
+};
+
+struct Packet
+{
+  Kind kind;
+  uint8_t pass;
+  uint32_t index; // chunk, or group for parity
+  double ms;
+};
+
+static std::vector<Packet> carousel(uint32_t size, bool parity)
+{
+  std::vector<Packet> packets;
+  uint32_t chunks = (size + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE;
+  double ms = 0;
+  for (uint8_t pass = 0; pass < MAX_PASSES; pass++)
+  {
+    packets.push_back({START, pass, 0, ms});
+    ms += ((size + 4095) / 4096) * BULK_ERASE_MS_PER_SECTOR;
+    for (uint32_t chunk = 0; chunk < chunks; chunk++)
+    {
+      packets.push_back({DATA, pass, chunk, ms});
+      ms += BULK_PACKET_US / 1000.0;
+      if (parity && ((chunk + 1) % BULK_GROUP_SIZE == 0 || chunk + 1 == chunks))
+      {
+        packets.push_back({PARITY, pass, chunk / BULK_GROUP_SIZE, ms});
+        ms += BULK_PACKET_US / 1000.0;
+      }
+    }
+    ms += BULK_PACKET_US / 1000.0; // the end packet
+  }
+  return packets;
+}
+
+// A drum's radio: each packet lost with probability loss overall, either
+// independently or in bursts of BURST_PACKETS on average
+struct Channel
+{
+  double loss;
+  bool bursty;
+  bool inBurst = false;
+
+  bool lost()
+  {
+    double r = rand() / (RAND_MAX + 1.0);
+    if (!bursty)
+      return r < loss;
+
+    // two states, staying in a burst with probability 1 - 1/BURST_PACKETS,
+    // and entering one often enough that a share loss of packets are lost
+    double leave = 1.0 / BURST_PACKETS;
+    double enter = leave * loss / (1 - loss);
+    inBurst = inBurst ? r >= leave : r < enter;
+    return inBurst;
+  }
+};
+
+struct Drum
+{
+  Channel channel;
+  bool started = false;
+  std::vector<bool> have;
+  uint32_t count = 0;
+  int donePass = -1;
+  double doneMs = 0;
+
+  void store(uint32_t chunk, const Packet &p)
+  {
+    have[chunk] = true;
+    if (++count == have.size())
+    {
+      donePass = p.pass;
+      doneMs = p.ms;
+    }
+  }
+
+  void hear(const Packet &p)
+  {
+    if (donePass >= 0 || channel.lost())
+      return;
+
+    switch (p.kind)
+    {
+    case START:
+      started = true;
+      break;
+    case DATA:
+      if (started && !have[p.index])
+        store(p.index, p);
+      break;
+    case PARITY:
+    {
+      if (!started)
+        break;
+      uint32_t first = p.index * BULK_GROUP_SIZE;
+      uint32_t last = first + BULK_GROUP_SIZE < have.size() ? first + BULK_GROUP_SIZE : have.size();
+      int missing = -1;
+      for (uint32_t i = first; i < last; i++)
+      {
+        if (!have[i])
+        {
+          if (missing >= 0)
+            return;
+          missing = i;
+        }
+      }
+      if (missing >= 0)
+        store(missing, p);
+      break;
+    }
+    }
+  }
+};
+
+struct Result
+{
+  double afterPass[BULK_PASSES]; // % of drums with the image
+  double fleetMs;                // mean, over trials where every drum got it
+  int fleetTrials;
+  int passes;                    // most needed for every drum, -1 if more than MAX_PASSES
+};
+
+static Result run(uint32_t size, bool parity, double loss, bool bursty, int drumCount, int trials)
+{
+  std::vector<Packet> packets = carousel(size, parity);
+  uint32_t chunks = (size + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE;
+  Result result = {{0}, 0, 0, 0};
+
+  for (int t = 0; t < trials; t++)
+  {
+    std::vector<Drum> drums(drumCount);
+    for (Drum &drum : drums)
+    {
+      drum.channel = {loss, bursty};
+      drum.have.assign(chunks, false);
+    }
+    for (const Packet &p : packets)
+      for (Drum &drum : drums)
+        drum.hear(p);
+
+    double fleet = 0;
+    int passes = 0;
+    bool all = true;
+    for (const Drum &drum : drums)
+    {
+      for (int pass = 0; pass < BULK_PASSES; pass++)
+        if (drum.donePass >= 0 && drum.donePass <= pass)
+          result.afterPass[pass] += 100.0 / (drumCount * trials);
+      if (drum.donePass < 0)
+      {
+        all = false;
+      }
+      else
+      {
+        fleet = drum.doneMs > fleet ? drum.doneMs : fleet;
+        passes = drum.donePass + 1 > passes ? drum.donePass + 1 : passes;
+      }
+    }
+    if (!all)
+      result.passes = -1;
+    else if (result.passes >= 0 && passes > result.passes)
+      result.passes = passes;
+    if (all && passes <= BULK_PASSES)
+    {
+      result.fleetMs += fleet;
+      result.fleetTrials++;
+    }
+  }
+  if (result.fleetTrials)
+    result.fleetMs /= result.fleetTrials;
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t size = argc > 1 ? atoi(argv[1]) : 360000;
+  int drumCount = argc > 2 ? atoi(argv[2]) : 40;
+  int trials = argc > 3 ? atoi(argv[3]) : 5;
+  srand(1);
+
+  double passMs = carousel(size, true).back().ms / MAX_PASSES;
+  printf("%u byte image, %d drums, %d trials; a pass takes %.1fs with parity\n\n", size, drumCount, trials,
+         passMs / 1000);
+  printf("losses       loss  parity  whole image after pass 1/2/3    fleet updated  passes for all\n");
+  for (bool bursty : {false, true})
+  {
+    for (double loss : {0.01, 0.02, 0.05, 0.10, 0.20})
+    {
+      for (bool parity : {true, false})
+      {
+        Result r = run(size, parity, loss, bursty, drumCount, trials);
+        printf("%-11s %4.0f%%  %6s  %8.1f%% %6.1f%% %6.1f%%  ", bursty ? "in bursts" : "independent", loss * 100,
+               parity ? "yes" : "no", r.afterPass[0], r.afterPass[1], r.afterPass[2]);
+        if (r.fleetTrials == trials)
+          printf("%12.1fs", r.fleetMs / 1000);
+        else
+          printf("   not in %d/%d", trials - r.fleetTrials, trials);
+        if (r.passes > 0)
+          printf("  %14d\n", r.passes);
+        else
+          printf("    more than %2d\n", MAX_PASSES);
+      }
+    }
+  }
+  return 0;
+}
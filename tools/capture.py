@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""Frame capture from a Drum Lights receiver.
+
+Records the frames a receiver shows, streamed over Serial by
+RX/src/capture.cpp, then replays them as a ring of LEDs or exports them.
+Recording needs pyserial; --png and --video need Pillow, and --video
+ffmpeg as well. For example
+
+    python3 tools/capture.py --port /dev/ttyUSB0 --save drum3.cap --seconds 30
+    python3 tools/capture.py --file drum3.cap --play
+    python3 tools/capture.py --file drum3.cap --png drum3.png --video drum3.mp4
+
+The PNG is a strip with a row of pixels per frame, time running down. At
+115200 baud the receiver sends what the link can carry, so busy effects on
+big drums arrive as a sample of their frames; the summary says how many.
+"""
+
+import argparse
+import math
+import struct
+import subprocess
+import sys
+import time
+
+MAGIC = b"DC"
+HEADER = struct.Struct("<2sBHHIhHH")
+FPS = 35  # FRAMES_PER_SECOND on the receiver
+
+
+def crc16(data, crc=0xFFFF):
+    # CRC-16/CCITT-FALSE, as drumCrc16() in common/DrumRadio/DrumRadio.h
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+    return crc
+
+
+def record(port, baud, seconds, path):
+    import serial  # pyserial
+
+    data = bytearray()
+    with serial.Serial(port, baud, timeout=0.1) as link:
+        link.reset_input_buffer()
+        link.write(b"C")
+        deadline = time.monotonic() + seconds if seconds else None
+        print("recording; Ctrl-C to stop", file=sys.stderr)
+        try:
+            while deadline is None or time.monotonic() < deadline:
+                data += link.read(4096)
+        except KeyboardInterrupt:
+            pass
+        link.write(b"c")
+        data += link.read(4096)
+    if path:
+        with open(path, "wb") as out:
+            out.write(data)
+    return bytes(data)
+
+
+def decode(data):
+    """The frames in a capture, as (frame, ms, mode, pixels) with pixels a
+    list of (r, g, b), and counts of what was found along the way."""
+    frames = []
+    stats = {"records": 0, "corrupt": 0, "orphans": 0, "bytes": 0}
+    pixels = None
+    last = None  # frame number pixels holds
+    at = 0
+    while True:
+        at = data.find(MAGIC, at)
+        if at < 0 or len(data) - at < HEADER.size:
+            break
+        _, kind, frame, base, ms, mode, leds, length = HEADER.unpack_from(data, at)
+        end = at + HEADER.size + length
+        if kind not in b"KD" or end + 2 > len(data) or \
+                crc16(data[at:end]) != struct.unpack_from("<H", data, end)[0]:
+            # log text, or a record it landed in
+            stats["corrupt"] += data[at + 2:at + 3] in (b"K", b"D")
+            at += 1
+            continue
+        stats["records"] += 1
+        stats["bytes"] += end + 2 - at
+        body = data[at + HEADER.size:end]
+        at = end + 2
+
+        if kind == ord("K"):
+            pixels = [tuple(body[i:i + 3]) for i in range(0, leds * 3, 3)]
+        elif pixels is not None and base == last and len(pixels) == leds:
+            pixels = list(pixels)
+            i = 0
+            j = 0
+            while j + 2 <= len(body):
+                skip, count = body[j], body[j + 1]
+                j += 2
+                i += skip
+                for _ in range(count):
+                    pixels[i] = tuple(body[j:j + 3])
+                    i += 1
+                    j += 3
+        else:
+            # its base was lost or skipped; wait for the next whole frame
+            stats["orphans"] += 1
+            pixels = None
+            continue
+        last = frame
+        frames.append((frame, ms, mode, pixels))
+    return frames, stats
+
+
+def summarise(frames, stats):
+    if not frames:
+        sys.exit("no frames found; was capture running on the receiver?")
+    first, last = frames[0], frames[-1]
+    rendered = (last[0] - first[0]) % 65536 + 1
+    seconds = (last[1] - first[1]) / 1000
+    print("%d LEDs, %.1f s, %d frames of %d rendered (%.0f%%), %.0f bytes a frame" %
+          (len(last[3]), seconds, len(frames), rendered, 100 * len(frames) / rendered,
+           stats["bytes"] / stats["records"]))
+    if stats["corrupt"] or stats["orphans"]:
+        print("%d records corrupt, %d frames lost with them" % (stats["corrupt"], stats["orphans"]))
+    modes = []
+    for _, ms, mode, _ in frames:
+        if not modes or modes[-1][1] != mode:
+            modes.append((ms, mode))
+    for ms, mode in modes:
+        print("  %8.2f s  mode %d" % ((ms - first[1]) / 1000, mode))
+
+
+def at_rate(frames, fps=FPS):
+    """The frames resampled to a steady rate, holding each until the next,
+    as a receiver's strip does."""
+    start = frames[0][1]
+    n = 0
+    for i, current in enumerate(frames):
+        until = frames[i + 1][1] if i + 1 < len(frames) else current[1] + 1000 / fps
+        while start + n * 1000 / fps < until:
+            yield current
+            n += 1
+
+
+def ring_points(leds, size):
+    # the first LED at the top, going clockwise
+    radius = size * 0.42
+    centre = size / 2
+    return [(centre + radius * math.sin(2 * math.pi * i / leds),
+             centre - radius * math.cos(2 * math.pi * i / leds)) for i in range(leds)]
+
+
+def ring_image(pixels, size):
+    from PIL import Image, ImageDraw
+
+    image = Image.new("RGB", (size, size))
+    draw = ImageDraw.Draw(image)
+    dot = max(2, size * 1.2 / len(pixels))
+    for (x, y), colour in zip(ring_points(len(pixels), size), pixels):
+        draw.ellipse((x - dot, y - dot, x + dot, y + dot), fill=colour)
+    return image
+
+
+def save_png(frames, path, scale):
+    from PIL import Image
+
+    leds = len(frames[-1][3])
+    strip = Image.new("RGB", (leds, len(frames)))
+    strip.putdata([pixel for _, _, _, pixels in frames for pixel in (pixels + [(0, 0, 0)] * leds)[:leds]])
+    strip.resize((leds * scale, len(frames) * scale), Image.NEAREST).save(path)
+
+
+def save_video(frames, path, size):
+    ffmpeg = subprocess.Popen(["ffmpeg", "-loglevel", "error", "-y", "-f", "rawvideo", "-pix_fmt", "rgb24",
+                               "-s", "%dx%d" % (size, size), "-r", str(FPS), "-i", "-",
+                               "-pix_fmt", "yuv420p", path], stdin=subprocess.PIPE)
+    for _, _, _, pixels in at_rate(frames):
+        ffmpeg.stdin.write(ring_image(pixels, size).tobytes())
+    ffmpeg.stdin.close()
+    if ffmpeg.wait():
+        sys.exit("ffmpeg failed")
+
+
+def play(frames, size):
+    import tkinter
+
+    window = tkinter.Tk()
+    window.title("Drum Lights capture")
+    canvas = tkinter.Canvas(window, width=size, height=size, background="black")
+    canvas.pack()
+    status = tkinter.Label(window)
+    status.pack()
+
+    leds = len(frames[-1][3])
+    dot = max(2, size * 1.2 / leds)
+    dots = [canvas.create_oval(x - dot, y - dot, x + dot, y + dot, outline="")
+            for x, y in ring_points(leds, size)]
+    steady = list(at_rate(frames))
+    start = frames[0][1]
+
+    def show(n):
+        _, ms, mode, pixels = steady[n]
+        for item, colour in zip(dots, pixels):
+            canvas.itemconfig(item, fill="#%02x%02x%02x" % colour)
+        status.config(text="%.2f s  mode %d" % ((ms - start) / 1000, mode))
+        window.after(1000 // FPS, show, (n + 1) % len(steady))
+
+    show(0)
+    window.mainloop()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port the receiver is on")
+    source.add_argument("--file", help="replay a capture saved earlier with --save")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--seconds", type=float, help="how long to record; until Ctrl-C if not given")
+    parser.add_argument("--save", help="also write the raw capture here")
+    parser.add_argument("--play", action="store_true", help="replay the frames as a ring")
+    parser.add_argument("--png", help="write the frames as a strip, a row per frame")
+    parser.add_argument("--scale", type=int, default=4, help="pixels per LED in the PNG strip")
+    parser.add_argument("--video", help="write the frames as a ring to this video file")
+    parser.add_argument("--size", type=int, default=480, help="size of the ring, in pixels")
+    args = parser.parse_args()
+
+    if args.port:
+        data = record(args.port, args.baud, args.seconds, args.save)
+    else:
+        with open(args.file, "rb") as f:
+            data = f.read()
+
+    frames, stats = decode(data)
+    summarise(frames, stats)
+    if args.png:
+        save_png(frames, args.png, args.scale)
+    if args.video:
+        save_video(frames, args.video, args.size)
+    if args.play:
+        play(frames, args.size)
+
+
+if __name__ == "__main__":
+    main()
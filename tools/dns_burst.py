@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Captive-portal join benchmark for the Drum Lights transmitter.
+
+Stands in for a crowd of phones joining the TX access point: each simulated
+client fires the burst of connectivity-check lookups a real handset makes,
+and the script reports how long it took until every client had all of its
+answers (i.e. could go on to request the portal page).
+
+Run it from a laptop joined to the TX network, once against the old
+firmware and once against the new, e.g.
+
+    python3 tools/dns_burst.py --clients 20
+"""
+
+import argparse
+import random
+import socket
+import struct
+import time
+
+# Lookups made by Android, iOS, Windows and Firefox when joining a network
+CHECK_NAMES = [
+    "connectivitycheck.gstatic.com",
+    "clients3.google.com",
+    "www.google.com",
+    "captive.apple.com",
+    "www.apple.com",
+    "www.msftconnecttest.com",
+    "dns.msftncsi.com",
+    "detectportal.firefox.com",
+]
+
+
+def build_query(txid, name, qtype=1):
+    header = struct.pack(">HHHHHH", txid, 0x0100, 1, 0, 0, 0)
+    qname = b"".join(bytes([len(p)]) + p.encode() for p in name.split(".")) + b"\0"
+    return header + qname + struct.pack(">HH", qtype, 1)
+
+
+def run(server, port, clients, timeout):
+    socks = []
+    pending = {}
+    start = time.monotonic()
+
+    for c in range(clients):
+        s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        s.setblocking(False)
+        socks.append(s)
+        for name in CHECK_NAMES:
+            for qtype in (1, 28):  # A and AAAA, as phones ask for both
+                txid = random.randrange(0x10000)
+                pending[(c, txid)] = time.monotonic()
+                s.sendto(build_query(txid, name, qtype), (server, port))
+
+    done = [None] * clients
+    latencies = []
+    deadline = start + timeout
+    while pending and time.monotonic() < deadline:
+        for c, s in enumerate(socks):
+            try:
+                data, _ = s.recvfrom(512)
+            except BlockingIOError:
+                continue
+            txid = struct.unpack(">H", data[:2])[0]
+            sent = pending.pop((c, txid), None)
+            if sent is None:
+                continue
+            now = time.monotonic()
+            latencies.append(now - sent)
+            if not any(k[0] == c for k in pending):
+                done[c] = now - start
+        time.sleep(0.0005)
+
+    for s in socks:
+        s.close()
+
+    joined = [d for d in done if d is not None]
+    total = clients * len(CHECK_NAMES) * 2
+    print(f"queries answered: {len(latencies)}/{total}")
+    if latencies:
+        latencies.sort()
+        print(f"query latency ms: median {latencies[len(latencies) // 2] * 1000:.1f}"
+              f", p95 {latencies[int(len(latencies) * 0.95)] * 1000:.1f}"
+              f", max {latencies[-1] * 1000:.1f}")
+    if joined:
+        print(f"clients joined: {len(joined)}/{clients}, last after {max(joined) * 1000:.0f} ms")
+    else:
+        print(f"clients joined: 0/{clients}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--server", default="192.168.4.1")
+    parser.add_argument("--port", type=int, default=53)
+    parser.add_argument("--clients", type=int, default=10)
+    parser.add_argument("--timeout", type=float, default=10.0)
+    args = parser.parse_args()
+    run(args.server, args.port, args.clients, args.timeout)
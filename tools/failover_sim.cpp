@@ -0,0 +1,222 @@
+/* Transmitter failover simulator
+ *
+ * Runs two transmitters' Election (TX/src/election.cpp), a primary and a
+ * standby, over a simulated lossy radio channel, one millisecond at a time,
+ * with a receiver applying the RX's term rule (fromLeader() in
+ * RX/src/main.cpp). The leader sends a heartbeat every HEARTBEAT_MS and a
+ * tempo packet every second, as the TX does.
+ *
+ * Each trial boots both, lets them settle, then kills the leader and times
+ * how long until the standby takes over and until the receiver obeys it.
+ * The killed transmitter then reboots, and shouldn't take the lead back. A
+ * long run with both alive counts spurious takeovers caused by loss alone;
+ * they're harmless, as the two share their state, but shouldn't be common.
+ * Exits 1 if the receiver takes longer than the limit to follow the new
+ * leader, or is left following a deposed one.
+ *
+ *   g++ -O2 -I common/DrumRadio -I TX/src tools/failover_sim.cpp TX/src/election.cpp -o failover_sim
+ *   ./failover_sim [loss_percent] [trials] [limit_ms]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "DrumRadio.h"
+#include "election.h"
+
+#define TEMPO_INTERVAL 1000
+#define RX_LEADER_TIMEOUT 2000
+#define SETTLE_MS 3000
+#define TRIAL_MS 10000
+#define SOAK_HOURS 2
+
+static int lossPercent = 10;
+
+static bool lost()
+{
+  return rand() % 100 < lossPercent;
+}
+
+struct Receiver
+{
+  uint8_t term = 0;
+  unsigned long heard = 0;
+  bool started = false;
+
+  bool accept(uint8_t packetTerm, unsigned long now)
+  {
+    if (started && !drumTermCurrent(packetTerm, term) && now - heard < RX_LEADER_TIMEOUT)
+      return false;
+    term = packetTerm;
+    heard = now;
+    started = true;
+    return true;
+  }
+};
+
+struct Transmitter
+{
+  Election election;
+  bool alive = true;
+  unsigned long lastTempo = 0;
+  int takeovers = 0;
+
+  Transmitter(uint8_t priority, uint8_t id) : election(priority, id) {}
+
+  void boot(unsigned long now)
+  {
+    election = Election(election.priority, election.id);
+    election.begin(now);
+    alive = true;
+  }
+};
+
+// One millisecond: each transmitter decides, then whatever the leaders send
+// reaches the others unless lost
+static void step(Transmitter *tx, int count, Receiver &rx, unsigned long now)
+{
+  for (int t = 0; t < count; t++)
+  {
+    if (!tx[t].alive)
+      continue;
+    if (tx[t].election.update(now))
+      tx[t].takeovers++;
+  }
+
+  for (int t = 0; t < count; t++)
+  {
+    Election &from = tx[t].election;
+    if (!tx[t].alive || !from.leading)
+      continue;
+
+    bool heartbeat = from.heartbeatDue(now);
+    bool tempo = now - tx[t].lastTempo >= TEMPO_INTERVAL;
+    if (tempo)
+      tx[t].lastTempo = now;
+    if (!heartbeat && !tempo)
+      continue;
+
+    for (int o = 0; o < count; o++)
+    {
+      if (o == t || !tx[o].alive || lost())
+        continue;
+      if (heartbeat)
+        tx[o].election.heard(from.term, from.priority, from.id, now);
+      else
+        tx[o].election.heard(from.term, now);
+    }
+    if (!lost())
+      rx.accept(from.term, now);
+  }
+}
+
+static int leaderOf(Transmitter *tx, int count)
+{
+  int leader = -1;
+  for (int t = 0; t < count; t++)
+    if (tx[t].alive && tx[t].election.leading)
+      leader = leader < 0 ? t : -2; // -2: more than one
+  return leader;
+}
+
+int main(int argc, char **argv)
+{
+  lossPercent = argc > 1 ? atoi(argv[1]) : 10;
+  int trials = argc > 2 ? atoi(argv[2]) : 200;
+  unsigned long limit = argc > 3 ? atol(argv[3]) : 1000;
+  srand(1);
+
+  printf("loss %d%%, heartbeat %d ms, failover after %d ms (+%d ms per priority step)\n", lossPercent, HEARTBEAT_MS,
+         FAILOVER_MS, PRIORITY_STAGGER_MS);
+
+  unsigned long takeoverWorst = 0, takeoverTotal = 0, rxWorst = 0, rxTotal = 0;
+  int takenBack = 0, failures = 0;
+
+  for (int trial = 0; trial < trials; trial++)
+  {
+    Transmitter tx[2] = {Transmitter(0, 0x11), Transmitter(1, 0x22)};
+    Receiver rx;
+    unsigned long now = 0;
+
+    // the standby usually boots a little after the primary
+    unsigned long standbyBoot = rand() % 2000;
+    tx[0].boot(0);
+    tx[1].alive = false;
+    for (; now < SETTLE_MS; now++)
+    {
+      if (now == standbyBoot)
+        tx[1].boot(now);
+      step(tx, 2, rx, now);
+    }
+
+    int leader = leaderOf(tx, 2);
+    if (leader < 0)
+    {
+      printf("trial %d: no single leader after settling\n", trial);
+      failures++;
+      continue;
+    }
+
+    // kill the leader, at a random point between heartbeats
+    for (unsigned long end = now + rand() % HEARTBEAT_MS; now < end; now++)
+      step(tx, 2, rx, now);
+    unsigned long killed = now;
+    uint8_t oldTerm = tx[leader].election.term;
+    tx[leader].alive = false;
+    int standby = 1 - leader;
+
+    unsigned long tookOver = 0, rxFollowed = 0;
+    for (; now < killed + TRIAL_MS && !rxFollowed; now++)
+    {
+      step(tx, 2, rx, now);
+      if (!tookOver && tx[standby].election.leading)
+        tookOver = now;
+      if (tookOver && rx.term != oldTerm)
+        rxFollowed = now;
+    }
+    if (!tookOver || !rxFollowed)
+    {
+      printf("trial %d: standby never took over\n", trial);
+      failures++;
+      continue;
+    }
+
+    unsigned long takeover = tookOver - killed, followed = rxFollowed - killed;
+    takeoverTotal += takeover;
+    rxTotal += followed;
+    takeoverWorst = takeover > takeoverWorst ? takeover : takeoverWorst;
+    rxWorst = followed > rxWorst ? followed : rxWorst;
+    if (followed > limit)
+      failures++;
+
+    // the old leader comes back and should stand by
+    tx[leader].boot(now);
+    for (unsigned long end = now + TRIAL_MS; now < end; now++)
+      step(tx, 2, rx, now);
+    if (leaderOf(tx, 2) != standby)
+      takenBack++; // only by a loss burst, as in the long run below
+    if (rx.term != tx[standby].election.term)
+    {
+      printf("trial %d: receiver left following term %u\n", trial, rx.term);
+      failures++;
+    }
+  }
+
+  printf("takeover:       mean %4lu ms, worst %4lu ms\n", takeoverTotal / trials, takeoverWorst);
+  printf("receiver moved: mean %4lu ms, worst %4lu ms (limit %lu ms)\n", rxTotal / trials, rxWorst, limit);
+  printf("lead taken back by a rebooted transmitter: %d of %d trials\n", takenBack, trials);
+
+  // both alive for a long time: any takeover is caused by loss alone
+  Transmitter tx[2] = {Transmitter(0, 0x11), Transmitter(1, 0x22)};
+  Receiver rx;
+  tx[0].boot(0);
+  tx[1].boot(0);
+  for (unsigned long now = 0; now < SOAK_HOURS * 3600000UL; now++)
+    step(tx, 2, rx, now);
+  int spurious = tx[0].takeovers + tx[1].takeovers - 1;
+  printf("spurious takeovers in %d hours with both running: %d\n", SOAK_HOURS, spurious);
+
+  if (failures)
+    printf("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+/* Drum-hit onset detector tuning bench
+ *
+ * Runs the receiver's OnsetDetector (RX/src/onset.cpp) over a WAV recording
+ * of surdo/caixa hits, sampling it the way the receiver samples its ADC: a
+ * burst of 16 readings ~100us apart at the start of every 35 fps frame.
+ * Prints each detected onset and the per-frame cost, and fails if the
+ * detector's mean cost exceeds the CPU budget. That is the detector alone:
+ * on the drum the 16 analogRead() calls cost far more, about 1.5ms a frame,
+ * and are bounded in RX/src/audio.cpp and timed by the receiver's profiler
+ * (its audio section, see tools/profile_dump.py).
+ *
+ *   g++ -O2 -I RX/src tools/onset_wav.cpp RX/src/onset.cpp -o onset_wav
+ *   ./onset_wav surdo.wav [sensitivity] [budget_ns]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "onset.h"
+
+#define FRAMES_PER_SECOND 35
+#define AUDIO_SAMPLES 16
+#define ADC_INTERVAL_US 100
+
+static bool readWav(const char *path, std::vector<int16_t> &samples, uint32_t &rate)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  char riff[12];
+  if (fread(riff, 1, 12, f) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4))
+  {
+    fclose(f);
+    return false;
+  }
+
+  uint16_t channels = 0, bits = 0;
+  char id[4];
+  uint32_t size;
+  while (fread(id, 1, 4, f) == 4 && fread(&size, 4, 1, f) == 1)
+  {
+    if (!memcmp(id, "fmt ", 4))
+    {
+      uint8_t fmt[16];
+      if (size < 16 || fread(fmt, 1, 16, f) != 16)
+        break;
+      memcpy(&channels, fmt + 2, 2);
+      memcpy(&rate, fmt + 4, 4);
+      memcpy(&bits, fmt + 14, 2);
+      fseek(f, size - 16, SEEK_CUR);
+    }
+    else if (!memcmp(id, "data", 4))
+    {
+      if (bits != 16 || channels == 0)
+        break;
+      std::vector<int16_t> raw(size / 2);
+      size_t got = fread(raw.data(), 2, raw.size(), f);
+      for (size_t i = 0; i + channels <= got; i += channels)
+        samples.push_back(raw[i]); // first channel only
+      fclose(f);
+      return true;
+    }
+    else
+    {
+      fseek(f, size + (size & 1), SEEK_CUR);
+    }
+  }
+
+  fclose(f);
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s file.wav [sensitivity] [budget_ns]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<int16_t> wav;
+  uint32_t rate = 0;
+  if (!readWav(argv[1], wav, rate))
+  {
+    fprintf(stderr, "%s: not a 16-bit PCM WAV file\n", argv[1]);
+    return 2;
+  }
+
+  OnsetDetector detector;
+  if (argc > 2)
+    detector.sensitivity = atoi(argv[2]);
+  long budgetNs = argc > 3 ? atol(argv[3]) : 2000;
+
+  const double frameSeconds = 1.0 / FRAMES_PER_SECOND;
+  const size_t frames = (size_t)(wav.size() / (rate * frameSeconds));
+
+  int onsets = 0;
+  long worstNs = 0;
+  long long totalNs = 0;
+  for (size_t frame = 0; frame < frames; frame++)
+  {
+    size_t start = (size_t)(frame * frameSeconds * rate);
+    uint16_t samples[AUDIO_SAMPLES];
+    for (int i = 0; i < AUDIO_SAMPLES; i++)
+    {
+      size_t at = start + (size_t)((uint64_t)i * ADC_INTERVAL_US * rate / 1000000);
+      int16_t s = at < wav.size() ? wav[at] : 0;
+      samples[i] = (uint16_t)((s >> 6) + 512); // to the 10-bit ADC range
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    bool hit = detector.process(samples, AUDIO_SAMPLES);
+    auto t1 = std::chrono::steady_clock::now();
+
+    long ns = (long)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    totalNs += ns;
+    if (ns > worstNs)
+      worstNs = ns;
+
+    if (hit)
+    {
+      onsets++;
+      printf("%8.3f s  onset  strength %3u\n", frame * frameSeconds, detector.strength);
+    }
+  }
+
+  printf("%d onsets in %zu frames; detector mean %lld ns, worst %ld ns per frame (budget %ld ns)\n",
+         onsets, frames, frames ? totalNs / (long long)frames : 0, worstNs, budgetNs);
+
+  return frames && totalNs / (long long)frames > budgetNs ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+/* Reproducible effect randomness check
+ *
+ * Renders fire's heat (RX/src/fireheat.h) and rioDisco's twinkles
+ * (twinklepick.h, faded as hires.h does), the receiver's own code for both,
+ * through its generator (RX/src/prng.cpp), on a made-up beat clock at 120
+ * BPM, where some frames share a frame number, and hashes each second of
+ * frames. Checks that:
+ *  - two drums with the same mode, band seed and beat render the same
+ *    frames, and one that starts fire late catches up within two seconds.
+ *    Twinkle doesn't: its picks steer clear of pixels still lit, so once
+ *    two drums' frames differ, so do their picks from then on
+ *  - a drum salt, another band seed or another mode renders different ones
+ *  - the hashes are those recorded below, so a change to the generator, or
+ *    to how it is seeded, shows up here before a band of drums that were
+ *    flashed at different times falls out of step
+ * Exits 1 if any check fails. With -p it prints the hashes to record.
+ *
+ *   g++ -O2 -Wall -Wextra -I common/DrumRadio -I RX/src tools/prng_golden.cpp RX/src/prng.cpp -o prng_golden
+ *   ./prng_golden [-p]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "DrumRadio.h"
+#include "fireheat.h"
+#include "prng.h"
+#include "twinklepick.h"
+
+#define FPS 35
+#define BPM 120
+#define FRAMES (FPS * 10)
+#define FIRE_MODE 50
+#define TWINKLE_MODE 61
+
+// The beat clock, as clock.cpp keeps it at a steady tempo
+static uint32_t beats = 0;
+
+uint32_t clockBeats()
+{
+  return beats;
+}
+
+static void clockAt(int frame)
+{
+  beats = (uint32_t)(((uint64_t)frame * BPM << BEAT_FRACTION_BITS) / (60 * FPS));
+}
+
+// twinkle.cpp's 16-bit frame, lit in rioDisco's colours
+struct Pixel16
+{
+  uint16_t r, g, b;
+};
+
+static const Pixel16 rioDisco[3] = {{0, 128 * 257, 0}, {255 * 257, 215 * 257, 0}, {0, 0, 139 * 257}};
+static int lastPixel = 0;
+
+static void twinkleFrame(std::vector<Pixel16> &frame)
+{
+  int n = frame.size();
+  uint16_t scale = 256 - twinkleFade(n); // hiresFade()
+  for (Pixel16 &pixel : frame)
+  {
+    pixel.r = ((uint32_t)pixel.r * scale) >> 8;
+    pixel.g = ((uint32_t)pixel.g * scale) >> 8;
+    pixel.b = ((uint32_t)pixel.b * scale) >> 8;
+  }
+  twinklePick(
+      n, lastPixel, [&](int pixel, uint8_t color) { frame[pixel] = rioDisco[color]; },
+      [&](int pixel) { return (frame[pixel].r | frame[pixel].g | frame[pixel].b) > 0xFF; });
+}
+
+// FNV-1a of every frame, one hash a second
+static std::vector<uint32_t> render(int mode, uint16_t seed, uint8_t salt, int leds, int from)
+{
+  prngBegin(salt);
+  prngBandSeed(seed);
+  lastPixel = 0;
+  std::vector<uint8_t> heat(leds);
+  std::vector<Pixel16> frame(leds, {0, 0, 0});
+  std::vector<uint32_t> hashes;
+  uint32_t hash = 2166136261u;
+  for (int f = from; f < from + FRAMES; f++)
+  {
+    clockAt(f);
+    prngFrame(mode);
+    if (mode == FIRE_MODE)
+    {
+      fireHeat(heat.data(), leds);
+      for (uint8_t b : heat)
+        hash = (hash ^ b) * 16777619u;
+    }
+    else
+    {
+      twinkleFrame(frame);
+      for (const Pixel16 &pixel : frame)
+        hash = ((((hash ^ pixel.r) * 16777619u) ^ pixel.g) * 16777619u ^ pixel.b) * 16777619u;
+    }
+    if ((f - from) % FPS == FPS - 1)
+    {
+      hashes.push_back(hash);
+      hash = 2166136261u;
+    }
+  }
+  return hashes;
+}
+
+struct Golden
+{
+  int mode;
+  uint16_t seed;
+  int leds;
+  uint32_t first, last; // hashes of the first and last second
+};
+
+static const Golden golden[] = {
+    {FIRE_MODE, 0x1234, 36, 0xDF66BB09, 0xC09CDE6D},
+    {FIRE_MODE, 0xBEEF, 104, 0x832E8671, 0x5809F14B},
+    {TWINKLE_MODE, 0x1234, 36, 0x28CAC3BD, 0xA52FAC8E},
+    {TWINKLE_MODE, 0xBEEF, 104, 0xCD4F6C2B, 0x1C2D24A5},
+};
+
+int main(int argc, char **argv)
+{
+  bool print = argc > 1 && !strcmp(argv[1], "-p");
+  bool ok = true;
+
+  for (const Golden &g : golden)
+  {
+    const char *name = g.mode == FIRE_MODE ? "fire" : "twinkle";
+    std::vector<uint32_t> drum = render(g.mode, g.seed, 0, g.leds, 0);
+    if (print)
+    {
+      printf("    {%s, 0x%04X, %d, 0x%08X, 0x%08X},\n", g.mode == FIRE_MODE ? "FIRE_MODE" : "TWINKLE_MODE", g.seed,
+             g.leds, drum.front(), drum.back());
+      continue;
+    }
+
+    if (drum.front() != g.first || drum.back() != g.last)
+    {
+      printf("%s, seed %04X, %d LEDs: hashes %08X %08X, recorded %08X %08X\n", name, g.seed, g.leds, drum.front(),
+             drum.back(), g.first, g.last);
+      ok = false;
+    }
+    if (render(g.mode, g.seed, 0, g.leds, 0) != drum)
+    {
+      printf("%s, seed %04X, %d LEDs: a second drum renders different frames\n", name, g.seed, g.leds);
+      ok = false;
+    }
+    if (render(g.mode, g.seed, 7, g.leds, 0) == drum)
+    {
+      printf("%s, seed %04X, %d LEDs: a salted drum renders the same frames\n", name, g.seed, g.leds);
+      ok = false;
+    }
+    if (render(g.mode, g.seed ^ 1, 0, g.leds, 0) == drum)
+    {
+      printf("%s, seed %04X, %d LEDs: another band seed renders the same frames\n", name, g.seed, g.leds);
+      ok = false;
+    }
+    if (render(g.mode + 1, g.seed, 0, g.leds, 0) == drum)
+    {
+      printf("%s, seed %04X, %d LEDs: another mode renders the same frames\n", name, g.seed, g.leds);
+      ok = false;
+    }
+  }
+
+  // A drum that joins fire late renders what the others are once what it
+  // started with has cooled away, within its first two seconds
+  std::vector<uint32_t> early = render(FIRE_MODE, 0x1234, 0, 72, 0);
+  std::vector<uint32_t> late = render(FIRE_MODE, 0x1234, 0, 72, FPS * 5);
+  if (!std::equal(late.begin() + 2, late.begin() + 5, early.begin() + 7))
+  {
+    printf("fire: a drum that joins late renders different frames\n");
+    ok = false;
+  }
+
+  if (!print)
+    printf(ok ? "All frames as expected\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Frame profile report for a Drum Lights receiver.
+
+Asks a receiver on a serial port for its profile (RX/src/profile.cpp) and
+prints where each mode's frame time goes: mean and worst time per section,
+a histogram of busy time against the frame budget, the hot-path counters
+and the most recent frames that overran. Needs pyserial, e.g.
+
+    python3 tools/profile_dump.py --port /dev/ttyUSB0
+    python3 tools/profile_dump.py --port /dev/ttyUSB0 --save drum3.bin
+    python3 tools/profile_dump.py --file drum3.bin
+
+To see what a build specialised for the drum's size (e.g. pio run -e drum72)
+gains, save a dump from the same drum running each build through the same
+modes, then compare the render time per frame, mode by mode:
+
+    python3 tools/profile_dump.py --compare generic.bin drum72.bin
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+MAGIC = b"DPRF"
+VERSION = 4
+HEADER = struct.Struct("<4sBBBBHHIBBHH")
+SECTIONS = ["radio", "audio", "render", "dither", "show", "idle"]
+COUNTERS = ["packets", "overruns", "vm budget", "relays", "radio faults", "radio silences", "radio restarts",
+            "radio recovery us", "watchdog reboots"]
+
+
+def crc16(data, crc=0xFFFF):
+    # CRC-16/CCITT-FALSE, as drumCrc16() in common/DrumRadio/DrumRadio.h
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+    return crc
+
+
+def dump_length(header):
+    _, _, sections, counters, buckets, _, _, _, modes, overruns, _, _ = header
+    mode_size = 2 + 4 + 4 * sections * 2 + 4 * buckets
+    overrun_size = 4 + 2 + 2 * sections
+    return HEADER.size + 4 * counters + modes * mode_size + overruns * overrun_size + 2
+
+
+def fetch(port, baud, timeout):
+    import serial  # pyserial
+
+    with serial.Serial(port, baud, timeout=0.1) as link:
+        link.reset_input_buffer()
+        link.write(b"P")
+        data = b""
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            data += link.read(4096)
+            start = data.find(MAGIC)
+            if start >= 0 and len(data) - start >= HEADER.size:
+                header = HEADER.unpack_from(data, start)
+                if len(data) - start >= dump_length(header):
+                    return data[start:start + dump_length(header)]
+    sys.exit("no profile received; is the receiver running and on this port?")
+
+
+def check(dump):
+    header = HEADER.unpack_from(dump)
+    if header[0] != MAGIC or header[1] != VERSION:
+        sys.exit("not a version %d profile dump" % VERSION)
+    length = dump_length(header)
+    if len(dump) < length:
+        sys.exit("profile dump is truncated")
+    if crc16(dump[:length - 2]) != struct.unpack_from("<H", dump, length - 2)[0]:
+        sys.exit("profile dump is corrupt (CRC mismatch)")
+    return header
+
+
+def build_name(leds, built_leds):
+    if not built_leds:
+        return "%d LEDs, generic build" % leds
+    if built_leds != leds:
+        return "%d LEDs, build for %d (running generic effects)" % (leds, built_leds)
+    return "%d LEDs, build specialised for them" % leds
+
+
+def mode_records(dump, header):
+    """(mode, frames, totals, worst, histogram) for each mode in a dump"""
+    _, _, sections, counters, buckets, _, _, _, modes, _, _, _ = header
+    at = HEADER.size + 4 * counters
+    for _ in range(modes):
+        mode, frames = struct.unpack_from("<hI", dump, at)
+        at += 6
+        totals = struct.unpack_from("<%dI" % sections, dump, at)
+        at += 4 * sections
+        worst = struct.unpack_from("<%dI" % sections, dump, at)
+        at += 4 * sections
+        histogram = struct.unpack_from("<%dI" % buckets, dump, at)
+        at += 4 * buckets
+        yield mode, frames, totals, worst, histogram
+
+
+def decode(dump):
+    header = check(dump)
+    _, _, sections, counters, buckets, bucket_us, budget_us, uptime, modes, overruns, leds, built_leds = header
+
+    names = (SECTIONS + ["section %d" % s for s in range(len(SECTIONS), sections)])[:sections]
+    counts = struct.unpack_from("<%dI" % counters, dump, HEADER.size)
+
+    print("uptime %.1f s, frame budget %.1f ms, %s" % (uptime / 1000, budget_us / 1000, build_name(leds, built_leds)))
+    print("counters: " + ", ".join("%s %d" % (COUNTERS[c] if c < len(COUNTERS) else "counter %d" % c, n)
+                                   for c, n in enumerate(counts)))
+    restarts = COUNTERS.index("radio restarts")
+    if restarts + 1 < counters and counts[restarts]:
+        print("radio back after %.1f ms on average" % (counts[restarts + 1] / counts[restarts] / 1000))
+
+    for mode, frames, totals, worst, histogram in mode_records(dump, header):
+        print()
+        print("mode %d: %d frames" % (mode, frames))
+        for s, name in enumerate(names):
+            mean = totals[s] / frames if frames else 0
+            share = "" if name == "idle" else "  (%4.1f%% of budget)" % (100 * mean / budget_us)
+            print("  %-8s mean %7.2f ms  worst %7.2f ms%s" % (name, mean / 1000, worst[s] / 1000, share))
+        peak = max(histogram) or 1
+        for b, n in enumerate(histogram):
+            if not n:
+                continue
+            low = b * bucket_us / 1000
+            label = "%5.0f+    ms" % low if b == buckets - 1 else "%5.0f-%-3.0f ms" % (low, low + bucket_us / 1000)
+            over = " over budget" if b * bucket_us >= budget_us else ""
+            print("  %s %8d %s%s" % (label, n, "#" * max(1, n * 40 // peak), over))
+
+    mode_size = 2 + 4 + 4 * sections * 2 + 4 * buckets
+    at = HEADER.size + 4 * counters + modes * mode_size
+    if overruns:
+        print()
+        print("latest overrunning frames:")
+    for _ in range(overruns):
+        when, mode = struct.unpack_from("<Ih", dump, at)
+        at += 6
+        times = struct.unpack_from("<%dH" % sections, dump, at)
+        at += 2 * sections
+        print("  %9.3f s  mode %4d  " % (when / 1000, mode) +
+              "  ".join("%s %.2f ms" % (names[s], t / 1000) for s, t in enumerate(times)))
+
+
+def compare(before, after):
+    """Mean render time per frame of each mode in both dumps, and the gain"""
+    means = []
+    for dump in (before, after):
+        header = check(dump)
+        print(build_name(header[10], header[11]))
+        means.append({mode: totals[SECTIONS.index("render")] / frames
+                      for mode, frames, totals, _, _ in mode_records(dump, header) if frames})
+
+    print()
+    print(" mode   render before   render after    gain")
+    for mode in sorted(set(means[0]) & set(means[1])):
+        old, new = means[0][mode], means[1][mode]
+        gain = 100 * (old - new) / old if old else 0
+        print("%5d  %10.3f ms  %10.3f ms  %5.1f%%" % (mode, old / 1000, new / 1000, gain))
+
+
+def load(path):
+    with open(path, "rb") as f:
+        dump = f.read()
+    start = dump.find(MAGIC)
+    return dump[start:] if start >= 0 else dump
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port the receiver is on")
+    source.add_argument("--file", help="decode a dump saved earlier with --save")
+    source.add_argument("--compare", nargs=2, metavar=("BEFORE", "AFTER"),
+                        help="compare the render time per mode of two saved dumps")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=5.0)
+    parser.add_argument("--save", help="also write the raw dump here")
+    args = parser.parse_args()
+
+    if args.compare:
+        compare(load(args.compare[0]), load(args.compare[1]))
+        sys.exit()
+
+    if args.port:
+        dump = fetch(args.port, args.baud, args.timeout)
+    else:
+        dump = load(args.file)
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(dump)
+    decode(dump)
@@ -0,0 +1,251 @@
+/* Receiver relaying simulator
+ *
+ * Runs every drum's Flood (RX/src/flood.cpp) in a simulated parade: the
+ * band marches in rows, several drums abreast, with the TX carried behind
+ * the last row. Each link succeeds with a probability that falls off with
+ * distance and with every row of drums and drummers in between. Two packets
+ * heard in the same millisecond collide, a drum can't hear while it sends,
+ * and, as on the nRF24, only three packets wait in a drum's FIFO between
+ * the once-a-frame reads.
+ *
+ * The TX sends a mode command every two seconds (five retransmissions
+ * 10ms apart), its tempo every second and a heartbeat every 100ms, as the
+ * real one does. For each band length, drum count and hop limit this
+ * prints the share of commands reaching each drum, the latency of the
+ * first copy to arrive, and the packets relayed per command.
+ *
+ *   g++ -O2 -I common/DrumRadio -I RX/src tools/relay_sim.cpp RX/src/flood.cpp -o relay_sim
+ *   ./relay_sim [commands] [abreast]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "DrumRadio.h"
+#include "flood.h"
+
+#define FRAME_MS 28 // 35 fps
+#define FIFO_DEPTH 3
+#define COMMAND_MS 2000
+#define RETRANSMITS 5
+#define RETRANSMIT_MS 10
+#define TEMPO_MS 1000
+#define DELIVERY_MS 1000 // a command arriving later than this counts as lost
+
+#define ROW_SPACING_M 1.5
+#define TX_BEHIND_M 3.0
+#define CLEAR_RANGE_M 10.0 // links this short get through almost always
+#define MAX_RANGE_M 40.0   // and none longer do
+#define ROW_SHADOW 0.88    // each row in between passes this share
+
+struct Drum
+{
+  double x, y;
+  int phase; // ms into the frame cycle it reads the radio
+  Flood flood;
+  std::vector<DrumPacket> fifo;
+  std::vector<DrumPacket> sending; // relays going out this millisecond
+  long firstHeard;
+  int row;
+};
+
+struct Transmission
+{
+  int from; // drum index, or -1 for the TX
+  DrumPacket packet;
+};
+
+static double linkChance(double distance, int rowsBetween)
+{
+  double p = distance <= CLEAR_RANGE_M ? 0.98 : 0.98 * (MAX_RANGE_M - distance) / (MAX_RANGE_M - CLEAR_RANGE_M);
+  if (p <= 0)
+    return 0;
+  return p * pow(ROW_SHADOW, rowsBetween);
+}
+
+static bool chance(double p)
+{
+  return rand() < p * RAND_MAX;
+}
+
+struct Result
+{
+  double delivery;
+  double worstDrum; // delivery to the worst-served drum
+  double meanLatency;
+  long worstLatency;
+  double relaysPerCommand;
+};
+
+static Result simulate(int drumCount, int abreast, int hops, int commands)
+{
+  int rows = (drumCount + abreast - 1) / abreast;
+  std::vector<Drum> drums(drumCount);
+  for (int d = 0; d < drumCount; d++)
+  {
+    drums[d].row = d / abreast;
+    drums[d].x = (d % abreast) * ROW_SPACING_M;
+    drums[d].y = drums[d].row * ROW_SPACING_M; // row 0 at the front
+    drums[d].phase = rand() % FRAME_MS;
+    drums[d].flood.maxHops = hops;
+  }
+  const double txX = (abreast - 1) * ROW_SPACING_M / 2, txY = (rows - 1) * ROW_SPACING_M + TX_BEHIND_M;
+
+  std::vector<int> delivered(drumCount, 0);
+  long latencyTotal = 0, latencyCount = 0, worstLatency = 0;
+  long relays = 0;
+  long end = (long)commands * COMMAND_MS;
+  long commandAt = -1;
+  int mode = 0;
+
+  for (long now = 0; now < end + DELIVERY_MS; now++)
+  {
+    std::vector<Transmission> air;
+
+    // the TX
+    if (now % COMMAND_MS == 0 && now < end)
+    {
+      if (commandAt >= 0)
+      {
+        for (int d = 0; d < drumCount; d++)
+          if (drums[d].firstHeard >= 0)
+            delivered[d]++;
+      }
+      commandAt = now;
+      mode++;
+      for (Drum &drum : drums)
+        drum.firstHeard = -1;
+    }
+    if (commandAt >= 0 && now - commandAt < RETRANSMITS * RETRANSMIT_MS && (now - commandAt) % RETRANSMIT_MS == 0)
+    {
+      Transmission t = {-1, {}};
+      drumPacketInit(t.packet, PACKET_MODE);
+      t.packet.mode.mode = mode;
+      t.packet.term = 1;
+      air.push_back(t);
+    }
+    else if (now % TEMPO_MS == 500)
+    {
+      Transmission t = {-1, {}};
+      drumPacketInit(t.packet, PACKET_TEMPO);
+      t.packet.tempo.bpm = 120 << 8;
+      t.packet.tempo.beat = (uint32_t)now << 13;
+      t.packet.term = 1;
+      air.push_back(t);
+    }
+    else if (now % HEARTBEAT_MS == 50)
+    {
+      Transmission t = {-1, {}};
+      drumPacketInit(t.packet, PACKET_HEARTBEAT);
+      t.packet.term = 1;
+      air.push_back(t);
+    }
+
+    // relays due from the drums
+    for (int d = 0; d < drumCount; d++)
+    {
+      for (const DrumPacket &packet : drums[d].sending)
+        air.push_back({d, packet});
+      relays += drums[d].sending.size();
+      drums[d].sending.clear();
+    }
+
+    // what each drum hears
+    for (int d = 0; d < drumCount; d++)
+    {
+      Drum &drum = drums[d];
+      int heard = 0;
+      const DrumPacket *packet = nullptr;
+      bool transmitting = false;
+      for (const Transmission &t : air)
+      {
+        if (t.from == d)
+        {
+          transmitting = true;
+          continue;
+        }
+        double x = t.from < 0 ? txX : drums[t.from].x, y = t.from < 0 ? txY : drums[t.from].y;
+        int fromRow = t.from < 0 ? rows : drums[t.from].row;
+        int between = abs(fromRow - drum.row) > 1 ? abs(fromRow - drum.row) - 1 : 0;
+        if (chance(linkChance(hypot(x - drum.x, y - drum.y), between)))
+        {
+          heard++;
+          packet = &t.packet;
+        }
+      }
+      if (!transmitting && heard == 1 && drum.fifo.size() < FIFO_DEPTH)
+        drum.fifo.push_back(*packet);
+    }
+
+    // drums whose frame starts now read the radio, then send what's due
+    for (int d = 0; d < drumCount; d++)
+    {
+      Drum &drum = drums[d];
+      if ((now + drum.phase) % FRAME_MS != 0)
+        continue;
+
+      for (const DrumPacket &packet : drum.fifo)
+      {
+        bool fresh = drum.flood.heard(packet, now, rand());
+        if ((fresh || drumPacketHops(packet) == 0) && drumPacketType(packet) == PACKET_MODE &&
+            packet.mode.mode == mode && drum.firstHeard < 0 && now - commandAt <= DELIVERY_MS)
+        {
+          drum.firstHeard = now;
+          latencyTotal += now - commandAt;
+          latencyCount++;
+          if (now - commandAt > worstLatency)
+            worstLatency = now - commandAt;
+        }
+      }
+      drum.fifo.clear();
+
+      DrumPacket relay;
+      while (drum.flood.due(relay, now))
+        drum.sending.push_back(relay);
+    }
+  }
+  for (int d = 0; d < drumCount; d++)
+    if (drums[d].firstHeard >= 0)
+      delivered[d]++;
+
+  Result result;
+  long total = 0;
+  int worst = commands;
+  for (int d = 0; d < drumCount; d++)
+  {
+    total += delivered[d];
+    worst = delivered[d] < worst ? delivered[d] : worst;
+  }
+  result.delivery = 100.0 * total / ((long)drumCount * commands);
+  result.worstDrum = 100.0 * worst / commands;
+  result.meanLatency = latencyCount ? (double)latencyTotal / latencyCount : 0;
+  result.worstLatency = worstLatency;
+  result.relaysPerCommand = (double)relays / commands;
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  int commands = argc > 1 ? atoi(argv[1]) : 100;
+  int abreast = argc > 2 ? atoi(argv[2]) : 4;
+  srand(1);
+
+  const int drumCounts[] = {12, 24, 48, 96};
+  printf("%d drums abreast, rows %.1fm apart, TX %.1fm behind; %d commands each\n\n", abreast, ROW_SPACING_M,
+         TX_BEHIND_M, commands);
+  printf("drums  length  hops  delivered  worst drum  latency mean/worst  relays/command\n");
+  for (int drumCount : drumCounts)
+  {
+    double length = ((drumCount + abreast - 1) / abreast - 1) * ROW_SPACING_M + TX_BEHIND_M;
+    for (int hops = 0; hops <= 3; hops++)
+    {
+      Result r = simulate(drumCount, abreast, hops, commands);
+      printf("%5d  %5.0fm  %4d  %8.1f%%  %9.1f%%  %8.0f / %4ld ms  %14.1f\n", drumCount, length, hops, r.delivery,
+             r.worstDrum, r.meanLatency, r.worstLatency, r.relaysPerCommand);
+    }
+  }
+  return 0;
+}
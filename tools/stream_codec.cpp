@@ -0,0 +1,139 @@
+/* Streamed-frame codec bench
+ *
+ * Runs the stream codec (common/DrumRadio/DrumStream.h) over a few seconds
+ * of frames from effects like the receivers' own (spin, chase, rainbow,
+ * twinkle), rendered at the stream's resolution and frame rate. Checks that
+ * every frame decodes back exactly, including when parts are lost and a
+ * keyframe has to recover, and prints the compression ratio, packets per
+ * frame and decode cost of each. Exits 1 if any frame fails to round-trip.
+ *
+ *   g++ -O2 -Wall -Wextra -I common/DrumRadio tools/stream_codec.cpp -o stream_codec
+ *   ./stream_codec [seconds] [loss_percent]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "DrumRadio.h"
+#include "DrumStream.h"
+
+#define STREAM_FPS 20
+
+typedef void (*Effect)(uint8_t *pixels, int frame);
+
+static void spin(uint8_t *pixels, int frame)
+{
+  // green, gold, blue thirds, once round every two seconds
+  const uint8_t colours[3] = {6, 5, 10};
+  for (int i = 0; i < STREAM_PIXELS; i++)
+    pixels[(i + frame * STREAM_PIXELS / (2 * STREAM_FPS)) % STREAM_PIXELS] = colours[i * 3 / STREAM_PIXELS];
+}
+
+static void chase(uint8_t *pixels, int frame)
+{
+  // four blue dots with a dark blue tail, a segment per half second
+  const int segment = STREAM_PIXELS / 4;
+  int head = frame * segment / (STREAM_FPS / 2) % segment;
+  for (int i = 0; i < STREAM_PIXELS; i++)
+  {
+    int behind = (head - i % segment + segment) % segment;
+    pixels[i] = behind == 0 ? 9 : behind < 3 ? 10 : 0;
+  }
+}
+
+static void rainbow(uint8_t *pixels, int frame)
+{
+  // the colour wheel, as near as the palette gets, turning once a bar
+  const uint8_t wheel[8] = {2, 4, 5, 6, 8, 9, 11, 12};
+  for (int i = 0; i < STREAM_PIXELS; i++)
+    pixels[i] = wheel[(i * 8 / STREAM_PIXELS + frame * 8 / (2 * STREAM_FPS)) % 8];
+}
+
+static void twinkle(uint8_t *pixels, int /* frame */)
+{
+  // a few random pixels lit each frame, each staying lit for a few frames
+  static uint8_t age[STREAM_PIXELS];
+  for (int i = 0; i < STREAM_PIXELS; i++)
+  {
+    if (age[i] > 0)
+      age[i]--;
+    if (rand() % 20 == 0)
+      age[i] = 4;
+    pixels[i] = age[i] ? 1 + i % 3 * 4 : 0;
+  }
+}
+
+static const struct
+{
+  const char *name;
+  Effect effect;
+} effects[] = {{"spin", spin}, {"chase", chase}, {"rainbow", rainbow}, {"twinkle", twinkle}};
+
+int main(int argc, char **argv)
+{
+  int seconds = argc > 1 ? atoi(argv[1]) : 10;
+  int lossPercent = argc > 2 ? atoi(argv[2]) : 0;
+  int frames = seconds * STREAM_FPS;
+  int failures = 0;
+
+  printf("%-8s %9s %9s %9s %10s %9s\n", "effect", "bytes/fr", "ratio", "pkts/fr", "decode ns", "stale px");
+  for (const auto &e : effects)
+  {
+    srand(1);
+    uint8_t frame[STREAM_PIXELS], previous[STREAM_PIXELS] = {0}, received[STREAM_PIXELS] = {0};
+    long bytes = 0, packets = 0, decodeNs = 0, stale = 0;
+
+    for (int f = 0; f < frames; f++)
+    {
+      e.effect(frame, f);
+      bool key = f % STREAM_KEY_INTERVAL == 0;
+      bool lostAny = false;
+
+      uint8_t pixel = 0;
+      do
+      {
+        StreamBody part;
+        part.start = pixel;
+        part.length = streamEncode(frame, key ? nullptr : previous, pixel, part.data, STREAM_PART_SIZE);
+        bytes += part.length;
+        packets++;
+
+        if (rand() % 100 < lossPercent)
+        {
+          lostAny = true;
+          continue;
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        bool ok = streamDecode(received, part.start, part.data, part.length);
+        auto t1 = std::chrono::steady_clock::now();
+        decodeNs += (long)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        if (!ok)
+        {
+          printf("%s frame %d: part failed to decode\n", e.name, f);
+          failures++;
+        }
+      } while (pixel < STREAM_PIXELS);
+      memcpy(previous, frame, sizeof(frame));
+
+      int wrong = 0;
+      for (int i = 0; i < STREAM_PIXELS; i++)
+        wrong += received[i] != frame[i];
+      stale += wrong;
+      if (wrong && !lostAny && (key || lossPercent == 0))
+      {
+        printf("%s frame %d: %d pixels differ after decoding\n", e.name, f, wrong);
+        failures++;
+      }
+    }
+
+    printf("%-8s %9.1f %8.1fx %9.2f %10ld %9.2f\n", e.name, (double)bytes / frames,
+           (double)STREAM_PIXELS * 3 * frames / bytes, (double)packets / frames, decodeNs / frames,
+           (double)stale / frames);
+  }
+
+  printf("ratio is against 24-bit RGB; %d%% of parts dropped\n", lossPercent);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+/* Cued strobe simulator
+ *
+ * Runs every drum's Cue (RX/src/cue.cpp) against a TX cueing a strobe 100ms
+ * ahead, and reports how closely the band flashes together. The TX sends
+ * ten copies 10ms apart, each lost independently for each drum. Each drum
+ * has its own frame phase and a clock up to 50ppm fast or slow. It reads
+ * the radio at the start of each frame, as the RX does, and from the first
+ * copy it reads it spins, reading the radio every few tens of uS, until
+ * the moment it has worked out. Fewer copies over a shorter lead leave
+ * more drums with only the copies read late at a frame's start, a frame
+ * adrift of the rest: at 20% loss, five over 50ms spread the band by 15ms
+ * on average, against 34us for ten over 100ms. For comparison
+ * it also reports the old way, where each drum flashed at the first frame
+ * after it read a mode 98 command.
+ *
+ * Each drum has 36, 52, 72 or 104 LEDs, and only lights once its whole
+ * strip has been clocked out, 30us an LED, and the line held low for the
+ * reset. The RX shows the frame that much early (ledLatencyUs()); the
+ * "unallowed" column is the spread if it didn't, which is most of the
+ * difference in wire time between the smallest and biggest drum, and grows
+ * with it, 18ms for a 600 LED drum.
+ *
+ *   g++ -O2 -Wall -Wextra -I common/DrumRadio -I RX/src tools/strobe_sim.cpp RX/src/cue.cpp -o strobe_sim
+ *   ./strobe_sim [trials] [drums]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "cue.h"
+
+#define FRAME_US (1000000 / 35)
+#define WITHIN_US 120000 // FLASH_HORIZON_US on the RX
+#define LEAD_US 100000   // STROBE_LEAD_US on the TX
+#define COPIES 10        // STROBE_COPIES
+#define COPY_US 10300    // delay(10) plus the write
+#define AIR_US 250       // write to payload in the FIFO, the same for every drum
+#define DEMOD_JITTER_US 20 // on top, per drum
+#define DRIFT_PPM 50
+#define POLL_US 20       // readRadio() with nothing waiting
+#define READ_US 80       // with a packet to read
+#define FRAME_READ_US 60 // per packet read at the start of a frame
+#define LED_WIRE_US 30   // as output.h
+#define LED_RESET_US 280
+
+static const int ledCounts[] = {36, 52, 72, 104};
+
+static double uniform(double lo, double hi)
+{
+  return lo + (hi - lo) * rand() / ((double)RAND_MAX + 1);
+}
+
+struct Result
+{
+  bool fired;
+  double at;        // true time the strip lights, uS
+  double unallowed; // had the frame been shown at the moment itself
+  bool oldFired;
+  double oldAt;
+};
+
+// One drum's view of one strobe
+static Result simulateDrum(double loss)
+{
+  double rate = 1 + uniform(-DRIFT_PPM, DRIFT_PPM) * 1e-6; // local uS per true uS
+  double offset = uniform(0, 4e9);
+  auto local = [&](double t) { return (uint32_t)fmod(offset + t * rate, 4294967296.0); };
+
+  // copies as they land in the drum's FIFO, with what each says
+  std::vector<std::pair<double, uint32_t>> copies;
+  for (int i = 0; i < COPIES; i++)
+  {
+    if (uniform(0, 1) < loss)
+      continue;
+    double sent = i * COPY_US;
+    copies.push_back({sent + AIR_US + uniform(0, DEMOD_JITTER_US), (uint32_t)(LEAD_US - sent)});
+  }
+
+  int leds = ledCounts[rand() % (sizeof(ledCounts) / sizeof(ledCounts[0]))];
+  uint32_t latency = leds * LED_WIRE_US + LED_RESET_US;
+
+  Result result = {false, 0, 0, false, 0};
+  if (copies.empty())
+    return result;
+
+  // the old way: shown at the first frame after the first copy lands
+  double phase = uniform(0, FRAME_US);
+  double frame = phase - FRAME_US;
+  while (frame < copies[0].first)
+    frame += FRAME_US / rate;
+  result.oldFired = true;
+  result.oldAt = frame + latency / rate;
+
+  Cue cue;
+  size_t next = 0;
+  for (frame = phase - FRAME_US; frame < LEAD_US + 2 * FRAME_US; frame += FRAME_US / rate)
+  {
+    double t = frame;
+    while (next < copies.size() && copies[next].first <= t)
+    {
+      t += FRAME_READ_US / rate;
+      cue.heard(1, copies[next++].second, local(t));
+    }
+
+    if (!cue.due(local(t), WITHIN_US))
+      continue;
+
+    // flashPoll(): spin reading the radio until the moment, less the time
+    // the strip takes to light
+    auto spin = [&](Cue cue, size_t next, double t, uint32_t early) {
+      while ((int32_t)(cue.at - early - local(t)) > 0)
+      {
+        if (next < copies.size() && copies[next].first <= t)
+        {
+          t += READ_US / rate;
+          cue.heard(1, copies[next++].second, local(t));
+        }
+        else
+        {
+          t += POLL_US / rate;
+        }
+      }
+      return t + latency / rate;
+    };
+    result.fired = true;
+    result.at = spin(cue, next, t, latency);
+    result.unallowed = spin(cue, next, t, 0);
+    return result;
+  }
+  return result;
+}
+
+static double spread(std::vector<double> &times)
+{
+  if (times.size() < 2)
+    return 0;
+  auto minmax = std::minmax_element(times.begin(), times.end());
+  return *minmax.second - *minmax.first;
+}
+
+int main(int argc, char **argv)
+{
+  int trials = argc > 1 ? atoi(argv[1]) : 1000;
+  int drums = argc > 2 ? atoi(argv[2]) : 60;
+  srand(1);
+
+  printf("%d strobes to %d drums\n", trials, drums);
+  printf("  loss  missed   spread mean   p99     worst   unallowed mean  worst   old way mean   worst\n");
+  for (double loss : {0.0, 0.1, 0.2, 0.3, 0.5})
+  {
+    std::vector<double> spreads, unallowedSpreads, oldSpreads;
+    long missed = 0;
+    for (int trial = 0; trial < trials; trial++)
+    {
+      std::vector<double> times, unallowedTimes, oldTimes;
+      for (int d = 0; d < drums; d++)
+      {
+        Result r = simulateDrum(loss);
+        if (r.fired)
+        {
+          times.push_back(r.at);
+          unallowedTimes.push_back(r.unallowed);
+        }
+        else
+          missed++;
+        if (r.oldFired)
+          oldTimes.push_back(r.oldAt);
+      }
+      spreads.push_back(spread(times));
+      unallowedSpreads.push_back(spread(unallowedTimes));
+      oldSpreads.push_back(spread(oldTimes));
+    }
+
+    std::sort(spreads.begin(), spreads.end());
+    std::sort(unallowedSpreads.begin(), unallowedSpreads.end());
+    std::sort(oldSpreads.begin(), oldSpreads.end());
+    double mean = 0, unallowedMean = 0, oldMean = 0;
+    for (size_t i = 0; i < spreads.size(); i++)
+    {
+      mean += spreads[i] / spreads.size();
+      unallowedMean += unallowedSpreads[i] / unallowedSpreads.size();
+      oldMean += oldSpreads[i] / oldSpreads.size();
+    }
+    printf("  %3.0f%%  %5.2f%%  %8.0fus %6.0fus %7.0fus  %11.0fus %6.0fus  %10.1fms %6.1fms\n", loss * 100,
+           100.0 * missed / ((double)trials * drums), mean, spreads[spreads.size() * 99 / 100], spreads.back(),
+           unallowedMean, unallowedSpreads.back(), oldMean / 1000, oldSpreads.back() / 1000);
+  }
+  return 0;
+}
@@ -0,0 +1,310 @@
+/* UART WS2812 waveform check
+ *
+ * Plays the characters Uart1Driver (RX/src/output.cpp) writes for each
+ * colour byte, from the table in RX/src/uartwire.h, through a model of
+ * UART1 sending 6N1 inverted at 3.2Mbaud, and times the line the way a
+ * WS2812B reads it. Checks that:
+ *  - every high and low lasts as long as the datasheet allows (T0H
+ *    400ns, T1H 800ns, T0L 850ns, T1L 450ns, each +-150ns), and each bit
+ *    1.25us +-600ns
+ *  - all 256 values read back as written, MSB first
+ *  - frames sent through a host build of the driver (a LedDriver, see
+ *    RX/src/leddriver.h) whose refill interrupt is sometimes held off, so
+ *    that the FIFO runs dry and holds the line low for longer, still read
+ *    back. A low stretched that way must stay under the 50us an original
+ *    WS2812 latches after; longer, the driver must hold the line low past
+ *    a WS2812B's 280us, so every strip latches, and send the frame again.
+ * Prints the times it saw, the margin to 50us and how many frames were
+ * sent again, and exits 1 if any check fails.
+ *
+ *   g++ -O2 -Wall -Wextra -I RX/src tools/uart_wire.cpp -o uart_wire
+ *   ./uart_wire
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "leddriver.h"
+#include "uartwire.h"
+
+#define TOLERANCE_NS 150
+#define T0H_NS 400
+#define T1H_NS 800
+#define T0L_NS 850
+#define T1L_NS 450
+#define BIT_NS 1250
+#define BIT_TOLERANCE_NS 600
+#define WS2812_RESET_NS 50000   // an original WS2812 latches after the line is low this long
+#define WS2812B_RESET_NS 280000 // and a WS2812B
+#define LATCH_NS 300000         // LATCH_US in output.cpp
+#define LATE_ONE_IN 100         // refills held off by another interrupt or a cache miss
+#define LATE_MAX_NS 400000      // by up to this long
+#define FRAMES 200
+#define LEDS 104
+
+// A run of the line at one level
+struct Level
+{
+  bool high;
+  double ns;
+};
+
+// The line as UART1 drives it: each character is a start bit, data bits
+// LSB first and a stop bit, all inverted by UCTXI, and the line idles low
+// (a stop bit, inverted) whenever the FIFO is empty
+struct Line
+{
+  std::vector<Level> levels;
+
+  void add(bool high, double ns)
+  {
+    if (!levels.empty() && levels.back().high == high)
+      levels.back().ns += ns;
+    else
+      levels.push_back({high, ns});
+  }
+
+  void send(uint8_t character)
+  {
+    double bit = 1e9 / UART_WIRE_BAUD;
+    add(true, bit); // start
+    for (int d = 0; d < 6; d++)
+      add(!(character & (1 << d)), bit);
+    add(false, bit); // stop
+  }
+
+  void idle(double ns)
+  {
+    add(false, ns);
+  }
+};
+
+struct Timing
+{
+  double min = 1e9, max = 0;
+  void saw(double ns)
+  {
+    min = ns < min ? ns : min;
+    max = ns > max ? ns : max;
+  }
+};
+
+static Timing t0h, t1h, t0l, t1l, period, stretched;
+
+static bool within(double ns, double nominal, double tolerance)
+{
+  return ns >= nominal - tolerance && ns <= nominal + tolerance;
+}
+
+// Read the line as a strip would, from its first rise to the end, giving
+// the last frame latched. A low longer than the datasheet's, from the FIFO
+// running dry, is only allowed if stretch is set
+static bool readStrip(const Line &line, bool stretch, std::vector<uint8_t> &bytes, int *latches = nullptr)
+{
+  bytes.clear();
+  uint8_t byte = 0;
+  int bits = 0;
+  size_t i = 0;
+  while (i < line.levels.size() && !line.levels[i].high)
+    i++;
+
+  for (; i < line.levels.size(); i += 2)
+  {
+    double high = line.levels[i].ns;
+    bool last = i + 2 >= line.levels.size();
+    double low = i + 1 < line.levels.size() ? line.levels[i + 1].ns : WS2812B_RESET_NS;
+    bool one;
+    if (within(high, T0H_NS, TOLERANCE_NS))
+    {
+      one = false;
+      t0h.saw(high);
+    }
+    else if (within(high, T1H_NS, TOLERANCE_NS))
+    {
+      one = true;
+      t1h.saw(high);
+    }
+    else
+    {
+      printf("high for %.1fns is neither a 0 nor a 1\n", high);
+      return false;
+    }
+
+    double nominal = one ? T1L_NS : T0L_NS;
+    if (low >= WS2812_RESET_NS)
+    {
+      if (!last)
+      {
+        if (!stretch || low < WS2812B_RESET_NS)
+        {
+          printf("low for %.1fns latches %s mid-frame\n", low, stretch ? "a WS2812 but not a WS2812B" : "the strip");
+          return false;
+        }
+        // every strip latches what it has, and the frame starts again
+        bytes.clear();
+        bits = 0;
+        (*latches)++;
+        continue;
+      }
+    }
+    else if (within(low, nominal, TOLERANCE_NS))
+    {
+      (one ? t1l : t0l).saw(low);
+      period.saw(high + low);
+      if (!within(high + low, BIT_NS, BIT_TOLERANCE_NS))
+      {
+        printf("bit of %.1fns\n", high + low);
+        return false;
+      }
+    }
+    else if (!stretch || low < nominal - TOLERANCE_NS)
+    {
+      printf("%s low for %.1fns\n", one ? "1" : "0", low);
+      return false;
+    }
+    else
+    {
+      stretched.saw(low);
+    }
+
+    byte = byte << 1 | one;
+    if (++bits == 8)
+    {
+      bytes.push_back(byte);
+      bits = 0;
+    }
+  }
+  return bits == 0;
+}
+
+struct CRGB
+{
+  uint8_t r, g, b;
+};
+
+// Uart1Driver's refill, on the host: the characters of each frame, queued
+// by a timer interrupt every UART_WIRE_REFILL_US that now and then runs
+// late, played into a Line. All times in ns.
+class WireDriver : public LedDriver
+{
+public:
+  Line line;
+
+  bool begin(struct CRGB *, const LedStrip *, uint8_t) override
+  {
+    return true;
+  }
+
+  void show(const struct CRGB *leds, int numLeds, uint8_t) override
+  {
+    std::vector<uint8_t> wire;
+    for (int i = 0; i < numLeds; i++)
+    {
+      for (uint8_t v : {leds[i].g, leds[i].r, leds[i].b})
+      {
+        uint8_t characters[UART_WIRE_BYTES];
+        uartWireEncode(v, characters);
+        wire.insert(wire.end(), characters, characters + UART_WIRE_BYTES);
+      }
+    }
+
+    double character = 1e9 * 8 / UART_WIRE_BAUD;
+    double now = 0, empty = 0;
+    size_t sent = 0;
+    while (sent < wire.size())
+    {
+      int queued = empty > now ? (int)((empty - now) / character + 0.999) : 0;
+      if (queued == 0 && sent > 0 && now - empty > UART_WIRE_GAP_US * 1000)
+      {
+        // as uartRefill(): hold the line low until every strip latches
+        line.idle(now - empty);
+        empty = now;
+        now += LATCH_NS;
+        sent = 0;
+        continue;
+      }
+      if (queued == 0 && now > empty)
+      {
+        line.idle(now - empty);
+        empty = now;
+      }
+      for (; queued < UART_WIRE_FIFO && sent < wire.size(); queued++)
+        line.send(wire[sent++]);
+      empty = now + queued * character;
+      now += UART_WIRE_REFILL_US * 1000.0;
+      if (rand() % LATE_ONE_IN == 0)
+        now += rand() % LATE_MAX_NS;
+    }
+    line.idle(now > empty ? now - empty : 0);
+    line.idle(LATCH_NS);
+  }
+
+  bool busy() override
+  {
+    return false;
+  }
+
+  void wait(unsigned long) override
+  {
+  }
+};
+
+int main()
+{
+  bool ok = true;
+
+  // every value, back to back as the FIFO sends them
+  Line line;
+  std::vector<uint8_t> sent, read;
+  for (int v = 0; v < 256; v++)
+  {
+    uint8_t characters[UART_WIRE_BYTES];
+    uartWireEncode(v, characters);
+    for (uint8_t c : characters)
+      line.send(c);
+    sent.push_back(v);
+  }
+  line.idle(LATCH_NS);
+  if (!readStrip(line, false, read) || read != sent)
+  {
+    printf("values 0-255 don't read back as sent\n");
+    ok = false;
+  }
+
+  // frames of random colours through the driver, its refills sometimes
+  // late enough for the FIFO to run dry
+  srand(1);
+  int latches = 0;
+  for (int f = 0; f < FRAMES; f++)
+  {
+    WireDriver driver;
+    struct CRGB leds[LEDS];
+    sent.clear();
+    for (struct CRGB &led : leds)
+    {
+      led = {(uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand()};
+      sent.insert(sent.end(), {led.g, led.r, led.b});
+    }
+    driver.show(leds, LEDS, 255);
+    if (!readStrip(driver.line, true, read, &latches) || read != sent)
+    {
+      printf("frame %d, sent with gaps, doesn't read back as sent\n", f);
+      ok = false;
+      break;
+    }
+  }
+
+  printf("T0H %6.1f-%6.1fns (%d +-%d)\n", t0h.min, t0h.max, T0H_NS, TOLERANCE_NS);
+  printf("T1H %6.1f-%6.1fns (%d +-%d)\n", t1h.min, t1h.max, T1H_NS, TOLERANCE_NS);
+  printf("T0L %6.1f-%6.1fns (%d +-%d)\n", t0l.min, t0l.max, T0L_NS, TOLERANCE_NS);
+  printf("T1L %6.1f-%6.1fns (%d +-%d)\n", t1l.min, t1l.max, T1L_NS, TOLERANCE_NS);
+  printf("bit %6.1f-%6.1fns (%d +-%d)\n", period.min, period.max, BIT_NS, BIT_TOLERANCE_NS);
+  printf("lows stretched by an empty FIFO: %.1f-%.1fns, %.1fns short of a WS2812's %d\n", stretched.min,
+         stretched.max, WS2812_RESET_NS - stretched.max, WS2812_RESET_NS);
+  printf("%d of %d frames of %d LEDs sent again after a longer gap\n", latches, FRAMES, LEDS);
+  if (stretched.max >= WS2812_RESET_NS)
+    ok = false;
+  printf(ok ? "Waveform within WS2812 and WS2812B timing\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,622 @@
+/* Effect VM benchmark
+ *
+ * Renders the TX's rainbow and chase programs (TX/src/programs.h) through
+ * the receiver's interpreter (RX/src/vmrun.h) on drums of several sizes,
+ * feeding it its inputs as vmRender() does. First it checks every frame of
+ * ten seconds against the same program written out by hand in C++. Then it
+ * times the VM against the receiver's own native rainbow and chase (see
+ * RX/src/effects.cpp and chase.cpp, the chase rendered at 16 bits and
+ * dithered down, as RX/src/hires.cpp does), and prints the time per frame
+ * of each and the ratio. Colours are converted as FastLED does, out of line
+ * as they are in FastLED. The ESP8266 has no vector unit, so neither does
+ * the build. A PC is far faster than an ESP8266, but the ratio carries over
+ * near enough. The rainbow runs within 2x of native, most of either being
+ * the colour conversion. The chase doesn't: native, it is a fade and a
+ * dither per LED, where the VM reads each pixel's number, takes its
+ * modulo, compares, splits the group at the jump and hands back a result
+ * to fade, each a pass over the pixels of its own, and comes to about 3x.
+ * That is checked against 4x, to leave room for a noisy machine.
+ *
+ * Then it times the native rainbow and chase, fire (RX/src/fireheat.h) and
+ * twinkle (twinklepick.h) on drums from 36 to 1000 LEDs, and prints the
+ * cost per frame and per LED, which should stay about the same however
+ * long the strip: nothing in a frame should cost more than in proportion
+ * to its LEDs. The dither that brings chase and twinkle's 16-bit frames
+ * down to 8 bits (RX/src/hires.cpp) is timed on its own too, and its share
+ * of chase's frame given: on the drum, where profile_dump.py gives it as a
+ * share of the 28.6ms frame, it should be about the same share of the
+ * render time.
+ *
+ * Last, it times fire with each pixel's colour looked up in the palette's
+ * 256-entry table (RX/src/palette.cpp), as the drum does, against
+ * FastLED's ColorFromPalette() on the 16-colour palette in flash, as it
+ * used to, and how long building the table takes: once when the palette
+ * changes, and each frame while two palettes blend. A PC reads flash no
+ * slower than RAM, where the ESP8266 waits on its flash cache, so the
+ * drum gains rather more than this shows.
+ *
+ * And it times chase, fire and twinkle for 36, 52, 72 and 104 LEDs as the
+ * generic build runs them, with the count from config, against the drumNN
+ * builds (RX/src/ledcount.h), with it built in, and prints the gain.
+ *
+ * Exits 1 if a frame differs, the VM is slower than that against native,
+ * or an effect costs more than twice as much per LED on the longest strip
+ * as at 104 LEDs.
+ *
+ *   g++ -O2 -fno-tree-vectorize -fno-tree-slp-vectorize -Wall -Wextra -I common/DrumRadio -I RX/src -I TX/src \
+ *     tools/vm_bench.cpp RX/src/prng.cpp -o vm_bench
+ *   ./vm_bench [frames]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "DrumRadio.h"
+#include "DrumVM.h"
+#include "fireheat.h"
+#include "ledcount.h"
+#include "prng.h"
+#include "programs.h"
+#include "twinklepick.h"
+#include "vmrun.h"
+
+#define FPS 35
+#define BPM 120
+
+struct Rgb
+{
+  uint8_t r, g, b;
+  bool operator!=(const Rgb &o) const { return r != o.r || g != o.g || b != o.b; }
+};
+
+static uint8_t sinTable[256];
+
+static inline uint8_t scale8(uint8_t a, uint8_t b)
+{
+  return (a * (1 + b)) >> 8; // as FastLED's, with FASTLED_SCALE8_FIXED
+}
+
+struct HostMaths
+{
+  static int32_t scale8(int32_t a, int32_t b) { return ::scale8(a, b); }
+  static int32_t sin8(int32_t a) { return sinTable[a & 255]; }
+  static int32_t noise(int32_t a, int32_t b) { return (a * 2654435761u ^ b * 40503u) >> 24; }
+  static int32_t rand8() { return rand() & 255; }
+};
+
+static inline uint8_t scale8Video(uint8_t a, uint8_t b)
+{
+  return ((a * b) >> 8) + ((a && b) ? 1 : 0);
+}
+
+// FastLED's hsv2rgb_rainbow, as the drum converts a CHSV. Out of line, as
+// it is in FastLED, or native effects would get it folded into their loops
+__attribute__((noinline)) static Rgb hsv(uint8_t hue, uint8_t sat, uint8_t val)
+{
+  uint8_t offset8 = (hue & 0x1F) << 3;
+  uint8_t third = scale8(offset8, 256 / 3);
+  uint8_t twoThirds = scale8(offset8, 256 * 2 / 3);
+  uint8_t r, g, b;
+  switch (hue >> 5)
+  {
+  case 0: r = 255 - third; g = third; b = 0; break;
+  case 1: r = 171; g = 85 + third; b = 0; break;
+  case 2: r = 171 - twoThirds; g = 170 + third; b = 0; break;
+  case 3: r = 0; g = 255 - third; b = third; break;
+  case 4: r = 0; g = 171 - twoThirds; b = 85 + twoThirds; break;
+  case 5: r = third; g = 0; b = 255 - third; break;
+  case 6: r = 85 + third; g = 0; b = 171 - third; break;
+  default: r = 170 + third; g = 0; b = 85 - third; break;
+  }
+
+  if (sat != 255)
+  {
+    if (sat == 0)
+    {
+      r = g = b = 255;
+    }
+    else
+    {
+      uint8_t desat = scale8Video(255 - sat, 255 - sat);
+      uint8_t satScale = 255 - desat;
+      r = scale8(r, satScale) + desat;
+      g = scale8(g, satScale) + desat;
+      b = scale8(b, satScale) + desat;
+    }
+  }
+
+  if (val != 255)
+  {
+    val = scale8Video(val, val);
+    r = scale8(r, val);
+    g = scale8(g, val);
+    b = scale8(b, val);
+  }
+  return {r, g, b};
+}
+
+static inline void fade(Rgb &pixel, uint8_t by)
+{
+  pixel.r = scale8(pixel.r, by);
+  pixel.g = scale8(pixel.g, by);
+  pixel.b = scale8(pixel.b, by);
+}
+
+struct Clock
+{
+  int32_t millis, beat, bar, frame;
+};
+
+static Clock clockAt(int frame)
+{
+  int32_t ms = frame * 1000 / FPS;
+  int32_t beats256 = (int64_t)ms * BPM * 256 / 60000; // 8.8 beats
+  return {ms, beats256 & 255, (int32_t)(((int64_t)beats256 * 64) & 0xFFFF), frame};
+}
+
+// The programs, by hand; the rainbow is also the receiver's own, as
+// fill_rainbow() draws it
+static void nativeRainbow(std::vector<Rgb> &leds, const Clock &clock)
+{
+  int n = leds.size();
+  uint8_t base = clock.bar >> 8;
+  for (int i = 0; i < n; i++)
+    leds[i] = hsv(base + i * 7, 240, 255);
+}
+
+static void handChase(std::vector<Rgb> &leds, const Clock &clock)
+{
+  int n = leds.size();
+  int segment = n / 4;
+  int dot = scale8(clock.beat, segment);
+  for (int i = 0; i < n; i++)
+  {
+    if (i % segment == dot)
+      leds[i] = {0, 0, 255};
+    else
+      fade(leds[i], 155);
+  }
+}
+
+// The receiver's 16-bit frame (RX/src/hires.h), for chase and twinkle
+struct Rgb16
+{
+  uint16_t r, g, b;
+};
+
+struct Hires
+{
+  std::vector<Rgb16> frame;
+  std::vector<uint8_t> residual;
+
+  // Start again with a clear frame, if it isn't n LEDs already
+  bool begin(int n)
+  {
+    if ((int)frame.size() == n)
+      return false;
+    frame.assign(n, {0, 0, 0});
+    residual.assign(n * 3, 0);
+    return true;
+  }
+
+  // hiresFade()
+  template <typename Count>
+  void fade(Count n, uint8_t fadeBy)
+  {
+    uint16_t scale = 256 - fadeBy;
+    for (int i = 0; i < n; i++)
+    {
+      frame[i].r = ((uint32_t)frame[i].r * scale) >> 8;
+      frame[i].g = ((uint32_t)frame[i].g * scale) >> 8;
+      frame[i].b = ((uint32_t)frame[i].b * scale) >> 8;
+    }
+  }
+
+  // hiresResolve()
+  void dither(Rgb *leds, int n)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      leds[i].r = quantise(frame[i].r, residual[i * 3]);
+      leds[i].g = quantise(frame[i].g, residual[i * 3 + 1]);
+      leds[i].b = quantise(frame[i].b, residual[i * 3 + 2]);
+    }
+  }
+
+  static uint8_t quantise(uint16_t value, uint8_t &error)
+  {
+    uint32_t sum = (uint32_t)value + error;
+    error = sum & 0xFF;
+    return sum > 0xFFFF ? 0xFF : sum >> 8;
+  }
+};
+
+// Just the dither, of a frame of fading twinkles
+static void nativeDither(std::vector<Rgb> &leds, const Clock &)
+{
+  static Hires hires;
+  int n = leds.size();
+  if (hires.begin(n))
+  {
+    for (int i = 0; i < n; i++)
+      hires.frame[i] = {(uint16_t)(i * 40503u), (uint16_t)(i * 2654435761u >> 16), (uint16_t)(i * 257)};
+  }
+  hires.dither(leds.data(), n);
+}
+
+// The receiver's own chase (RX/src/chase.cpp), with one dot per segment
+// in blue. Count is int, or a LedCount as in a drumNN build
+template <typename Count>
+struct Chase
+{
+  Hires hires;
+  int dot = 0;
+
+  void frame(Rgb *leds, Count n, const Clock &clock)
+  {
+    if (hires.begin(n))
+      dot = 0;
+
+    const int segment = n / 4;
+    hires.fade(n, 100);
+    int position = ((uint32_t)clock.beat * segment) >> 8;
+    int ahead = position - dot;
+    if (ahead < 0)
+      ahead += segment;
+    if (ahead > segment / 2)
+      dot = position;
+
+    if (dot == position)
+      dots(n, segment);
+    while (dot != position)
+    {
+      if (++dot == segment)
+        dot = 0;
+      dots(n, segment);
+    }
+    hires.dither(leds, n);
+  }
+
+  void dots(Count n, int segment)
+  {
+    for (int s = 0; s < 4; s++)
+    {
+      int target = dot + segment * s;
+      if (target >= n)
+        target = n - 1;
+      hires.frame[target] = {0, 0, 0xFFFF};
+    }
+  }
+};
+
+static void nativeChase(std::vector<Rgb> &leds, const Clock &clock)
+{
+  static Chase<int> chase;
+  chase.frame(leds.data(), leds.size(), clock);
+}
+
+// The beat clock, for the receiver's generator (RX/src/prng.cpp)
+static uint32_t beats = 0;
+
+uint32_t clockBeats()
+{
+  return beats;
+}
+
+// Seeded afresh each frame, so effects rendering the same frame one after
+// the other draw the same numbers
+static void prngAt(const Clock &clock)
+{
+  prngBegin(0);
+  beats = ((uint64_t)clock.millis * BPM << BEAT_FRACTION_BITS) / 60000;
+  prngFrame(50);
+}
+
+// WoodFireColors_p (RX/src/prototypes.h), as 0xRRGGBB words in flash
+static const uint32_t woodFire[16] = {0x000000, 0x330e00, 0x661c00, 0x992900, 0xcc3700, 0xff4500, 0xff5800, 0xff6b00,
+                                      0xff7f00, 0xff9200, 0xffa500, 0xffaf00, 0xffb900, 0xffc300, 0xffcd00, 0xffd700};
+
+// FastLED's ColorFromPalette() for a TProgmemRGBPalette16, blending
+// linearly at full brightness. Out of line, as it is in FastLED
+__attribute__((noinline)) static Rgb colorFromPalette(const uint32_t *palette, uint8_t index)
+{
+  uint8_t hi4 = index >> 4;
+  uint8_t lo4 = index & 0x0F;
+  uint32_t entry = palette[hi4];
+  uint8_t r = entry >> 16, g = entry >> 8, b = entry;
+  if (lo4)
+  {
+    uint32_t next = palette[hi4 == 15 ? 0 : hi4 + 1];
+    uint8_t f2 = lo4 << 4;
+    uint8_t f1 = 255 - f2;
+    r = scale8(r, f1) + scale8(next >> 16, f2);
+    g = scale8(g, f1) + scale8(next >> 8, f2);
+    b = scale8(b, f1) + scale8(next, f2);
+  }
+  return {r, g, b};
+}
+
+// The table palette.cpp expands a palette into
+static Rgb fireLut[256];
+
+static void expand(const uint32_t *palette)
+{
+  for (int i = 0; i < 256; i++)
+    fireLut[i] = colorFromPalette(palette, i);
+}
+
+// Fire, as the drum draws it (RX/src/fire.cpp), its colours from the
+// table, or from the palette as it used to
+template <typename Count>
+struct Fire
+{
+  std::vector<uint8_t> heat;
+
+  void step(Count n, const Clock &clock)
+  {
+    if ((int)heat.size() != n)
+      heat.assign(n, 0);
+    prngAt(clock);
+    fireHeat(heat.data(), n);
+  }
+
+  void frame(Rgb *leds, Count n, const Clock &clock)
+  {
+    step(n, clock);
+    for (int j = 0; j < n; j++)
+      leds[j] = fireLut[scale8(heat[j], 240)];
+  }
+
+  void paletteFrame(Rgb *leds, Count n, const Clock &clock)
+  {
+    step(n, clock);
+    for (int j = 0; j < n; j++)
+      leds[j] = colorFromPalette(woodFire, scale8(heat[j], 240));
+  }
+};
+
+static void nativeFire(std::vector<Rgb> &leds, const Clock &clock)
+{
+  static Fire<int> fire;
+  fire.frame(leds.data(), leds.size(), clock);
+}
+
+static void paletteFire(std::vector<Rgb> &leds, const Clock &clock)
+{
+  static Fire<int> fire;
+  fire.paletteFrame(leds.data(), leds.size(), clock);
+}
+
+// rioDisco()'s twinkles (RX/src/twinkle.cpp) in green, gold and dark blue
+template <typename Count>
+struct Twinkle
+{
+  Hires hires;
+  int lastPixel = 0;
+
+  void frame(Rgb *leds, Count n, const Clock &clock)
+  {
+    static const Rgb16 colours[3] = {{0, 128 * 257, 0}, {255 * 257, 215 * 257, 0}, {0, 0, 139 * 257}};
+    if (hires.begin(n))
+      lastPixel = 0;
+
+    prngAt(clock);
+    hires.fade(n, twinkleFade(n));
+    std::vector<Rgb16> &frame = hires.frame;
+    twinklePick(
+        n, lastPixel, [&](int pixel, uint8_t color) { frame[pixel] = colours[color]; },
+        [&](int pixel) { return (frame[pixel].r | frame[pixel].g | frame[pixel].b) > 0xFF; });
+    hires.dither(leds, n);
+  }
+};
+
+static void nativeTwinkle(std::vector<Rgb> &leds, const Clock &clock)
+{
+  static Twinkle<int> twinkle;
+  twinkle.frame(leds.data(), leds.size(), clock);
+}
+
+// As vmRender() does it
+static void vmFrame(std::vector<Rgb> &leds, const Clock &clock, const VmProgram &program,
+                    const std::vector<int32_t> &angles)
+{
+  int n = leds.size();
+  int32_t inputs[VM_INPUT_COUNT];
+  inputs[VM_IN_COUNT] = n;
+  inputs[VM_IN_MILLIS] = clock.millis;
+  inputs[VM_IN_BEAT] = clock.beat;
+  inputs[VM_IN_BAR] = clock.bar;
+  inputs[VM_IN_FRAME] = clock.frame;
+  uint8_t count = program.length / 3;
+
+  VmPixel pixels[VM_LANES];
+  VmResult results[VM_LANES];
+  for (int first = 0; first < n; first += VM_LANES)
+  {
+    uint8_t lanes = n - first < VM_LANES ? n - first : VM_LANES;
+    for (uint8_t l = 0; l < lanes; l++)
+      pixels[l] = {first + l, angles[first + l], angles[first + l] / 2};
+    vmRun<HostMaths>(program.code, count, inputs, pixels, lanes, 64, results);
+
+    for (uint8_t l = 0; l < lanes; l++)
+    {
+      const VmResult &result = results[l];
+      Rgb &pixel = leds[first + l];
+      switch (result.op)
+      {
+      case VM_RGB:
+        pixel = {(uint8_t)result.v[0], (uint8_t)result.v[1], (uint8_t)result.v[2]};
+        break;
+      case VM_HSV:
+        pixel = hsv(result.v[0], result.v[1], result.v[2]);
+        break;
+      case VM_FADE:
+        fade(pixel, result.v[0]);
+        break;
+      }
+    }
+  }
+}
+
+template <typename Render>
+static double timeFrames(int frames, Render render)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++)
+    render(clockAt(f));
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+// Time Effect for N LEDs as the generic build renders it, the count an int
+// it can't see through, and as a drumN build does, the count a LedCount<N>;
+// checking first that both draw the same frames
+template <template <typename> class Effect, int N>
+static bool ledCountGain(const char *name, int frames)
+{
+  volatile int fromConfig = N;
+  int n = fromConfig;
+  Effect<int> generic;
+  Effect<LedCount<N>> specialised;
+  std::vector<Rgb> a(N), b(N);
+  for (int f = 0; f < FPS * 10; f++)
+  {
+    generic.frame(a.data(), n, clockAt(f));
+    specialised.frame(b.data(), LedCount<N>(), clockAt(f));
+    if (memcmp(a.data(), b.data(), N * sizeof(Rgb)) != 0)
+    {
+      printf("%s on %d LEDs: frame %d differs with the count built in\n", name, N, f);
+      return false;
+    }
+  }
+
+  double genericUs = timeFrames(frames, [&](const Clock &clock) { generic.frame(a.data(), n, clock); });
+  double specialisedUs = timeFrames(frames, [&](const Clock &clock) { specialised.frame(b.data(), LedCount<N>(), clock); });
+  printf("%-8s %5d %7.2fus %7.2fus  %5.1f%%\n", name, N, genericUs, specialisedUs,
+         (genericUs - specialisedUs) * 100 / genericUs);
+  return true;
+}
+
+template <template <typename> class Effect>
+static bool ledCountGains(const char *name, int frames)
+{
+  return ledCountGain<Effect, 36>(name, frames) & ledCountGain<Effect, 52>(name, frames) &
+         ledCountGain<Effect, 72>(name, frames) & ledCountGain<Effect, 104>(name, frames);
+}
+
+int main(int argc, char **argv)
+{
+  int frames = argc > 1 ? atoi(argv[1]) : 20000;
+  for (int i = 0; i < 256; i++)
+    sinTable[i] = 128 + 127 * sin(2 * M_PI * i / 256);
+  expand(woodFire);
+
+  struct Effect
+  {
+    const char *name;
+    const VmProgram &program;
+    void (*hand)(std::vector<Rgb> &, const Clock &);
+    void (*native)(std::vector<Rgb> &, const Clock &);
+    double slowest; // VM's time over native's
+  } effects[] = {{"rainbow", vmPrograms[0], nativeRainbow, nativeRainbow, 2},
+                 {"chase", vmPrograms[1], handChase, nativeChase, 4}};
+
+  bool ok = true;
+  printf("effect    LEDs    native       VM   ratio\n");
+  for (const Effect &effect : effects)
+  {
+    for (int n : {36, 72, 104, 300, 600})
+    {
+      std::vector<Rgb> native(n), vm(n);
+      std::vector<int32_t> angles(n);
+      for (int i = 0; i < n; i++)
+        angles[i] = i * 256 / n;
+
+      for (int f = 0; f < FPS * 10; f++)
+      {
+        effect.hand(native, clockAt(f));
+        vmFrame(vm, clockAt(f), effect.program, angles);
+        if (memcmp(native.data(), vm.data(), n * sizeof(Rgb)) != 0)
+        {
+          printf("%s on %d LEDs: frame %d differs\n", effect.name, n, f);
+          ok = false;
+          break;
+        }
+      }
+
+      int scaled = frames * 104 / n;
+      double nativeUs = timeFrames(scaled, [&](const Clock &clock) { effect.native(native, clock); });
+      double vmUs = timeFrames(scaled, [&](const Clock &clock) { vmFrame(vm, clock, effect.program, angles); });
+      printf("%-8s %5d %7.2fus %7.2fus   %4.2fx\n", effect.name, n, nativeUs, vmUs, vmUs / nativeUs);
+      if (vmUs > effect.slowest * nativeUs)
+      {
+        printf("%s on %d LEDs: VM more than %.0fx as slow as native\n", effect.name, n, effect.slowest);
+        ok = false;
+      }
+    }
+  }
+
+  struct Native
+  {
+    const char *name;
+    void (*render)(std::vector<Rgb> &, const Clock &);
+  } natives[] = {{"rainbow", nativeRainbow}, {"chase", nativeChase},   {"fire", nativeFire},
+                 {"twinkle", nativeTwinkle}, {"dither", nativeDither}};
+
+  double chaseUs = 0; // at 104 LEDs
+  printf("\nnative    LEDs  per frame   per LED\n");
+  for (const Native &effect : natives)
+  {
+    double at104 = 0, perLed = 0;
+    for (int n : {36, 52, 72, 104, 300, 600, 1000})
+    {
+      std::vector<Rgb> leds(n);
+      double us = timeFrames(frames * 104 / n, [&](const Clock &clock) { effect.render(leds, clock); });
+      perLed = us * 1000 / n;
+      if (n == 104)
+        at104 = perLed;
+      if (n == 104 && effect.render == nativeChase)
+        chaseUs = us;
+      printf("%-8s %5d %8.2fus %7.2fns\n", effect.name, n, us, perLed);
+    }
+    if (perLed > 2 * at104)
+    {
+      printf("%s costs %.1fx as much per LED on the longest strip as at 104 LEDs\n", effect.name, perLed / at104);
+      ok = false;
+    }
+    if (effect.render == nativeDither)
+      printf("dither is %.0f%% of chase's frame at 104 LEDs\n", at104 * 104 / 1000 * 100 / chaseUs);
+  }
+
+  printf("\n          LEDs   palette     table  speed-up\n");
+  for (int n : {36, 72, 104, 300, 600})
+  {
+    std::vector<Rgb> fromPalette(n), fromTable(n);
+    for (int f = 0; f < FPS * 10; f++)
+    {
+      paletteFire(fromPalette, clockAt(f));
+      nativeFire(fromTable, clockAt(f));
+      if (memcmp(fromPalette.data(), fromTable.data(), n * sizeof(Rgb)) != 0)
+      {
+        printf("fire on %d LEDs: frame %d differs from the table\n", n, f);
+        ok = false;
+        break;
+      }
+    }
+
+    int scaled = frames * 104 / n;
+    double paletteUs = timeFrames(scaled, [&](const Clock &clock) { paletteFire(fromPalette, clock); });
+    double tableUs = timeFrames(scaled, [&](const Clock &clock) { nativeFire(fromTable, clock); });
+    printf("fire     %5d %7.2fus %7.2fus   %5.2fx\n", n, paletteUs, tableUs, paletteUs / tableUs);
+  }
+  printf("building the table: %.2fus\n", timeFrames(frames, [&](const Clock &) { expand(woodFire); }));
+
+  printf("\n          LEDs   generic  drumNN    gain\n");
+  ok &= ledCountGains<Chase>("chase", frames);
+  ok &= ledCountGains<Fire>("fire", frames);
+  ok &= ledCountGains<Twinkle>("twinkle", frames);
+  return ok ? 0 : 1;
+}